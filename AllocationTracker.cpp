@@ -0,0 +1,261 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "AllocationTracker.h"
+
+#if defined(ENVEXPLORER_ALLOC_TRACKING)
+
+#include <atomic>
+#include <mutex>
+#include <new>
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace EnvironmentExplorer
+{
+    // Counters of the calling thread; plain data, so they can be
+    // touched before main() and from inside operator new. Bytes in
+    // use are only kept process-wide: a block may be freed by another
+    // thread than the one which allocated it.
+    struct ThreadCounters
+    {
+        quint64 allocations;
+        quint64 bytes;
+        qint64 peak;        // highest process use seen at our allocations
+    };
+
+    static thread_local ThreadCounters counters;
+
+    static std::atomic<quint64> totalCount(0);
+    static std::atomic<qint64> totalCurrent(0);
+    static std::atomic<qint64> totalPeak(0);
+
+    // Tags are few; a fixed table keeps the registry free of allocations.
+    struct TagEntry
+    {
+        const char* tag;
+        quint64 calls, allocations, bytes;
+        qint64 peak;
+    };
+
+    static const int maxTags = 64;
+    static TagEntry tags[maxTags];
+    static int tagCount = 0;
+    static std::mutex tagMutex;
+
+    // Size is kept in front of the block, 16 bytes keep malloc()'s alignment.
+    static const size_t headerSize = 16;
+
+    static void* trackedAlloc(size_t size)
+    {
+        void* block = malloc(size + headerSize);
+        if (!block)
+            return 0;
+
+        *static_cast<size_t*>(block) = size;
+
+        ++totalCount;
+        qint64 current = (totalCurrent += qint64(size));
+        qint64 peak = totalPeak.load();
+        while (current > peak && !totalPeak.compare_exchange_weak(peak, current)) {}
+
+        ++counters.allocations;
+        counters.bytes += size;
+        if (current > counters.peak)
+            counters.peak = current;
+
+        return static_cast<char*>(block) + headerSize;
+    }
+
+    static void trackedFree(void* p)
+    {
+        if (!p)
+            return;
+
+        char* block = static_cast<char*>(p) - headerSize;
+        size_t size = *reinterpret_cast<size_t*>(block);
+
+        // may be another thread than the allocating one
+        totalCurrent -= qint64(size);
+
+        free(block);
+    }
+
+    AllocationScope::AllocationScope(const char* tag)
+        : tag(tag), allocations(counters.allocations), bytes(counters.bytes),
+          current(totalCurrent.load()), outerPeak(counters.peak)
+    { counters.peak = current; }
+
+    AllocationScope::~AllocationScope()
+    {
+        quint64 count = counters.allocations - allocations;
+        quint64 size = counters.bytes - bytes;
+        qint64 peak = counters.peak - current;
+
+        // the enclosing scope keeps its own peak
+        counters.peak = qMax(outerPeak, counters.peak);
+
+        std::lock_guard<std::mutex> lock(tagMutex);
+
+        int i = 0;
+        while (i < tagCount && strcmp(tags[i].tag, tag) != 0)
+            ++i;
+
+        if (i == tagCount)
+        {
+            if (tagCount == maxTags)
+                return;
+
+            TagEntry entry = { tag, 0, 0, 0, 0 };
+            tags[tagCount++] = entry;
+        }
+
+        ++tags[i].calls;
+        tags[i].allocations += count;
+        tags[i].bytes += size;
+        tags[i].peak = qMax(tags[i].peak, peak);
+    }
+
+    bool AllocationTracker::isEnabled()
+    { return true; }
+
+    QList<AllocationStats> AllocationTracker::statistics()
+    {
+        TagEntry copy[maxTags];
+        int count;
+
+        {
+            std::lock_guard<std::mutex> lock(tagMutex);
+            count = tagCount;
+            memcpy(copy, tags, sizeof(TagEntry) * count);
+        }
+
+        QList<AllocationStats> result;
+        for (int i = 0; i < count; ++i)
+        {
+            AllocationStats stats;
+            stats.tag = QString::fromLatin1(copy[i].tag);
+            stats.calls = copy[i].calls;
+            stats.allocations = copy[i].allocations;
+            stats.bytes = copy[i].bytes;
+            stats.peak = copy[i].peak;
+            result.append(stats);
+        }
+
+        return result;
+    }
+
+    void AllocationTracker::reset()
+    {
+        std::lock_guard<std::mutex> lock(tagMutex);
+        tagCount = 0;
+        totalPeak = totalCurrent.load();
+    }
+
+    quint64 AllocationTracker::totalAllocations()
+    { return totalCount; }
+
+    qint64 AllocationTracker::currentBytes()
+    { return totalCurrent; }
+
+    qint64 AllocationTracker::peakBytes()
+    { return totalPeak; }
+}
+
+void* operator new(size_t size)
+{
+    void* p = EnvironmentExplorer::trackedAlloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    void* p = EnvironmentExplorer::trackedAlloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t &) noexcept
+{ return EnvironmentExplorer::trackedAlloc(size ? size : 1); }
+
+void* operator new[](size_t size, const std::nothrow_t &) noexcept
+{ return EnvironmentExplorer::trackedAlloc(size ? size : 1); }
+
+void operator delete(void* p) noexcept
+{ EnvironmentExplorer::trackedFree(p); }
+
+void operator delete[](void* p) noexcept
+{ EnvironmentExplorer::trackedFree(p); }
+
+void operator delete(void* p, const std::nothrow_t &) noexcept
+{ EnvironmentExplorer::trackedFree(p); }
+
+void operator delete[](void* p, const std::nothrow_t &) noexcept
+{ EnvironmentExplorer::trackedFree(p); }
+
+#if __cplusplus >= 201402L
+void operator delete(void* p, size_t) noexcept
+{ EnvironmentExplorer::trackedFree(p); }
+
+void operator delete[](void* p, size_t) noexcept
+{ EnvironmentExplorer::trackedFree(p); }
+#endif
+
+#else // ENVEXPLORER_ALLOC_TRACKING
+
+namespace EnvironmentExplorer
+{
+    bool AllocationTracker::isEnabled()
+    { return false; }
+
+    QList<AllocationStats> AllocationTracker::statistics()
+    { return QList<AllocationStats>(); }
+
+    void AllocationTracker::reset()
+    {}
+
+    quint64 AllocationTracker::totalAllocations()
+    { return 0; }
+
+    qint64 AllocationTracker::currentBytes()
+    { return 0; }
+
+    qint64 AllocationTracker::peakBytes()
+    { return 0; }
+}
+
+#endif // ENVEXPLORER_ALLOC_TRACKING
+
+namespace EnvironmentExplorer
+{
+    QString AllocationTracker::report()
+    {
+        if (!isEnabled())
+            return QString("Allocation tracking is not compiled in (CONFIG+=alloc_tracking).\n");
+
+        QString out = QString("Allocations through operator new only; Qt strings and containers "
+                              "(malloc) are not counted.\n");
+        out += QString("%1 %2 %3 %4 %5\n")
+                      .arg("operation", -24).arg("calls", 8).arg("allocations", 12)
+                      .arg("bytes", 14).arg("peak", 14);
+
+        foreach (const AllocationStats &stats, statistics())
+            out += QString("%1 %2 %3 %4 %5\n")
+                   .arg(stats.tag, -24).arg(stats.calls, 8).arg(stats.allocations, 12)
+                   .arg(stats.bytes, 14).arg(stats.peak, 14);
+
+        out += QString("process: %1 allocations, %2 bytes in use, peak %3 bytes\n")
+               .arg(totalAllocations()).arg(currentBytes()).arg(peakBytes());
+        return out;
+    }
+}
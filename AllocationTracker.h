@@ -0,0 +1,86 @@
+#ifndef ALLOCATIONTRACKER_H
+#define ALLOCATIONTRACKER_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// AllocationTracker counts heap allocations (calls, bytes, peak) per
+// tagged operation:
+//
+//     AllocationScope scope("fillTable");
+//
+// It replaces the global operator new/delete and is only compiled in
+// with ENVEXPLORER_ALLOC_TRACKING (qmake CONFIG+=alloc_tracking);
+// otherwise scopes cost nothing and no statistics are kept.
+//
+// Only operator new is seen: Qt containers and strings allocate with
+// malloc() and are not counted; reports say so. Allocations and bytes
+// are counted per thread, so a scope counts what its own thread
+// allocated. Bytes in use are process-wide (a block may be freed on
+// another thread); the peak of a scope is the highest growth of the
+// process above its start, as seen at the scope's allocations.
+//
+
+#include <QString>
+#include <QList>
+
+namespace EnvironmentExplorer
+{
+    struct AllocationStats
+    {
+        QString tag;
+        quint64 calls;          // scopes entered
+        quint64 allocations;
+        quint64 bytes;
+        qint64 peak;            // highest growth within one call
+    };
+
+#if defined(ENVEXPLORER_ALLOC_TRACKING)
+    class AllocationScope
+    {
+        Q_DISABLE_COPY(AllocationScope)
+
+    public:
+        // The tag must outlive the program (a string literal).
+        explicit AllocationScope(const char* tag);
+        ~AllocationScope();
+
+    private:
+        const char* tag;
+        quint64 allocations, bytes;
+        qint64 current, outerPeak;
+    };
+#else
+    class AllocationScope
+    {
+    public:
+        explicit AllocationScope(const char*) {}
+    };
+#endif
+
+    class AllocationTracker
+    {
+    public:
+        static bool isEnabled();
+
+        // Per tag, in order of first use.
+        static QList<AllocationStats> statistics();
+        static void reset();
+
+        // Whole process.
+        static quint64 totalAllocations();
+        static qint64 currentBytes();
+        static qint64 peakBytes();
+
+        // Plain text table of the above.
+        static QString report();
+    };
+}
+
+#endif // ALLOCATIONTRACKER_H
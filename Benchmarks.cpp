@@ -0,0 +1,1310 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "Benchmarks.h"
+#include "VariablesManager.h"
+#include "EffectiveEnvironment.h"
+#include "ProcessScanner.h"
+#include "EnvironmentImporter.h"
+#include "ValueCodec.h"
+#include "ProcessLauncher.h"
+#include "VariableOrder.h"
+#include "ExportPipeline.h"
+#include "SizeProfiler.h"
+#include "RunMetrics.h"
+#include "MainDialog.h"
+#include "MainDialogUi.h"
+#include "ListValueDelegate.h"
+#include "BulkReplace.h"
+#include "VariableQuery.h"
+#include "FleetAggregator.h"
+#include "ChangeJournal.h"
+#include "EnvironmentMerge.h"
+#include "EnvironmentProfiles.h"
+
+#include <QTemporaryDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QEventLoop>
+#include <QApplication>
+#include <QClipboard>
+#include <QKeyEvent>
+#include <QListView>
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QScrollBar>
+#include <QVector>
+#include <QThread>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QFuture>
+
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <string.h>
+
+#if defined(Q_OS_WIN)
+#include <qt_windows.h>
+#endif
+
+namespace EnvironmentExplorer
+{
+    struct Comparison
+    {
+        QString title;
+        const char* incremental;    // or the new way
+        const char* full;           // or the old way
+    };
+
+    struct BenchmarkRun
+    {
+        int variables;
+        int edits;
+
+        // holds the made-up variables
+        VariablesManager* manager;
+
+        QList<Comparison> comparisons;
+
+        // figures other than times, one line each
+        QStringList notes;
+    };
+
+    static Variable variable(int i, int entries)
+    {
+        Variable var;
+        var.name = QString("BENCH_%1").arg(i);
+        var.type = (i % 2) ? Variable::User : Variable::Global;
+
+        if (entries == 1)
+            var.value = QString("C:\\Bench\\%1").arg(i);
+        else
+        {
+            QStringList list;
+            for (int e = 0; e < entries; ++e)
+                list.append(QString("C:\\Bench\\%1\\%2\\bin").arg(i % 1000).arg(e));
+            var.value = list;
+        }
+
+        return var;
+    }
+
+    // The n-th edit: some variable, spread over the table, gets
+    // another number of entries (and so another length).
+    static Variable edit(int n, int variables)
+    { return variable(int((qint64(n) * 7919) % variables), n % 16 + 1); }
+
+    // As if loaded; edits go to the overlay.
+    static void populate(VariablesManager &manager, int variables)
+    {
+        QList<Variable> loaded;
+        for (int i = 0; i < variables; ++i)
+            loaded.append(variable(i, i % 16 + 1));
+        manager.loadVariables(loaded);
+    }
+
+    // Bytes of the heap blocks in use, over all heaps of the process
+    // (Qt allocates with malloc(), which operator new counts miss);
+    // -1 where it cannot be told.
+    static qint64 heapBytesInUse()
+    {
+#if defined(Q_OS_WIN)
+        QVector<HANDLE> heaps(GetProcessHeaps(0, 0));
+        heaps.resize(qMin(int(GetProcessHeaps(heaps.count(), heaps.data())), heaps.count()));
+
+        qint64 bytes = 0;
+        foreach (HANDLE heap, heaps)
+        {
+            if (!HeapLock(heap))
+                continue;
+
+            PROCESS_HEAP_ENTRY entry;
+            entry.lpData = 0;
+            while (HeapWalk(heap, &entry))
+                if (entry.wFlags & PROCESS_HEAP_ENTRY_BUSY)
+                    bytes += entry.cbData;
+
+            HeapUnlock(heap);
+        }
+
+        return bytes;
+#else
+        return -1;
+#endif
+    }
+
+    static QString megabytes(qint64 bytes)
+    { return QString::number(double(bytes) / (1024 * 1024), 'f', 1); }
+
+    // MB/s
+    static QString throughput(qint64 bytes, qint64 ns)
+    { return QString::number(double(bytes) / (1024 * 1024) / (double(qMax(ns, qint64(1))) / 1e9), 'f', 1); }
+
+    // Variable as it was before the overlay: each entry carried
+    // copies of its loaded name and value.
+    struct LegacyVariable
+    {
+        QString name, defaultName;
+        QVariant value, defaultValue;
+        Variable::Type type;
+    };
+
+    // Memory of the loaded variables and 100 edits: the shared
+    // baseline with a sparse overlay against one table of variables
+    // holding their defaults, edited as editVariable() used to.
+    static void benchmarkStorage(BenchmarkRun &run)
+    {
+        const int edits = 100;
+
+        if (heapBytesInUse() < 0)
+        {
+            run.notes.append("storage: the heap cannot be measured here");
+            return;
+        }
+
+        qint64 before = heapBytesInUse();
+
+        VariablesManager manager;
+        {
+            OperationTimer timer("bench_storage_overlay");
+            populate(manager, run.variables);
+            for (int n = 0; n < edits; ++n)
+                manager.addVariable(edit(n, run.variables));
+        }
+
+        qint64 overlay = heapBytesInUse() - before;
+        before = heapBytesInUse();
+
+        QHash<QString, LegacyVariable> tables[2];
+        {
+            OperationTimer timer("bench_storage_legacy");
+
+            for (int i = 0; i < run.variables; ++i)
+            {
+                Variable var = variable(i, i % 16 + 1);
+
+                LegacyVariable legacy;
+                legacy.name = legacy.defaultName = var.name;
+                legacy.value = legacy.defaultValue = var.value;
+                legacy.type = var.type;
+                tables[var.type].insert(var.name, legacy);
+            }
+
+            for (int n = 0; n < edits; ++n)
+            {
+                Variable var = edit(n, run.variables);
+
+                LegacyVariable legacy = tables[var.type].value(var.name);
+                legacy.value = var.value;
+                tables[var.type].insert(var.name, legacy);
+            }
+        }
+
+        qint64 legacy = heapBytesInUse() - before;
+
+        run.notes.append(QString("storage of %1 variables and %2 edits: baseline and overlay %3 MB, "
+                                 "defaults in every variable %4 MB")
+                         .arg(run.variables).arg(edits).arg(megabytes(overlay)).arg(megabytes(legacy)));
+    }
+
+    // A 10k-entry list opened in the editor, up to its first paint,
+    // and 10k entries pasted into it with Ctrl+V.
+    static void benchmarkListEditor(BenchmarkRun &)
+    {
+        const int entries = 10000;
+
+        QStringList list;
+        for (int e = 0; e < entries; ++e)
+            list.append(QString("C:\\Bench\\%1\\bin").arg(e));
+        QString joined = list.join("\n");
+
+        for (int n = 0; n < 5; ++n)
+        {
+            OperationTimer timer("bench_editor_open");
+
+            VariableDialog dialog;
+            dialog.setDialogMode(VariableDialog::EditVariable);
+            dialog.setVariableName("BENCHPATH");
+            dialog.setVariableValue(joined);
+            dialog.show();
+            QApplication::processEvents();
+        }
+
+        QString clipboard = QApplication::clipboard()->text();
+        QApplication::clipboard()->setText(joined);
+
+        for (int n = 0; n < 5; ++n)
+        {
+            VariableDialog dialog;
+            dialog.setDialogMode(VariableDialog::EditVariable);
+            dialog.setVariableName("BENCHPATH");
+            dialog.setVariableValue(QString("C:\\a\nC:\\b"));
+            dialog.show();
+            QApplication::processEvents();
+
+            QListView* view = dialog.findChild<QListView*>();
+            QKeyEvent paste(QEvent::KeyPress, Qt::Key_V, Qt::ControlModifier);
+
+            OperationTimer timer("bench_editor_paste");
+            QApplication::sendEvent(view, &paste);
+            QApplication::processEvents();
+        }
+
+        QApplication::clipboard()->setText(clipboard);
+    }
+
+    // Readers on 1 to N pool threads, each taking a snapshot and
+    // looking a variable up in it, as background analyses do.
+    static void benchmarkSnapshotReaders(BenchmarkRun &run)
+    {
+        const int reads = 200000; // per thread
+
+        QStringList names;
+        for (int i = 0; i < 1024; ++i)
+            names.append(variable(int((qint64(i) * 7919) % run.variables), 1).name);
+
+        VariablesManager* manager = run.manager;
+
+        for (int threads = 1; threads <= qMax(QThread::idealThreadCount(), 2); ++threads)
+        {
+            QThreadPool pool;
+            pool.setMaxThreadCount(threads);
+
+            QElapsedTimer elapsed;
+            elapsed.start();
+
+            QList<QFuture<int> > results;
+            for (int t = 0; t < threads; ++t)
+                results.append(QtConcurrent::run(&pool, [manager, &names, reads](){
+                    int found = 0;
+                    for (int i = 0; i < reads; ++i)
+                    {
+                        const QString &name = names.at(i % names.count());
+                        EnvironmentSnapshot snapshot = manager->snapshot();
+                        if (snapshot.lookup(name, Variable::User) || snapshot.lookup(name, Variable::Global))
+                            ++found;
+                    }
+                    return found;
+                }));
+
+            foreach (QFuture<int> result, results)
+                result.waitForFinished();
+
+            double seconds = double(elapsed.nsecsElapsed()) / 1e9;
+            run.notes.append(QString("snapshot readers on %1 thread(s): %2 reads/s")
+                             .arg(threads).arg(qint64(threads * reads / seconds)));
+        }
+    }
+
+    // The merged environment: one key merged again per edit against
+    // both scopes merged whole.
+    static void benchmarkEffective(BenchmarkRun &run)
+    {
+        EffectiveEnvironment environment(run.manager);
+
+        // merge_variable, through the signals
+        for (int n = 0; n < run.edits; ++n)
+            run.manager->addVariable(edit(n, run.variables));
+
+        // merge_environment
+        for (int n = 0; n < qMax(1, run.edits / 50); ++n)
+            environment.rebuild();
+
+        Comparison c = { "merged environment, incremental vs full", "merge_variable", "merge_environment" };
+        run.comparisons.append(c);
+    }
+
+    // 5,000 made-up processes of 60 variables, most of them shared
+    // (PATH comes in 8 flavours, a few are per process), parsed and
+    // aggregated as a scan does; then the processes running here.
+    static void benchmarkProcessScan(BenchmarkRun &run)
+    {
+        const int processes = 5000;
+        const int variables = 60;
+
+        QList<ProcessScanner::ProcessBlock> blocks;
+        for (int p = 0; p < processes; ++p)
+        {
+            ProcessScanner::ProcessBlock process;
+            process.pid = 1000 + p;
+            process.readable = (p % 20) != 0; // some are denied
+
+            QByteArray block;
+            for (int v = 0; v < variables; ++v)
+            {
+                if (v == 0)
+                {
+                    block += "Path=";
+                    for (int e = 0; e < 24; ++e)
+                        block += QString("C:\\Program Files\\Tool%1\\%2\\bin;").arg(e).arg(p % 8).toUtf8();
+                }
+                else if (v < 4)
+                    block += QString("BENCH_PROCESS_%1=%2").arg(v).arg(process.pid).toUtf8();
+                else
+                    block += QString("BENCH_%1=C:\\Bench\\%1").arg(v).toUtf8();
+                block += '\0';
+            }
+            process.block = block;
+            blocks.append(process);
+        }
+
+        ProcessScanResult result;
+        for (int n = 0; n < 5; ++n)
+        {
+            OperationTimer timer("bench_scan_5000");
+            result = ProcessScanner::aggregate(blocks);
+        }
+
+        run.notes.append(QString("process scan of %1 made-up processes: %2 variable(s), %3 denied")
+                         .arg(processes).arg(result.variables.count()).arg(result.deniedCount));
+
+        if (!ProcessScanner::isSupported())
+            return;
+
+        {
+            OperationTimer timer("bench_scan_live");
+            result = ProcessScanner::scan();
+        }
+
+        run.notes.append(QString("process scan of this system: %1 read, %2 denied")
+                         .arg(result.processCount).arg(result.deniedCount));
+    }
+
+    // Every stored value decoded and encoded again, and decoded as
+    // before the codec: contains(";"), then split(";").
+    static void benchmarkCodec(BenchmarkRun &run)
+    {
+        QStringList raw;
+        qint64 bytes = 0;
+        for (int i = 0; i < run.variables; ++i)
+        {
+            raw.append(ValueCodec::encode(variable(i, i % 16 + 1).value));
+            bytes += raw.last().size() * qint64(sizeof(QChar));
+        }
+
+        QList<QVariant> decoded;
+        decoded.reserve(raw.count());
+
+        QElapsedTimer elapsed;
+        elapsed.start();
+
+        {
+            OperationTimer timer("bench_codec_decode");
+            foreach (const QString &value, raw)
+                decoded.append(ValueCodec::decode(value));
+        }
+
+        qint64 decodeTime = elapsed.nsecsElapsed();
+        elapsed.restart();
+
+        qint64 length = 0;
+        {
+            OperationTimer timer("bench_codec_encode");
+            foreach (const QVariant &value, decoded)
+                length += ValueCodec::encode(value).size();
+        }
+
+        qint64 encodeTime = elapsed.nsecsElapsed();
+
+        decoded.clear();
+        {
+            OperationTimer timer("bench_codec_split");
+            foreach (const QString &value, raw)
+            {
+                if (value.contains(";"))
+                    decoded.append(value.split(";"));
+                else
+                    decoded.append(value);
+            }
+        }
+
+        Comparison c = { "decode of every value, codec vs contains() and split()",
+                         "bench_codec_decode", "bench_codec_split" };
+        run.comparisons.append(c);
+
+        run.notes.append(QString("codec over %1 MB of values: decode %2 MB/s, encode %3 MB/s")
+                         .arg(megabytes(bytes)).arg(throughput(bytes, decodeTime))
+                         .arg(throughput(length * qint64(sizeof(QChar)), encodeTime)));
+    }
+
+    // A table of 20k variables scrolled from top to bottom, one
+    // painted frame per step: lists drawn by ListValueDelegate against
+    // joined with "\n" and sized by resizeRowsToContents(), as before.
+    static void benchmarkScrolling(BenchmarkRun &run)
+    {
+        const int rows = 20000;
+        const int frames = 200;
+
+        for (int delegated = 1; delegated >= 0; --delegated)
+        {
+            QTableWidget table(rows, 2);
+            table.setVerticalScrollMode(QTableWidget::ScrollPerPixel);
+            table.horizontalHeader()->setStretchLastSection(true);
+            table.resize(1000, 800);
+
+            ListValueDelegate* delegate = 0;
+            if (delegated)
+            {
+                delegate = new ListValueDelegate(&table);
+                delegate->attach(&table, 1);
+            }
+
+            {
+                OperationTimer timer(delegated ? "bench_table_fill_delegate" : "bench_table_fill_resize");
+
+                for (int row = 0; row < rows; ++row)
+                {
+                    Variable var = variable(row, row % 16 + 1);
+                    QStringList entries = ValueCodec::entries(var.value);
+
+                    QTableWidgetItem* valueItem;
+                    if (delegated)
+                    {
+                        valueItem = new QTableWidgetItem(ValueCodec::encode(var.value));
+                        valueItem->setData(ListValueDelegate::EntriesRole, entries);
+                    }
+                    else
+                        valueItem = new QTableWidgetItem(entries.join("\n"));
+
+                    table.setItem(row, 0, new QTableWidgetItem(var.name));
+                    table.setItem(row, 1, valueItem);
+                }
+
+                if (delegated)
+                    delegate->resizeRows();
+                else
+                {
+                    table.resizeRowsToContents();
+                    table.resizeColumnsToContents();
+                }
+            }
+
+            table.show();
+            QApplication::processEvents();
+
+            QScrollBar* bar = table.verticalScrollBar();
+            for (int f = 1; f <= frames; ++f)
+            {
+                OperationTimer timer(delegated ? "bench_scroll_delegate" : "bench_scroll_resize");
+                bar->setValue(int(qint64(bar->maximum()) * f / frames));
+                table.viewport()->repaint();
+            }
+        }
+
+        Comparison fill = { "table of 20k variables filled, delegate vs resizeRowsToContents()",
+                            "bench_table_fill_delegate", "bench_table_fill_resize" };
+        Comparison scroll = { "scroll frame over 20k rows, delegate vs resizeRowsToContents()",
+                              "bench_scroll_delegate", "bench_scroll_resize" };
+        run.comparisons << fill << scroll;
+    }
+
+    // A toolchain moved: literal and regex replace over every value
+    // and list entry, on the pool and on one thread, then applied as
+    // one batch (and undone, the manager is shared).
+    static void benchmarkReplace(BenchmarkRun &run)
+    {
+        ReplaceOptions literal;
+        literal.find = "C:\\Bench\\7";
+        literal.replacement = "D:\\Moved\\7";
+
+        ReplaceOptions regex;
+        regex.find = "^C:\\\\Bench\\\\\\d*7\\\\";
+        regex.replacement = "D:\\Moved\\";
+        regex.regularExpression = true;
+
+        EnvironmentSnapshot snapshot = run.manager->snapshot();
+        QList<ReplaceChange> changes;
+
+        for (int n = 0; n < 3; ++n)
+        {
+            {
+                OperationTimer timer("bench_replace_literal");
+                changes = BulkReplace::preview(snapshot, literal);
+            }
+            {
+                OperationTimer timer("bench_replace_regex");
+                BulkReplace::preview(snapshot, regex);
+            }
+        }
+
+        int threads = QThreadPool::globalInstance()->maxThreadCount();
+        QThreadPool::globalInstance()->setMaxThreadCount(1);
+        {
+            OperationTimer timer("bench_replace_literal_1_thread");
+            BulkReplace::preview(snapshot, literal);
+        }
+        QThreadPool::globalInstance()->setMaxThreadCount(threads);
+
+        BatchEditCommand command(run.manager, changes, "Replace");
+        {
+            OperationTimer timer("bench_replace_apply");
+            command.redo();
+        }
+        command.undo();
+
+        Comparison c = { "literal replace over all values, pool vs one thread",
+                         "bench_replace_literal", "bench_replace_literal_1_thread" };
+        run.comparisons.append(c);
+
+        run.notes.append(QString("replace over %1 variables: %2 changed").arg(run.variables).arg(changes.count()));
+    }
+
+    // Compiled once, run over every variable: select(), which goes
+    // parallel, against matches() called one variable after another.
+    static void benchmarkQuery(BenchmarkRun &run)
+    {
+        const QString text = "scope:user entries>10 value~\"Bench.3[0-9]\" -name:BENCH_1";
+
+        VariableQuery query;
+        {
+            OperationTimer timer("bench_query_compile");
+            if (!query.compile(text))
+            {
+                run.notes.append("query: " + query.errorString());
+                return;
+            }
+        }
+
+        EnvironmentSnapshot snapshot = run.manager->snapshot();
+        QueryResult result;
+
+        for (int n = 0; n < 5; ++n)
+        {
+            {
+                OperationTimer timer("bench_query_select");
+                result = query.select(snapshot);
+            }
+            {
+                OperationTimer timer("bench_query_one_by_one");
+
+                QList<Variable> selected;
+                foreach (const Variable &var, snapshot.systemEnvironment() + snapshot.userEnvironment())
+                    if (query.matches(var, snapshot))
+                        selected.append(var);
+            }
+        }
+
+        Comparison c = { "query over all variables, select() vs matches() in a loop",
+                         "bench_query_select", "bench_query_one_by_one" };
+        run.comparisons.append(c);
+
+        run.notes.append(QString("query %1 over %2 variables: %3 selected")
+                         .arg(text).arg(run.variables).arg(result.variables.count()));
+    }
+
+    // 10k machines, one .env file each: 40 common variables, a PATH
+    // in 16 flavours and a few values per machine; read with all
+    // threads against one.
+    static void benchmarkFleet(BenchmarkRun &run)
+    {
+        const int machines = 10000;
+
+        QTemporaryDir dir;
+        for (int m = 0; m < machines; ++m)
+        {
+            QFile file(QString("%1/machine%2.env").arg(dir.path()).arg(m));
+            if (!file.open(QFile::WriteOnly))
+            {
+                run.notes.append("fleet: " + file.errorString());
+                return;
+            }
+
+            QByteArray content;
+            for (int v = 0; v < 40; ++v)
+                content += QString("BENCH_%1=C:\\Bench\\%1\n").arg(v).toUtf8();
+
+            content += "Path=" + ValueCodec::encode(variable(m % 16, 12).value).toUtf8() + "\n";
+            content += QString("COMPUTERNAME=MACHINE%1\n").arg(m).toUtf8();
+
+            // every 100th machine lacks one and has an odd one
+            if (m % 100 == 0)
+                content.replace("BENCH_7=", "BENCH_X=");
+
+            file.write(content);
+        }
+
+        FleetStatistics stats;
+        {
+            OperationTimer timer("bench_fleet_threads");
+            stats = FleetAggregator::aggregate(dir.path());
+        }
+        {
+            OperationTimer timer("bench_fleet_1_thread");
+            FleetAggregator::aggregate(dir.path(), 1);
+        }
+
+        Comparison c = { "fleet of 10k snapshot files, all threads vs one",
+                         "bench_fleet_threads", "bench_fleet_1_thread" };
+        run.comparisons.append(c);
+
+        run.notes.append(QString("fleet of %1 files: %2 read, %3 failed, %4 variable(s), %5 outlier(s)")
+                         .arg(machines).arg(stats.machineCount).arg(stats.failedCount)
+                         .arg(stats.variables.count()).arg(stats.outliers.count()));
+    }
+
+    // 1M records appended as 1,000 saves of 1,000 changes (one sync
+    // each), then replayed and read back whole.
+    static void benchmarkJournal(BenchmarkRun &run)
+    {
+        const int saves = 1000;
+        const int changes = 1000;
+
+        QTemporaryDir dir;
+        ChangeJournal journal(dir.path() + "/changes.journal");
+        if (!journal.compact(EnvironmentBaseline(), 0))
+        {
+            run.notes.append("journal: " + journal.errorString());
+            return;
+        }
+
+        QElapsedTimer elapsed;
+        elapsed.start();
+
+        for (int n = 0; n < saves; ++n)
+        {
+            QList<JournalEntry> entries;
+            for (int c = 0; c < changes; ++c)
+            {
+                JournalEntry entry;
+                entry.timestamp = n + 1;
+                entry.before = variable(c, (n + c) % 16 + 1);
+                entry.after = variable(c, (n + c + 1) % 16 + 1);
+                entries.append(entry);
+            }
+
+            OperationTimer timer("bench_journal_append");
+            if (!journal.append(entries))
+            {
+                run.notes.append("journal: " + journal.errorString());
+                return;
+            }
+        }
+
+        qint64 appendTime = elapsed.nsecsElapsed();
+        elapsed.restart();
+
+        EnvironmentBaseline state;
+        bool replayed;
+        {
+            OperationTimer timer("bench_journal_replay");
+            replayed = journal.replay(saves, state);
+        }
+
+        qint64 replayTime = elapsed.nsecsElapsed();
+
+        if (!replayed)
+        {
+            run.notes.append("journal: " + journal.errorString());
+            return;
+        }
+
+        int records;
+        {
+            OperationTimer timer("bench_journal_entries");
+            records = journal.entries().count();
+        }
+
+        run.notes.append(QString("journal of %1 records (%2 MB): append %3 records/s, replay %4 records/s")
+                         .arg(records).arg(megabytes(QFileInfo(journal.fileName()).size()))
+                         .arg(qint64(double(saves) * changes / (double(appendTime) / 1e9)))
+                         .arg(qint64(double(saves) * changes / (double(replayTime) / 1e9))));
+    }
+
+    // List values packed into the path trie against kept as plain
+    // QStringLists: memory, reading every value (environment()
+    // unpacks each list) and packing edited values, as a save does.
+    static void benchmarkTrie(BenchmarkRun &run)
+    {
+        qint64 before = heapBytesInUse();
+
+        EnvironmentBaseline packed;
+        for (int i = 0; i < run.variables; ++i)
+        {
+            Variable var = variable(i, i % 16 + 1);
+            ((var.type == Variable::Global) ? packed.globals : packed.locals).insert(var.name, var);
+        }
+        packed.pack();
+
+        qint64 trieBytes = heapBytesInUse() - before;
+        before = heapBytesInUse();
+
+        VariableTable plain[2];
+        for (int i = 0; i < run.variables; ++i)
+        {
+            Variable var = variable(i, i % 16 + 1);
+            plain[var.type].insert(var.name, var);
+        }
+
+        qint64 listBytes = heapBytesInUse() - before;
+
+        // unpacked as EnvironmentSnapshot::environment() does
+        for (int n = 0; n < 5; ++n)
+        {
+            {
+                OperationTimer timer("bench_trie_iterate");
+                foreach (const Variable &var, packed.globals)
+                    EnvironmentBaseline::unpack(var);
+                foreach (const Variable &var, packed.locals)
+                    EnvironmentBaseline::unpack(var);
+            }
+            {
+                OperationTimer timer("bench_stringlist_iterate");
+                foreach (const Variable &var, plain[Variable::Global])
+                    ValueCodec::entries(var.value);
+                foreach (const Variable &var, plain[Variable::User])
+                    ValueCodec::entries(var.value);
+            }
+        }
+
+        for (int n = 0; n < run.edits; ++n)
+        {
+            Variable var = edit(n, run.variables);
+            {
+                OperationTimer timer("bench_trie_edit");
+                VariableTable &table = (var.type == Variable::Global) ? packed.globals : packed.locals;
+                table.insert(var.name, packed.pack(var));
+            }
+            {
+                OperationTimer timer("bench_stringlist_edit");
+                plain[var.type].insert(var.name, var);
+            }
+        }
+
+        Comparison iterate = { "every value read, trie vs QStringList",
+                               "bench_trie_iterate", "bench_stringlist_iterate" };
+        Comparison edits = { "edited value stored, trie vs QStringList",
+                             "bench_trie_edit", "bench_stringlist_edit" };
+        run.comparisons << iterate << edits;
+
+        if (trieBytes >= 0)
+            run.notes.append(QString("list values of %1 variables: trie %2 MB (%3 nodes), QStringList %4 MB")
+                             .arg(run.variables).arg(megabytes(trieBytes)).arg(packed.paths->nodeCount())
+                             .arg(megabytes(listBytes)));
+    }
+
+    // The main window up to its first paint, as the program starts,
+    // against the same with what it used to build before showing:
+    // the variable dialog, the merged environment and the export
+    // template. Both load the variables from the registry.
+    static void benchmarkStartup(BenchmarkRun &run)
+    {
+        // loaded beforehand, the merge alone is what was eager
+        VariablesManager registry;
+        registry.loadVariables();
+
+        for (int n = 0; n < 5; ++n)
+        {
+            {
+                OperationTimer timer("bench_startup_deferred");
+
+                MainDialog window;
+                window.show();
+                QApplication::processEvents();
+            }
+            {
+                OperationTimer timer("bench_startup_eager");
+
+                MainDialog window;
+                new VariableDialog(&window);
+                EffectiveEnvironment environment(&registry);
+
+                QFile file("://template.html");
+                file.open(QFile::ReadOnly);
+                QString html = file.readAll();
+
+                window.show();
+                QApplication::processEvents();
+            }
+        }
+
+        Comparison c = { "main window to first paint, deferred vs eager",
+                         "bench_startup_deferred", "bench_startup_eager" };
+        run.comparisons.append(c);
+    }
+
+    // Save against a store someone else changed: 1% of the keys
+    // changed outside, our edits on top. Told apart by the hashes
+    // kept at load, only the changed values decoded, against the
+    // whole store decoded again and compared (a reload). The store
+    // is a table of raw values, the registry is not touched.
+    static void benchmarkMerge(BenchmarkRun &run)
+    {
+        QHash<QString, QString> store;      // key -> raw, as written by others
+        QHash<QString, uint> hashes;        // key -> hash, at load
+        VariableTable base;
+
+        for (int i = 0; i < run.variables; ++i)
+        {
+            Variable var = variable(i, i % 16 + 1);
+            QString key = Variable::key(var.name, var.type);
+            QString raw = ValueCodec::encode(var.value);
+
+            base.insert(key, var);
+            hashes.insert(key, EnvironmentMerge::storedHash(raw, false));
+
+            // theirs: an entry added to every 100th
+            if (i % 100 == 0)
+                raw += QString(";C:\\Theirs\\%1").arg(i);
+            store.insert(key, raw);
+        }
+
+        VariableTable ours;
+        for (int n = 0; n < run.edits; ++n)
+        {
+            Variable var = edit(n, run.variables);
+            ours.insert(Variable::key(var.name, var.type), var);
+        }
+
+        // merges our edits with the values changed outside
+        auto mergeEdits = [&](const VariableTable &theirs, int *conflicts){
+            int merged = 0;
+            for (VariableTable::const_iterator it = ours.constBegin(); it != ours.constEnd(); ++it)
+            {
+                VariableTable::const_iterator changed = theirs.constFind(it.key());
+                if (changed == theirs.constEnd())
+                    continue;
+
+                Variable result;
+                if (EnvironmentMerge::merge(base.value(it.key()), it.value(), changed.value(), &result))
+                    ++merged;
+                else
+                    ++*conflicts;
+            }
+            return merged;
+        };
+
+        int changedCount = 0, merged = 0, conflicts = 0;
+        for (int n = 0; n < 3; ++n)
+        {
+            {
+                OperationTimer timer("bench_merge_hashed");
+
+                VariableTable theirs;
+                QHash<QString, QString>::const_iterator it = store.constBegin();
+                for (; it != store.constEnd(); ++it)
+                {
+                    if (hashes.value(it.key()) == EnvironmentMerge::storedHash(it.value(), false))
+                        continue;
+
+                    Variable var = base.value(it.key());
+                    var.value = ValueCodec::decode(it.value());
+                    theirs.insert(it.key(), var);
+                }
+
+                changedCount = theirs.count();
+                conflicts = 0;
+                merged = mergeEdits(theirs, &conflicts);
+            }
+            {
+                OperationTimer timer("bench_merge_full");
+
+                VariableTable theirs;
+                QHash<QString, QString>::const_iterator it = store.constBegin();
+                for (; it != store.constEnd(); ++it)
+                {
+                    Variable var = base.value(it.key());
+                    QVariant value = ValueCodec::decode(it.value());
+                    if (value == var.value)
+                        continue;
+
+                    var.value = value;
+                    theirs.insert(it.key(), var);
+                }
+
+                int fullConflicts = 0;
+                mergeEdits(theirs, &fullConflicts);
+            }
+        }
+
+        Comparison c = { "save merge over all keys, hashes vs reload",
+                         "bench_merge_hashed", "bench_merge_full" };
+        run.comparisons.append(c);
+
+        run.notes.append(QString("merge over %1 keys: %2 changed outside, %3 of our edits merged, %4 conflict(s)")
+                         .arg(run.variables).arg(changedCount).arg(merged).arg(conflicts));
+    }
+
+    // A profile of 1,000 variables, half of them already as it wants
+    // them, applied as its plan against the whole environment it
+    // leads to put again. Writes are the values save would write to
+    // the registry; nothing is saved.
+    static void benchmarkProfiles(BenchmarkRun &run)
+    {
+        VariablesManager manager;
+        populate(manager, run.variables);
+
+        EnvironmentProfile first, second;
+        first.name = "first";
+        second.name = "second";
+
+        for (int n = 0; n < 1000; ++n)
+        {
+            int i = int((qint64(n) * 7919) % run.variables);
+            Variable var = variable(i, (n % 2) ? i % 16 + 1 : i % 16 + 2);
+
+            if (n % 10 == 9)
+                var.value = QVariant(); // removed
+
+            VariableTable &table = (var.type == Variable::Global) ? first.globals : first.locals;
+            table.insert(var.name, var);
+
+            // the other one differs in every 4th
+            if (n % 4 == 0)
+                var = variable(i, 1);
+            ((var.type == Variable::Global) ? second.globals : second.locals).insert(var.name, var);
+        }
+
+        QList<ReplaceChange> changes;
+        for (int n = 0; n < 5; ++n)
+        {
+            EnvironmentSnapshot snapshot = manager.snapshot();
+
+            {
+                OperationTimer timer("bench_profile_plan");
+                changes = EnvironmentProfiles::plan(first, snapshot);
+            }
+            {
+                OperationTimer timer("bench_profile_compare");
+                EnvironmentProfiles::compare(first, second);
+            }
+
+            QList<Variable> batch;
+            foreach (const ReplaceChange &change, changes)
+                batch.append(change.after);
+
+            {
+                OperationTimer timer("bench_profile_apply");
+                manager.addVariables(batch);
+            }
+            manager.reset();
+
+            // the environment the profile leads to, every variable put
+            QList<Variable> full;
+            for (int scope = Variable::Global; scope <= Variable::User; ++scope)
+                foreach (Variable var, snapshot.environment(Variable::Type(scope)))
+                {
+                    const VariableTable &table = first.table(var.type);
+                    if (table.contains(var.name))
+                        var = table.value(var.name);
+                    full.append(var);
+                }
+
+            {
+                OperationTimer timer("bench_profile_apply_full");
+                manager.addVariables(full);
+            }
+            manager.reset();
+
+            if (n == 0)
+                run.notes.append(QString("profile of %1 variables over %2: %3 backend write(s) "
+                                         "against %4 for the full environment")
+                                 .arg(first.count()).arg(run.variables).arg(changes.count()).arg(full.count()));
+        }
+
+        Comparison c = { "profile applied, plan vs full environment",
+                         "bench_profile_apply", "bench_profile_apply_full" };
+        run.comparisons.append(c);
+    }
+
+    // A 1 GB .env file streamed through the importer, batches
+    // dropped as they come.
+    static void benchmarkImport(BenchmarkRun &run)
+    {
+        const qint64 size = qint64(1024) * 1024 * 1024;
+
+        QTemporaryDir dir;
+        QFile file(dir.path() + "/bench.env");
+        if (!file.open(QFile::WriteOnly))
+        {
+            run.notes.append("import: " + file.errorString());
+            return;
+        }
+
+        QByteArray chunk;
+        for (int i = 0; chunk.size() < 4 * 1024 * 1024; ++i)
+            chunk += QString("BENCH_%1=%2\n").arg(i)
+                     .arg(ValueCodec::encode(variable(i, i % 16 + 1).value)).toUtf8();
+
+        qint64 written = 0;
+        while (written < size)
+        {
+            if (file.write(chunk) != chunk.size())
+            {
+                run.notes.append("import: " + file.errorString());
+                return;
+            }
+            written += chunk.size();
+        }
+        file.close();
+
+        EnvironmentImporter importer;
+        importer.setFormat(EnvironmentImporter::DotEnv);
+
+        QElapsedTimer elapsed;
+        elapsed.start();
+
+        bool imported;
+        {
+            OperationTimer timer("bench_import_1gb");
+            imported = importer.importFile(file.fileName());
+        }
+
+        if (!imported)
+        {
+            run.notes.append("import: " + importer.errorString());
+            return;
+        }
+
+        double seconds = double(elapsed.nsecsElapsed()) / 1e9;
+        run.notes.append(QString("import of a %1 MB .env file: %2 records, %3 MB/s")
+                         .arg(megabytes(written)).arg(importer.recordCount())
+                         .arg(QString::number(double(written) / (1024 * 1024) / seconds, 'f', 1)));
+    }
+
+    // Sorted by length, so that an edit moves its row.
+    static void benchmarkOrder(BenchmarkRun &run)
+    {
+        VariableOrder order;
+        order.setSorting(VariableOrder::Length);
+        order.setGrouping(VariableOrder::GroupByScope);
+        order.rebuild(run.manager->snapshot());
+
+        for (int n = 0; n < run.edits; ++n)
+        {
+            Variable var = edit(n, run.variables);
+            run.manager->addVariable(var);
+
+            EnvironmentSnapshot snapshot = run.manager->snapshot();
+            int from, to;
+
+            OperationTimer timer("bench_order_update");
+            order.update(snapshot, var.name, var.type, &from, &to);
+        }
+
+        // a full sort per edit takes long, a few are enough
+        for (int n = 0; n < qMax(1, run.edits / 50); ++n)
+        {
+            run.manager->addVariable(edit(n, run.variables));
+
+            EnvironmentSnapshot snapshot = run.manager->snapshot();
+
+            OperationTimer timer("bench_order_resort");
+            order.rebuild(snapshot);
+        }
+
+        Comparison c = { "row order, update vs re-sort", "bench_order_update", "bench_order_resort" };
+        run.comparisons.append(c);
+    }
+
+    // On 10k variables: the block built whole against one key patched,
+    // and launches one after another.
+    static void benchmarkLaunch(BenchmarkRun &run)
+    {
+        const int variables = 10000;
+
+        VariablesManager manager;
+        populate(manager, variables);
+
+        EffectiveEnvironment environment(&manager);
+        ProcessLauncher launcher(&environment);
+
+        // environment_patch, through the signals
+        for (int n = 0; n < run.edits; ++n)
+            manager.addVariable(edit(n, variables));
+
+        // environment_block, after the merge
+        for (int n = 0; n < 20; ++n)
+            environment.rebuild();
+
+        QEventLoop loop;
+        int finished = 0;
+        QObject::connect(&launcher, &ProcessLauncher::finished, [&](){
+            ++finished;
+            loop.quit();
+        });
+
+        for (int n = 0; n < 20; ++n)
+        {
+            OperationTimer timer("bench_launch_roundtrip");
+            launcher.launch("cmd /c exit");
+
+            // it may have failed at once
+            if (finished == n)
+                loop.exec();
+        }
+
+        Comparison c = { "launch environment of 10k variables, patch vs rebuild",
+                         "environment_patch", "environment_block" };
+        run.comparisons.append(c);
+    }
+
+    // Four formats in one pass against one pass per format.
+    static void benchmarkExport(BenchmarkRun &run)
+    {
+        QList<ExportPipeline::Format> formats;
+        formats << ExportPipeline::Html << ExportPipeline::PlainText
+                << ExportPipeline::Json << ExportPipeline::DotEnv;
+
+        EnvironmentSnapshot snapshot = run.manager->snapshot();
+        QList<Variable> records = snapshot.environment(Variable::Global) + snapshot.environment(Variable::User);
+
+        QTemporaryDir dir;
+        QString base = dir.path() + "/bench";
+
+        auto walk = [&](ExportPipeline &pipeline){
+            int i = 0;
+            pipeline.run([&](Variable* var){
+                if (i == records.count())
+                    return false;
+                *var = records.at(i++);
+                return true;
+            });
+        };
+
+        for (int n = 0; n < 3; ++n)
+        {
+            {
+                OperationTimer timer("bench_export_together");
+
+                ExportPipeline pipeline("bench", "00:00:00");
+                foreach (ExportPipeline::Format format, formats)
+                    pipeline.addTarget(format, ExportPipeline::fileName(base, format));
+                walk(pipeline);
+            }
+            {
+                OperationTimer timer("bench_export_one_by_one");
+
+                foreach (ExportPipeline::Format format, formats)
+                {
+                    ExportPipeline pipeline("bench", "00:00:00");
+                    pipeline.addTarget(format, ExportPipeline::fileName(base, format));
+                    walk(pipeline);
+                }
+            }
+        }
+
+        Comparison c = { "export of 4 formats, at once vs one by one",
+                         "bench_export_together", "bench_export_one_by_one" };
+        run.comparisons.append(c);
+    }
+
+    // Statistics of one variable updated against all rebuilt, and the
+    // rankings, which sort only the top.
+    static void benchmarkProfiler(BenchmarkRun &run)
+    {
+        SizeProfiler profiler(run.manager);
+
+        // profile_variable, through the signals
+        for (int n = 0; n < run.edits; ++n)
+            run.manager->addVariable(edit(n, run.variables));
+
+        for (int n = 0; n < run.edits; ++n)
+        {
+            OperationTimer timer("bench_profiler_top");
+            profiler.top(SizeProfiler::Ranking(n % 4), 50);
+        }
+
+        // profile_sizes
+        for (int n = 0; n < qMax(1, run.edits / 50); ++n)
+            profiler.rebuild();
+
+        Comparison c = { "size profiler, update vs rebuild", "profile_variable", "profile_sizes" };
+        run.comparisons.append(c);
+    }
+
+    typedef void (*BenchmarkFunction)(BenchmarkRun &run);
+
+    struct Benchmark
+    {
+        const char* name;
+        BenchmarkFunction function;
+    };
+
+    static const Benchmark benchmarks[] = {
+        { "editor",     benchmarkListEditor },
+        { "storage",    benchmarkStorage },
+        { "snapshot",   benchmarkSnapshotReaders },
+        { "effective",  benchmarkEffective },
+        { "processes",  benchmarkProcessScan },
+        { "import",     benchmarkImport },
+        { "codec",      benchmarkCodec },
+        { "scrolling",  benchmarkScrolling },
+        { "replace",    benchmarkReplace },
+        { "query",      benchmarkQuery },
+        { "fleet",      benchmarkFleet },
+        { "journal",    benchmarkJournal },
+        { "trie",       benchmarkTrie },
+        { "startup",    benchmarkStartup },
+        { "merge",      benchmarkMerge },
+        { "profiles",   benchmarkProfiles },
+        { "launch",     benchmarkLaunch },
+        { "order",      benchmarkOrder },
+        { "export",     benchmarkExport },
+        { "profiler",   benchmarkProfiler }
+    };
+
+    static const int benchmarkCount = int(sizeof(benchmarks) / sizeof(benchmarks[0]));
+
+    static qint64 meanOf(const QList<OperationStats> &timings, const char* operation)
+    {
+        foreach (const OperationStats &stats, timings)
+            if (strcmp(stats.operation, operation) == 0 && stats.calls > 0)
+                return stats.total / qint64(stats.calls);
+        return 0;
+    }
+
+    static QString ms(qint64 ns)
+    { return QString::number(double(ns) / 1e6, 'f', 3); }
+
+    QStringList Benchmarks::names()
+    {
+        QStringList result;
+        for (int i = 0; i < benchmarkCount; ++i)
+            result.append(benchmarks[i].name);
+        return result;
+    }
+
+    QString Benchmarks::run(int variables, const QStringList &only)
+    {
+        BenchmarkRun run;
+        run.variables = qMax(variables, 2);
+        run.edits = 1000;
+
+        VariablesManager manager;
+        populate(manager, run.variables);
+        run.manager = &manager;
+
+        for (int i = 0; i < benchmarkCount; ++i)
+            if (only.isEmpty() || only.contains(benchmarks[i].name))
+                benchmarks[i].function(run);
+
+        QList<OperationStats> timings = RunMetrics::operations();
+
+        QString out = QString("%1 variable(s), %2 edit(s)\n\n").arg(run.variables).arg(run.edits);
+        out += QString("%1 %2 %3 %4\n").arg("operation", -32).arg("calls", 8)
+               .arg("mean ms", 12).arg("total ms", 12);
+
+        foreach (const OperationStats &stats, timings)
+            out += QString("%1 %2 %3 %4\n").arg(stats.operation, -32).arg(stats.calls, 8)
+                   .arg(ms(stats.calls ? stats.total / qint64(stats.calls) : 0), 12)
+                   .arg(ms(stats.total), 12);
+
+        if (!run.comparisons.isEmpty())
+            out += "\n";
+
+        foreach (const Comparison &c, run.comparisons)
+            out += QString("%1: %2 ms vs %3 ms\n").arg(c.title)
+                   .arg(ms(meanOf(timings, c.incremental))).arg(ms(meanOf(timings, c.full)));
+
+        if (!run.notes.isEmpty())
+            out += "\n" + run.notes.join("\n") + "\n";
+
+        return out;
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// Benchmarks runs the operations on made-up data of a given size,
+// mostly an incremental path against doing the whole work again.
+// Timings go through OperationTimer, as "bench_*" operations next to
+// the ones the code times itself, so the report is the RunMetrics
+// table plus one line per comparison:
+//
+//     QTextStream(stdout) << Benchmarks::run(100000);
+//
+// Nothing is written to the registry; only the startup benchmark
+// reads it, as the program does. Benchmarks of dialogs show them,
+// so they need a QApplication.
+//
+
+#include <QStringList>
+#include <QString>
+
+namespace EnvironmentExplorer
+{
+    class Benchmarks
+    {
+    public:
+        // In the order run() runs them.
+        static QStringList names();
+
+        // The named benchmarks, all when none are named. Made-up
+        // variables, half system and half user, each list holding
+        // up to 16 entries.
+        static QString run(int variables, const QStringList &only = QStringList());
+    };
+}
+
+#endif // BENCHMARKS_H
@@ -0,0 +1,194 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "BulkReplace.h"
+#include "VariablesManager.h"
+
+#include <QtConcurrent/QtConcurrentMap>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QRegExp>
+
+#include <algorithm>
+
+namespace EnvironmentExplorer
+{
+    // Map step, called concurrently; only reads its members.
+    struct ReplaceInVariable
+    {
+        typedef ReplaceChange result_type;
+
+        ReplaceInVariable(const ReplaceOptions &options)
+            : options(options)
+        {
+            QRegularExpression::PatternOptions flags = QRegularExpression::NoPatternOption;
+            if (options.caseSensitivity == Qt::CaseInsensitive)
+                flags |= QRegularExpression::CaseInsensitiveOption;
+
+            if (options.regularExpression)
+                regex = QRegularExpression(options.find, flags);
+        }
+
+        // Returns false when there is nothing to replace.
+        bool replace(const QString &text, QString &result) const
+        {
+            if (options.regularExpression)
+            {
+                if (!regex.match(text).hasMatch())
+                    return false;
+
+                result = text;
+                result.replace(regex, options.replacement);
+            }
+            else
+            {
+                if (!text.contains(options.find, options.caseSensitivity))
+                    return false;
+
+                result = text;
+                result.replace(options.find, options.replacement, options.caseSensitivity);
+            }
+
+            return result != text;
+        }
+
+        ReplaceChange operator()(const Variable &var) const
+        {
+            ReplaceChange change;
+            change.before = change.after = var;
+
+            if (var.value.type() != QVariant::StringList)
+            {
+                QString result;
+                if (replace(var.value.toString(), result))
+                    change.after.value = result;
+                return change;
+            }
+
+            // entry by entry, the list is only copied on the first hit
+            QStringList entries = var.value.toStringList();
+            bool changed = false;
+
+            for (int i = 0; i < entries.count(); ++i)
+            {
+                QString result;
+                if (replace(entries.at(i), result)) {
+                    entries[i] = result;
+                    changed = true;
+                }
+            }
+
+            if (changed)
+                change.after.value = entries;
+
+            return change;
+        }
+
+        ReplaceOptions options;
+        QRegularExpression regex;
+    };
+
+    static void collectChange(QList<ReplaceChange> &result, const ReplaceChange &change)
+    {
+        if (change.after.value != change.before.value)
+            result.append(change);
+    }
+
+    static bool changeLessThan(const ReplaceChange &a, const ReplaceChange &b)
+    {
+        if (a.before.type != b.before.type)
+            return a.before.type < b.before.type;
+        return a.before.name < b.before.name;
+    }
+
+    bool BulkReplace::isValid(const ReplaceOptions &options, QString *error)
+    {
+        if (options.find.isEmpty())
+        {
+            if (error)
+                *error = "Nothing to find.";
+            return false;
+        }
+
+        if (options.regularExpression)
+        {
+            QRegularExpression regex(options.find);
+            if (!regex.isValid())
+            {
+                if (error)
+                    *error = regex.errorString();
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    QList<ReplaceChange> BulkReplace::preview(const EnvironmentSnapshot &snapshot,
+                                              const ReplaceOptions &options)
+    {
+        if (!isValid(options))
+            return QList<ReplaceChange>();
+
+        QList<Variable> candidates;
+        QRegExp nameFilter(options.nameFilter, Qt::CaseInsensitive, QRegExp::Wildcard);
+        bool filterNames = !options.nameFilter.isEmpty();
+
+        if (options.system)
+            foreach (const Variable &var, snapshot.systemEnvironment())
+                if (!filterNames || nameFilter.exactMatch(var.name))
+                    candidates.append(var);
+
+        if (options.user)
+            foreach (const Variable &var, snapshot.userEnvironment())
+                if (!filterNames || nameFilter.exactMatch(var.name))
+                    candidates.append(var);
+
+        QList<ReplaceChange> changes =
+                QtConcurrent::blockingMappedReduced(candidates, ReplaceInVariable(options),
+                                                    collectChange, QtConcurrent::UnorderedReduce);
+
+        std::sort(changes.begin(), changes.end(), changeLessThan);
+        return changes;
+    }
+
+    BatchEditCommand::BatchEditCommand(VariablesManager *manager,
+                                       const QList<ReplaceChange> &changes,
+                                       const QString &text)
+        : manager(manager), changes(changes)
+    { setText(text); }
+
+    void BatchEditCommand::redo()
+    { apply(true); }
+
+    void BatchEditCommand::undo()
+    { apply(false); }
+
+    void BatchEditCommand::apply(bool forward)
+    {
+        EnvironmentSnapshot snapshot = manager->snapshot();
+        QList<Variable> batch;
+
+        foreach (const ReplaceChange &change, changes)
+        {
+            const Variable &from = forward ? change.before : change.after;
+            const Variable &to = forward ? change.after : change.before;
+
+            // Leave alone what was edited by hand in the meantime.
+            Variable current;
+            bool exists = snapshot.lookup(from.name, from.type, &current);
+            bool unchanged = from.value.isValid() ? (exists && current.value == from.value) : !exists;
+
+            if (unchanged)
+                batch.append(to);
+        }
+
+        manager->addVariables(batch);
+    }
+}
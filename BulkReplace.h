@@ -0,0 +1,79 @@
+#ifndef BULKREPLACE_H
+#define BULKREPLACE_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// BulkReplace runs a find-and-replace over all values of a snapshot
+// (entry by entry for lists) on the thread pool. The result is a list
+// of changes which can be previewed and applied as one batch.
+//
+
+#include <QUndoCommand>
+#include <QString>
+#include <QList>
+
+#include "EnvironmentSnapshot.h"
+
+namespace EnvironmentExplorer
+{
+    class VariablesManager;
+
+    struct ReplaceOptions
+    {
+        ReplaceOptions()
+            : regularExpression(false), caseSensitivity(Qt::CaseSensitive),
+              system(true), user(true) {}
+
+        QString find, replacement;
+        bool regularExpression;
+        Qt::CaseSensitivity caseSensitivity;
+
+        // scopes to search in
+        bool system, user;
+
+        // wildcard on variable names, empty matches all
+        QString nameFilter;
+    };
+
+    struct ReplaceChange
+    {
+        Variable before, after;
+    };
+
+    class BulkReplace
+    {
+    public:
+        // Empty when the options are invalid (see isValid()).
+        static QList<ReplaceChange> preview(const EnvironmentSnapshot &snapshot,
+                                            const ReplaceOptions &options);
+
+        static bool isValid(const ReplaceOptions &options, QString *error = 0);
+    };
+
+    // Applies (and reverts) a batch of changes as one step.
+    class BatchEditCommand : public QUndoCommand
+    {
+    public:
+        BatchEditCommand(VariablesManager* manager,
+                         const QList<ReplaceChange> &changes,
+                         const QString &text);
+
+        void redo();
+        void undo();
+
+    private:
+        void apply(bool forward);
+
+        VariablesManager* manager;
+        QList<ReplaceChange> changes;
+    };
+}
+
+#endif // BULKREPLACE_H
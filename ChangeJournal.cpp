@@ -0,0 +1,524 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "ChangeJournal.h"
+#include "ValueCodec.h"
+
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <QDataStream>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+
+#include <algorithm>
+
+#if defined(Q_OS_WIN)
+#include <qt_windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace EnvironmentExplorer
+{
+    static const quint32 journalMagic = 0x314a4545;     // "EEJ1"
+    static const quint32 checkpointMagic = 0x31434545;  // "EEC1"
+
+    // Record frame: payload size, checksum of the payload.
+    static const int frameSize = sizeof(quint32) + sizeof(quint16);
+
+    enum EntryFlags
+    {
+        HasBefore = 0x1,
+        HasAfter = 0x2,
+        BeforeExpandable = 0x4,
+        AfterExpandable = 0x8
+    };
+
+    static void setupStream(QDataStream &stream)
+    {
+        stream.setVersion(QDataStream::Qt_5_0);
+        stream.setByteOrder(QDataStream::LittleEndian);
+    }
+
+    // Empty values are not stored, so they are journaled as removals.
+    static bool exists(const Variable &var)
+    { return var.value.isValid() && !ValueCodec::isBlank(var.value); }
+
+    static void appendRecord(QByteArray &buffer, const JournalEntry &entry)
+    {
+        QByteArray payload;
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        setupStream(out);
+
+        quint8 flags = 0;
+        if (exists(entry.before))
+            flags |= HasBefore | (entry.before.expandable ? BeforeExpandable : 0);
+        if (exists(entry.after))
+            flags |= HasAfter | (entry.after.expandable ? AfterExpandable : 0);
+
+        out << entry.timestamp << quint8(entry.after.type) << flags << entry.after.name.toUtf8();
+        if (flags & HasBefore)
+            out << ValueCodec::encode(entry.before.value).toUtf8();
+        if (flags & HasAfter)
+            out << ValueCodec::encode(entry.after.value).toUtf8();
+
+        QDataStream frame(&buffer, QIODevice::WriteOnly|QIODevice::Append);
+        setupStream(frame);
+        frame << quint32(payload.size()) << qChecksum(payload.constData(), payload.size());
+
+        buffer.append(payload);
+    }
+
+    static bool parseRecord(const QByteArray &payload, JournalEntry &entry)
+    {
+        QDataStream in(payload);
+        setupStream(in);
+
+        quint8 type = 0, flags = 0;
+        QByteArray name, before, after;
+
+        in >> entry.timestamp >> type >> flags >> name;
+        if (flags & HasBefore)
+            in >> before;
+        if (flags & HasAfter)
+            in >> after;
+
+        if (in.status() != QDataStream::Ok)
+            return false;
+
+        entry.before = entry.after = Variable();
+        entry.before.name = entry.after.name = QString::fromUtf8(name);
+        entry.before.type = entry.after.type = (type == Variable::Global) ? Variable::Global : Variable::User;
+
+        if (flags & HasBefore) {
+            entry.before.value = ValueCodec::decode(QString::fromUtf8(before));
+            entry.before.expandable = (flags & BeforeExpandable) != 0;
+        }
+
+        if (flags & HasAfter) {
+            entry.after.value = ValueCodec::decode(QString::fromUtf8(after));
+            entry.after.expandable = (flags & AfterExpandable) != 0;
+        }
+
+        return true;
+    }
+
+    // Streams records off the journal. A torn or corrupt tail (a save
+    // interrupted before its sync) ends the journal.
+    class JournalReader
+    {
+    public:
+        JournalReader(QFile &file)
+            : file(file), validEnd(0) {}
+
+        bool start()
+        {
+            QDataStream in(&file);
+            setupStream(in);
+
+            quint32 magic = 0;
+            in >> magic;
+            if (in.status() != QDataStream::Ok || magic != journalMagic)
+                return false;
+
+            validEnd = file.pos();
+            return true;
+        }
+
+        bool next(JournalEntry &entry)
+        {
+            QByteArray frame = file.read(frameSize);
+            if (frame.size() != frameSize)
+                return false;
+
+            QDataStream in(frame);
+            setupStream(in);
+
+            quint32 size = 0;
+            quint16 checksum = 0;
+            in >> size >> checksum;
+
+            // The header is not covered by the checksum; a garbled size
+            // must not make us allocate up to 4 GB.
+            if (size > quint64(file.size() - file.pos()))
+                return false;
+
+            QByteArray payload = file.read(size);
+            if (payload.size() != int(size) ||
+                qChecksum(payload.constData(), payload.size()) != checksum)
+                return false;
+
+            if (!parseRecord(payload, entry))
+                return false;
+
+            validEnd = file.pos();
+            return true;
+        }
+
+        // Offset just past the last whole record read.
+        qint64 end() const
+        { return validEnd; }
+
+    private:
+        QFile &file;
+        qint64 validEnd;
+    };
+
+    static void readJournal(const QString &fileName, QList<JournalEntry> &result)
+    {
+        QFile file(fileName);
+        if (!file.open(QFile::ReadOnly))
+            return;
+
+        JournalReader reader(file);
+        if (!reader.start())
+            return;
+
+        JournalEntry entry;
+        while (reader.next(entry))
+            result.append(entry);
+    }
+
+    static bool syncFile(QFile &file)
+    {
+        if (!file.flush())
+            return false;
+
+#if defined(Q_OS_WIN)
+        return FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(file.handle()))) != 0;
+#else
+        return fsync(file.handle()) == 0;
+#endif
+    }
+
+    ChangeJournal::ChangeJournal(const QString &fileName)
+        : journalName(fileName), threshold(16 * 1024 * 1024), tailChecked(false)
+    {}
+
+    QString ChangeJournal::defaultFileName()
+    {
+        return QStandardPaths::writableLocation(QStandardPaths::DataLocation)
+                .append("/changes.journal");
+    }
+
+    QString ChangeJournal::checkpointName() const
+    { return journalName + ".checkpoint"; }
+
+    bool ChangeJournal::hasCheckpoint() const
+    { return QFile::exists(checkpointName()); }
+
+    bool ChangeJournal::needsCompaction() const
+    { return QFileInfo(journalName).size() > threshold; }
+
+    bool ChangeJournal::append(const QList<JournalEntry> &entries)
+    {
+        if (entries.isEmpty())
+            return true;
+
+        QDir().mkpath(QFileInfo(journalName).absolutePath());
+
+        QFile file(journalName);
+        if (!file.open(QFile::ReadWrite))
+        {
+            error = file.errorString();
+            return false;
+        }
+
+        // Readers stop at a torn or corrupt record, anything written
+        // after it would never be read. Cut it off once, before the
+        // first group this session.
+        if (!tailChecked)
+        {
+            JournalReader reader(file);
+            JournalEntry entry;
+
+            if (reader.start())
+                while (reader.next(entry)) {}
+
+            if (reader.end() < file.size() && !file.resize(reader.end()))
+            {
+                error = file.errorString();
+                return false;
+            }
+
+            tailChecked = true;
+        }
+
+        // The whole group goes out in one write and one sync.
+        QByteArray buffer;
+        if (file.size() == 0)
+        {
+            QDataStream out(&buffer, QIODevice::WriteOnly);
+            setupStream(out);
+            out << journalMagic;
+        }
+
+        foreach (const JournalEntry &entry, entries)
+            appendRecord(buffer, entry);
+
+        if (!file.seek(file.size()) || file.write(buffer) != buffer.size() || !syncFile(file))
+        {
+            error = file.errorString();
+            return false;
+        }
+
+        return true;
+    }
+
+    QList<qint64> ChangeJournal::segments() const
+    {
+        QFileInfo info(journalName);
+        QRegularExpression pattern(QString("^%1\\.(\\d+)(\\.checkpoint)?$")
+                                   .arg(QRegularExpression::escape(info.fileName())));
+
+        QList<qint64> starts;
+        foreach (const QString &name, info.absoluteDir().entryList(QDir::Files))
+        {
+            QRegularExpressionMatch match = pattern.match(name);
+            if (!match.hasMatch())
+                continue;
+
+            qint64 start = match.captured(1).toLongLong();
+            if (!starts.contains(start))
+                starts.append(start);
+        }
+
+        std::sort(starts.begin(), starts.end());
+        return starts;
+    }
+
+    bool ChangeJournal::archive()
+    {
+        bool journal = QFile::exists(journalName);
+        bool checkpoint = hasCheckpoint();
+
+        qint64 start = 0;
+        bool joined = false;
+
+        if (checkpoint)
+        {
+            if (!readCheckpointTime(checkpointName(), start))
+                return false;
+        }
+        else if (journal)
+        {
+            // Interrupted between the two renames below: the journal
+            // belongs to the last segment archived without one.
+            QList<qint64> starts = segments();
+            for (int i = starts.count() - 1; i >= 0 && !joined; --i)
+                if (!QFile::exists(segmentName(starts.at(i)))) {
+                    start = starts.at(i);
+                    joined = true;
+                }
+        }
+        else
+            return true; // nothing saved yet
+
+        if (!joined)
+            while (QFile::exists(segmentName(start)) || QFile::exists(segmentName(start) + ".checkpoint"))
+                ++start;
+
+        // The checkpoint first: without one, the next save starts a
+        // new history instead of appending to an archived journal.
+        if (checkpoint && !QFile::rename(checkpointName(), segmentName(start) + ".checkpoint"))
+        {
+            error = QString("Could not archive %1.").arg(checkpointName());
+            return false;
+        }
+
+        if (journal && !QFile::rename(journalName, segmentName(start)))
+        {
+            error = QString("Could not archive %1.").arg(journalName);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool ChangeJournal::compact(const EnvironmentBaseline &state, qint64 timestamp)
+    {
+        QDir().mkpath(QFileInfo(journalName).absolutePath());
+
+        // The history so far is kept as a segment of its own.
+        if (!archive())
+            return false;
+
+        QSaveFile file(checkpointName());
+        if (!file.open(QFile::WriteOnly))
+        {
+            error = file.errorString();
+            return false;
+        }
+
+        QDataStream out(&file);
+        setupStream(out);
+        out << checkpointMagic << timestamp
+            << quint32(state.globals.count() + state.locals.count());
+
+        QList<Variable> variables = state.globals.values() + state.locals.values();
+        foreach (const Variable &packed, variables)
+        {
+            Variable var = EnvironmentBaseline::unpack(packed);
+            out << quint8(var.type) << quint8(var.expandable)
+                << var.name.toUtf8() << ValueCodec::encode(var.value).toUtf8();
+        }
+
+        if (!file.commit())
+        {
+            error = file.errorString();
+            return false;
+        }
+
+        // the new journal has no tail to check
+        tailChecked = true;
+        return true;
+    }
+
+    bool ChangeJournal::readCheckpointTime(const QString &fileName, qint64 &timestamp)
+    {
+        QFile file(fileName);
+        if (!file.open(QFile::ReadOnly))
+        {
+            error = file.errorString();
+            return false;
+        }
+
+        QDataStream in(&file);
+        setupStream(in);
+
+        quint32 magic = 0;
+        in >> magic >> timestamp;
+
+        if (in.status() != QDataStream::Ok || magic != checkpointMagic)
+        {
+            error = QString("%1 is not a checkpoint.").arg(fileName);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool ChangeJournal::readCheckpoint(const QString &fileName, EnvironmentBaseline &state, qint64 &timestamp)
+    {
+        QFile file(fileName);
+        if (!file.open(QFile::ReadOnly))
+        {
+            error = file.errorString();
+            return false;
+        }
+
+        QDataStream in(&file);
+        setupStream(in);
+
+        quint32 magic = 0, count = 0;
+        in >> magic >> timestamp >> count;
+
+        if (magic != checkpointMagic)
+        {
+            error = QString("%1 is not a checkpoint.").arg(fileName);
+            return false;
+        }
+
+        state.globals.clear();
+        state.locals.clear();
+
+        for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+        {
+            quint8 type = 0, expandable = 0;
+            QByteArray name, value;
+            in >> type >> expandable >> name >> value;
+
+            Variable var;
+            var.name = QString::fromUtf8(name);
+            var.value = ValueCodec::decode(QString::fromUtf8(value));
+            var.type = (type == Variable::Global) ? Variable::Global : Variable::User;
+            var.expandable = expandable != 0;
+
+            ((var.type == Variable::Global) ? state.globals : state.locals).insert(var.name, state.pack(var));
+        }
+
+        if (in.status() != QDataStream::Ok)
+        {
+            error = QString("%1 is truncated.").arg(fileName);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool ChangeJournal::replay(qint64 timestamp, EnvironmentBaseline &state)
+    {
+        qint64 checkpointTime = 0;
+        if (hasCheckpoint() && readCheckpointTime(checkpointName(), checkpointTime) &&
+            timestamp >= checkpointTime)
+            return replaySegment(checkpointName(), journalName, timestamp, state);
+
+        // Older than the current checkpoint: the last archived
+        // segment which started before the timestamp.
+        QList<qint64> starts = segments();
+        for (int i = starts.count() - 1; i >= 0; --i)
+        {
+            QString checkpoint = segmentName(starts.at(i)) + ".checkpoint";
+            if (starts.at(i) <= timestamp && QFile::exists(checkpoint))
+                return replaySegment(checkpoint, segmentName(starts.at(i)), timestamp, state);
+        }
+
+        error = "There is no history from before the first save.";
+        return false;
+    }
+
+    bool ChangeJournal::replaySegment(const QString &checkpoint, const QString &journal,
+                                      qint64 timestamp, EnvironmentBaseline &state)
+    {
+        qint64 checkpointTime = 0;
+        if (!readCheckpoint(checkpoint, state, checkpointTime))
+            return false;
+
+        QFile file(journal);
+        if (!file.open(QFile::ReadOnly))
+            return true; // nothing saved since the checkpoint
+
+        JournalReader reader(file);
+        if (!reader.start())
+            return true;
+
+        JournalEntry entry;
+        while (reader.next(entry))
+        {
+            if (entry.timestamp <= checkpointTime)
+                continue;
+
+            // records are appended in time order
+            if (entry.timestamp > timestamp)
+                break;
+
+            VariableTable &table = (entry.after.type == Variable::Global) ? state.globals : state.locals;
+            if (entry.after.value.isValid())
+                table.insert(entry.after.name, state.pack(entry.after));
+            else
+                table.remove(entry.after.name);
+        }
+
+        return true;
+    }
+
+    QList<JournalEntry> ChangeJournal::entries()
+    {
+        QList<JournalEntry> result;
+
+        foreach (qint64 start, segments())
+            readJournal(segmentName(start), result);
+
+        readJournal(journalName, result);
+        return result;
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef CHANGEJOURNAL_H
+#define CHANGEJOURNAL_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// ChangeJournal keeps a history of saved changes: every save appends
+// one group of binary records (name, scope, value before and after)
+// to the journal, followed by a single sync, before the registry is
+// written. Once the journal grows past a threshold it is compacted:
+// the whole environment is written to a new checkpoint file and the
+// journal starts over. The previous checkpoint and journal are kept
+// as a segment (<journal>.<start>, <journal>.<start>.checkpoint), so
+// replaying a checkpoint plus its journal gives the environment at
+// any time since the first save. Segments are never deleted by the
+// program.
+//
+
+#include <QString>
+#include <QList>
+
+#include "EnvironmentSnapshot.h"
+
+namespace EnvironmentExplorer
+{
+    struct JournalEntry
+    {
+        qint64 timestamp;   // ms since epoch
+
+        // invalid values mean the variable did not exist
+        Variable before, after;
+    };
+
+    class ChangeJournal
+    {
+    public:
+        ChangeJournal(const QString &fileName = defaultFileName());
+
+        // Per-user file in the application data directory.
+        static QString defaultFileName();
+
+        QString fileName() const
+        { return journalName; }
+
+        QString checkpointName() const;
+
+        bool hasCheckpoint() const;
+
+        // Appends the changes of one save, written and synced at once.
+        // A torn tail left by an interrupted save is cut off first.
+        bool append(const QList<JournalEntry> &entries);
+
+        // Journal size (bytes) above which needsCompaction() is true.
+        void setCompactionThreshold(qint64 bytes)
+        { threshold = bytes; }
+
+        bool needsCompaction() const;
+
+        // Keeps the current checkpoint and journal as a segment, then
+        // writes the environment as of the timestamp as the new
+        // checkpoint and starts an empty journal.
+        bool compact(const EnvironmentBaseline &state, qint64 timestamp);
+
+        // Rebuilds the environment as it was at the timestamp, which
+        // must not be older than the first checkpoint.
+        bool replay(qint64 timestamp, EnvironmentBaseline &state);
+
+        // All records, archived segments included, oldest first.
+        QList<JournalEntry> entries();
+
+        // Start times of the archived segments, oldest first.
+        QList<qint64> segments() const;
+
+        QString errorString() const
+        { return error; }
+
+    private:
+        QString segmentName(qint64 start) const
+        { return journalName + "." + QString::number(start); }
+
+        bool archive();
+        bool readCheckpoint(const QString &fileName, EnvironmentBaseline &state, qint64 &timestamp);
+        bool readCheckpointTime(const QString &fileName, qint64 &timestamp);
+        bool replaySegment(const QString &checkpoint, const QString &journal,
+                           qint64 timestamp, EnvironmentBaseline &state);
+
+        QString journalName;
+        qint64 threshold;
+        bool tailChecked;
+        QString error;
+    };
+}
+
+#endif // CHANGEJOURNAL_H
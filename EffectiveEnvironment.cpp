@@ -0,0 +1,274 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "EffectiveEnvironment.h"
+#include "VariablesManager.h"
+#include "ValueCodec.h"
+#include "RunMetrics.h"
+
+#include <QStringList>
+
+namespace EnvironmentExplorer
+{
+    static inline QString joinValue(const QVariant &value)
+    { return ValueCodec::encode(value); }
+
+    EffectiveEnvironment::EffectiveEnvironment(VariablesManager *manager, QObject *parent)
+        : QObject(parent), manager(manager), expand(true)
+    {
+        connect(manager, &VariablesManager::variableChanged, this, &EffectiveEnvironment::update);
+        connect(manager, &VariablesManager::environmentReset, this, &EffectiveEnvironment::rebuild);
+        rebuild();
+    }
+
+    bool EffectiveEnvironment::isAppended(const QString &key)
+    { return key == "PATH"; }
+
+    void EffectiveEnvironment::setExpandReferences(bool enabled)
+    {
+        if (expand == enabled)
+            return;
+
+        expand = enabled;
+        expandKeys(QSet<QString>::fromList(merged.keys()));
+
+        emit rebuilt();
+    }
+
+    void EffectiveEnvironment::rebuild()
+    {
+        OperationTimer timer("merge_environment");
+
+        EnvironmentSnapshot snapshot = manager->snapshot();
+
+        merged.clear();
+        references.clear();
+        dependents.clear();
+        systemNames.clear();
+        userNames.clear();
+
+        foreach (const Variable &var, snapshot.systemEnvironment())
+            systemNames.insert(var.name.toUpper(), var.name);
+
+        foreach (const Variable &var, snapshot.userEnvironment())
+            userNames.insert(var.name.toUpper(), var.name);
+
+        QSet<QString> keys = QSet<QString>::fromList(systemNames.keys());
+        keys.unite(QSet<QString>::fromList(userNames.keys()));
+
+        foreach (const QString &key, keys)
+            mergeKey(snapshot, key);
+
+        expandKeys(keys);
+
+        emit rebuilt();
+    }
+
+    void EffectiveEnvironment::update(const QString &name, Variable::Type type)
+    {
+        OperationTimer timer("merge_variable");
+
+        EnvironmentSnapshot snapshot = manager->snapshot();
+        QString key = name.toUpper();
+
+        QHash<QString, QString> &names = (type == Variable::Global) ? systemNames : userNames;
+        if (snapshot.contains(name, type))
+            names.insert(key, name);
+        else if (names.value(key) == name)
+            names.remove(key);
+
+        mergeKey(snapshot, key);
+
+        // Re-expand the key and everything which refers to it,
+        // directly or through other variables.
+        QSet<QString> visited;
+        QList<QString> changed;
+        changed.append(key);
+        visited.insert(key);
+
+        for (int i = 0; i < changed.count(); ++i)
+            foreach (const QString &dependent, dependents.value(changed.at(i)))
+                if (!visited.contains(dependent)) {
+                    visited.insert(dependent);
+                    changed.append(dependent);
+                }
+
+        expandKeys(visited);
+
+        foreach (const QString &current, changed)
+            emit variableChanged(current);
+    }
+
+    bool EffectiveEnvironment::mergeKey(const EnvironmentSnapshot &snapshot, const QString &key)
+    {
+        Variable system, user;
+        bool hasSystem = systemNames.contains(key) &&
+                snapshot.lookup(systemNames.value(key), Variable::Global, &system);
+        bool hasUser = userNames.contains(key) &&
+                snapshot.lookup(userNames.value(key), Variable::User, &user);
+
+        if (!hasSystem && !hasUser)
+        {
+            merged.remove(key);
+            setReferences(key, QSet<QString>());
+            return false;
+        }
+
+        EffectiveVariable var;
+        var.name = hasUser ? user.name : system.name;
+        var.fromSystem = hasSystem;
+        var.fromUser = hasUser;
+
+        if (hasSystem && hasUser && isAppended(key))
+        {
+            QString systemValue = joinValue(system.value);
+            QString userValue = joinValue(user.value);
+
+            if (systemValue.isEmpty() || userValue.isEmpty())
+                var.value = systemValue + userValue;
+            else
+                var.value = systemValue + ";" + userValue;
+        }
+        else
+            var.value = joinValue(hasUser ? user.value : system.value);
+
+        var.expandedValue = var.value;
+        merged.insert(key, var);
+
+        setReferences(key, referencesOf(var.value));
+        return true;
+    }
+
+    void EffectiveEnvironment::expandKeys(QSet<QString> stale)
+    {
+        QSet<QString> visiting;
+        while (!stale.isEmpty())
+            expandKey(*stale.constBegin(), stale, visiting);
+    }
+
+    // The keys it refers to are expanded first, so that each key of
+    // stale is expanded once and reused by all keys referring to it;
+    // the others are up to date already.
+    void EffectiveEnvironment::expandKey(const QString &key, QSet<QString> &stale,
+                                         QSet<QString> &visiting)
+    {
+        if (!stale.remove(key))
+            return;
+
+        QHash<QString, EffectiveVariable>::iterator it = merged.find(key);
+        if (it == merged.end())
+            return;
+
+        if (!expand || !references.contains(key))
+        {
+            it.value().expandedValue = it.value().value;
+            return;
+        }
+
+        visiting.insert(key);
+
+        foreach (const QString &ref, references.value(key))
+            if (!visiting.contains(ref))
+                expandKey(ref, stale, visiting);
+
+        it.value().expandedValue = expandValue(it.value().value, visiting);
+        visiting.remove(key);
+    }
+
+    QString EffectiveEnvironment::expandValue(const QString &value, const QSet<QString> &visiting) const
+    {
+        // References expand to the expanded value of the variable, so
+        // nested ones are resolved too, unlike ExpandEnvironmentStrings.
+        // Unknown references and those closing a cycle are kept as they
+        // are; the closing '%' may open the next one.
+        QString result;
+        int pos = 0;
+
+        for (;;)
+        {
+            int start = value.indexOf('%', pos);
+            if (start < 0)
+                break;
+
+            int end = value.indexOf('%', start + 1);
+            if (end < 0)
+                break;
+
+            QString ref = value.mid(start + 1, end - start - 1).toUpper();
+            QHash<QString, EffectiveVariable>::const_iterator it = merged.constFind(ref);
+
+            if (ref.isEmpty() || it == merged.constEnd() || visiting.contains(ref))
+            {
+                result.append(value.midRef(pos, end - pos));
+                pos = end;
+                continue;
+            }
+
+            result.append(value.midRef(pos, start - pos));
+            result.append(it.value().expandedValue);
+
+            pos = end + 1;
+        }
+
+        result.append(value.midRef(pos));
+        return result;
+    }
+
+    void EffectiveEnvironment::setReferences(const QString &key, const QSet<QString> &refs)
+    {
+        QSet<QString> old = references.value(key);
+
+        foreach (const QString &ref, old)
+            if (!refs.contains(ref))
+            {
+                QHash<QString, QSet<QString> >::iterator it = dependents.find(ref);
+                if (it != dependents.end()) {
+                    it.value().remove(key);
+                    if (it.value().isEmpty())
+                        dependents.erase(it);
+                }
+            }
+
+        foreach (const QString &ref, refs)
+            if (!old.contains(ref))
+                dependents[ref].insert(key);
+
+        if (refs.isEmpty())
+            references.remove(key);
+        else
+            references.insert(key, refs);
+    }
+
+    QSet<QString> EffectiveEnvironment::referencesOf(const QString &value)
+    {
+        QSet<QString> refs;
+        int pos = 0;
+
+        for (;;)
+        {
+            int start = value.indexOf('%', pos);
+            if (start < 0)
+                break;
+
+            int end = value.indexOf('%', start + 1);
+            if (end < 0)
+                break;
+
+            if (end > start + 1)
+                refs.insert(value.mid(start + 1, end - start - 1).toUpper());
+
+            // Unknown names keep the closing '%', see expandValue().
+            pos = end;
+            if (end == start + 1)
+                pos = end + 1;
+        }
+
+        return refs;
+    }
+}
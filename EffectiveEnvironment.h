@@ -0,0 +1,106 @@
+#ifndef EFFECTIVEENVIRONMENT_H
+#define EFFECTIVEENVIRONMENT_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// EffectiveEnvironment merges system and user variables the way
+// a launched process sees them: user variables override system
+// ones, except PATH where the user value is appended.
+// It follows VariablesManager and updates only what changed.
+//
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QSet>
+
+#include "EnvironmentSnapshot.h"
+
+namespace EnvironmentExplorer
+{
+    class VariablesManager;
+
+    struct EffectiveVariable
+    {
+        QString name;
+
+        // Merged value, lists joined with ";".
+        QString value;
+
+        // Value with %NAME% references expanded
+        // (same as value when expansion is off).
+        QString expandedValue;
+
+        bool fromSystem, fromUser;
+    };
+
+    class EffectiveEnvironment : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        EffectiveEnvironment(VariablesManager* manager, QObject* parent = 0);
+
+        void setExpandReferences(bool enabled);
+        bool expandReferences() const
+        { return expand; }
+
+        // Keys are upper-cased names, as Windows compares them.
+        bool contains(const QString &name) const
+        { return merged.contains(name.toUpper()); }
+
+        EffectiveVariable variable(const QString &name) const
+        { return merged.value(name.toUpper()); }
+
+        QList<EffectiveVariable> variables() const
+        { return merged.values(); }
+
+        int count() const
+        { return merged.count(); }
+
+        // Whether the user value is appended to the system one.
+        static bool isAppended(const QString &key);
+
+    public slots:
+        // Full merge of both scopes.
+        void rebuild();
+
+    signals:
+        // The merged or expanded value of the key changed
+        // (or the variable disappeared).
+        void variableChanged(const QString &key);
+        void rebuilt();
+
+    private slots:
+        void update(const QString &name, Variable::Type type);
+
+    private:
+        bool mergeKey(const EnvironmentSnapshot &snapshot, const QString &key);
+        void expandKeys(QSet<QString> stale);
+        void expandKey(const QString &key, QSet<QString> &stale, QSet<QString> &visiting);
+        QString expandValue(const QString &value, const QSet<QString> &visiting) const;
+        void setReferences(const QString &key, const QSet<QString> &refs);
+
+        static QSet<QString> referencesOf(const QString &value);
+
+        VariablesManager* manager;
+        bool expand;
+
+        QHash<QString, EffectiveVariable> merged;
+
+        // Upper-cased name -> name as stored, per scope.
+        QHash<QString, QString> systemNames, userNames;
+
+        // key -> keys it references, and the reverse.
+        QHash<QString, QSet<QString> > references, dependents;
+    };
+}
+
+#endif // EFFECTIVEENVIRONMENT_H
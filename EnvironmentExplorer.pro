@@ -7,8 +7,12 @@
 #
 
 QT       += core gui
+CONFIG   += c++11
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
+
+# Counts allocations per operation (Diagnostics button, headless report).
+alloc_tracking: DEFINES += ENVEXPLORER_ALLOC_TRACKING
 message($$CONFIG)
 
 TARGET = EnvironmentExplorer
@@ -17,11 +21,55 @@ TEMPLATE = app
 SOURCES += main.cpp \
            MainDialog.cpp \
            VariablesManager.cpp \
-    MainDialogUi.cpp
+    MainDialogUi.cpp \
+           ValueListModel.cpp \
+           EnvironmentSnapshot.cpp \
+           EffectiveEnvironment.cpp \
+           ProcessScanner.cpp \
+           EnvironmentImporter.cpp \
+           ValueCodec.cpp \
+           ListValueDelegate.cpp \
+           BulkReplace.cpp \
+           VariableQuery.cpp \
+           FleetAggregator.cpp \
+           ChangeJournal.cpp \
+           PathTrie.cpp \
+           AllocationTracker.cpp \
+           StartupProfiler.cpp \
+           EnvironmentMerge.cpp \
+           RunMetrics.cpp \
+           EnvironmentProfiles.cpp \
+           ProcessLauncher.cpp \
+           VariableOrder.cpp \
+           ExportPipeline.cpp \
+           SizeProfiler.cpp \
+           Benchmarks.cpp
 
 HEADERS += MainDialog.h \
            VariablesManager.h \
-           MainDialogUi.h
+           MainDialogUi.h \
+           ValueListModel.h \
+           EnvironmentSnapshot.h \
+           EffectiveEnvironment.h \
+           ProcessScanner.h \
+           EnvironmentImporter.h \
+           ValueCodec.h \
+           ListValueDelegate.h \
+           BulkReplace.h \
+           VariableQuery.h \
+           FleetAggregator.h \
+           ChangeJournal.h \
+           PathTrie.h \
+           AllocationTracker.h \
+           StartupProfiler.h \
+           EnvironmentMerge.h \
+           RunMetrics.h \
+           EnvironmentProfiles.h \
+           ProcessLauncher.h \
+           VariableOrder.h \
+           ExportPipeline.h \
+           SizeProfiler.h \
+           Benchmarks.h
 
 LIBS += -ladvapi32
 
@@ -0,0 +1,476 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "EnvironmentImporter.h"
+#include "ValueCodec.h"
+
+#include <QScopedPointer>
+#include <QStringList>
+#include <QTextCodec>
+#include <QFileInfo>
+#include <QFile>
+
+#include <string.h>
+
+namespace EnvironmentExplorer
+{
+    // Size of a mapped window / read chunk.
+    static const qint64 chunkSize = 4 * 1024 * 1024;
+
+    // The only keys read from .reg files.
+    static const char userEnvironmentKey[] = "HKEY_CURRENT_USER\\ENVIRONMENT";
+    static const char machineEnvironmentKey[] =
+            "HKEY_LOCAL_MACHINE\\SYSTEM\\CURRENTCONTROLSET\\CONTROL\\SESSION MANAGER\\ENVIRONMENT";
+
+    static inline bool isSpace(char c)
+    { return c == ' ' || c == '\t'; }
+
+    static inline const char* skipSpace(const char* p, const char* end)
+    {
+        while (p < end && isSpace(*p))
+            ++p;
+        return p;
+    }
+
+    static inline const char* trimEnd(const char* begin, const char* end)
+    {
+        while (end > begin && isSpace(end[-1]))
+            --end;
+        return end;
+    }
+
+    static bool isValidName(const char* begin, const char* end)
+    {
+        if (begin == end)
+            return false;
+
+        for (const char* p = begin; p < end; ++p)
+        {
+            char c = *p;
+            bool valid = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_' ||
+                         (p != begin && c >= '0' && c <= '9');
+            if (!valid)
+                return false;
+        }
+
+        return true;
+    }
+
+    // Reads a "quoted" .reg string (\\ and \" escapes), starting after
+    // the opening quote. Returns the position after the closing quote.
+    static const char* parseRegString(const char* p, const char* end, QByteArray &out)
+    {
+        out.reserve(int(end - p));
+        for (; p < end; ++p)
+        {
+            if (*p == '"')
+                return p + 1;
+
+            if (*p == '\\' && p + 1 < end)
+                ++p;
+
+            out.append(*p);
+        }
+
+        return 0; // unterminated
+    }
+
+    static inline int hexDigit(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    // "25,00,50,00,..." -> bytes
+    static QByteArray parseHex(const char* p, const char* end)
+    {
+        QByteArray bytes;
+        bytes.reserve(int(end - p) / 3 + 1);
+
+        while (p + 1 < end)
+        {
+            int high = hexDigit(p[0]);
+            int low = hexDigit(p[1]);
+
+            if (high < 0 || low < 0) { ++p; continue; } // ',', spaces
+            bytes.append(char((high << 4) | low));
+            p += 2;
+        }
+
+        return bytes;
+    }
+
+    EnvironmentImporter::EnvironmentImporter(QObject *parent)
+        : QObject(parent), format(Auto), activeFormat(DotEnv),
+          scope(Variable::User), batchSize(4096),
+          inEnvironmentKey(false), keyScope(Variable::User), records(0)
+    {
+        qRegisterMetaType<QList<Variable> >();
+    }
+
+    EnvironmentImporter::Format EnvironmentImporter::detectFormat(const QString &fileName)
+    {
+        QString suffix = QFileInfo(fileName).suffix().toLower();
+
+        if (suffix == "reg")
+            return Registry;
+        if (suffix == "sh" || suffix == "bash")
+            return ShellExport;
+
+        return DotEnv;
+    }
+
+    bool EnvironmentImporter::importFile(const QString &fileName)
+    {
+        error.clear();
+        records = 0;
+        batch.clear();
+        pending.clear();
+        continued.clear();
+        inEnvironmentKey = false;
+        activeFormat = (format == Auto) ? detectFormat(fileName) : format;
+
+        QFile file(fileName);
+        if (!file.open(QFile::ReadOnly))
+        {
+            error = file.errorString();
+            return false;
+        }
+
+        // regedit writes UTF-16, which has to be decoded before scanning.
+        QByteArray bom = file.peek(2);
+        bool utf16 = bom.size() == 2 && uchar(bom[0]) == 0xFF && uchar(bom[1]) == 0xFE;
+
+        if (utf16)
+            return importUtf16(file);
+
+        return importMapped(file);
+    }
+
+    bool EnvironmentImporter::importMapped(QFile &file)
+    {
+        qint64 size = file.size();
+        qint64 pos = (file.peek(3) == "\xEF\xBB\xBF") ? 3 : 0;
+
+        // Only one window is mapped at a time, so the address space
+        // taken does not grow with the file.
+        while (pos < size)
+        {
+            qint64 length = qMin(chunkSize - pos % chunkSize, size - pos);
+
+            uchar* data = file.map(pos, length);
+            if (data)
+            {
+                feed(reinterpret_cast<const char*>(data), length);
+                file.unmap(data);
+            }
+            else if (!readWindow(file, pos, length))
+                return false;
+
+            pos += length;
+            emit progress(pos, size);
+        }
+
+        finish();
+        return true;
+    }
+
+    // A window which could not be mapped is read instead.
+    bool EnvironmentImporter::readWindow(QFile &file, qint64 pos, qint64 size)
+    {
+        QByteArray chunk;
+        if (file.seek(pos))
+            chunk = file.read(size);
+
+        if (chunk.size() != size)
+        {
+            error = file.errorString();
+            return false;
+        }
+
+        feed(chunk.constData(), chunk.size());
+        return true;
+    }
+
+    // Decoded a chunk at a time; the decoder keeps a code unit split
+    // between two chunks.
+    bool EnvironmentImporter::importUtf16(QFile &file)
+    {
+        QScopedPointer<QTextDecoder> decoder(QTextCodec::codecForName("UTF-16LE")->makeDecoder());
+        file.read(2); // BOM
+
+        for (;;)
+        {
+            QByteArray chunk = file.read(chunkSize);
+            if (chunk.isEmpty())
+                break;
+
+            chunk = decoder->toUnicode(chunk).toUtf8();
+
+            feed(chunk.constData(), chunk.size());
+            emit progress(file.pos(), file.size());
+        }
+
+        if (file.error() != QFile::NoError)
+        {
+            error = file.errorString();
+            return false;
+        }
+
+        finish();
+        return true;
+    }
+
+    void EnvironmentImporter::feed(const char *data, qint64 size)
+    {
+        const char* pos = data;
+        const char* end = data + size;
+
+        // Finish the line started in the previous chunk.
+        if (!pending.isEmpty())
+        {
+            const char* newline = static_cast<const char*>(memchr(pos, '\n', end - pos));
+            if (!newline)
+            {
+                pending.append(pos, int(size));
+                return;
+            }
+
+            pending.append(pos, int(newline - pos));
+            parseLine(pending.constData(), pending.constData() + pending.size());
+            pending.clear();
+            pos = newline + 1;
+        }
+
+        while (pos < end)
+        {
+            const char* newline = static_cast<const char*>(memchr(pos, '\n', end - pos));
+            if (!newline)
+            {
+                pending.append(pos, int(end - pos));
+                break;
+            }
+
+            parseLine(pos, newline);
+            pos = newline + 1;
+        }
+    }
+
+    void EnvironmentImporter::finish()
+    {
+        if (!pending.isEmpty())
+        {
+            QByteArray line = pending;
+            pending.clear();
+            parseLine(line.constData(), line.constData() + line.size());
+        }
+
+        if (!continued.isEmpty())
+        {
+            QByteArray line = continued;
+            continued.clear();
+            parseRegistryLine(line.constData(), line.constData() + line.size());
+        }
+
+        flush();
+    }
+
+    void EnvironmentImporter::parseLine(const char *begin, const char *end)
+    {
+        if (end > begin && end[-1] == '\r')
+            --end;
+
+        if (activeFormat != Registry)
+        {
+            parseAssignment(begin, end, activeFormat == ShellExport);
+            return;
+        }
+
+        // hex values are wrapped over several lines ending with '\'
+        if (end > begin && end[-1] == '\\')
+        {
+            const char* from = continued.isEmpty() ? begin : skipSpace(begin, end);
+            continued.append(from, int(end - from - 1));
+            return;
+        }
+
+        if (!continued.isEmpty())
+        {
+            const char* from = skipSpace(begin, end);
+            continued.append(from, int(end - from));
+
+            QByteArray line = continued;
+            continued.clear();
+            parseRegistryLine(line.constData(), line.constData() + line.size());
+            return;
+        }
+
+        parseRegistryLine(begin, end);
+    }
+
+    void EnvironmentImporter::parseAssignment(const char *begin, const char *end, bool exportOnly)
+    {
+        const char* p = skipSpace(begin, end);
+        if (p == end || *p == '#')
+            return;
+
+        bool exported = end - p > 7 && memcmp(p, "export", 6) == 0 && isSpace(p[6]);
+        if (exported)
+            p = skipSpace(p + 7, end);
+        else if (exportOnly)
+            return;
+
+        const char* eq = static_cast<const char*>(memchr(p, '=', end - p));
+        if (!eq)
+            return;
+
+        const char* nameEnd = trimEnd(p, eq);
+        if (!isValidName(p, nameEnd))
+            return;
+
+        const char* v = skipSpace(eq + 1, end);
+        const char* vEnd = trimEnd(v, end);
+
+        QByteArray value;
+        if (v < vEnd && *v == '\'')
+        {
+            // literal up to the closing quote
+            ++v;
+            const char* close = static_cast<const char*>(memchr(v, '\'', vEnd - v));
+            value = QByteArray(v, int((close ? close : vEnd) - v));
+        }
+        else if (v < vEnd && *v == '"')
+        {
+            value.reserve(int(vEnd - v));
+            for (++v; v < vEnd && *v != '"'; ++v)
+            {
+                if (*v == '\\' && v + 1 < vEnd)
+                {
+                    ++v;
+                    switch (*v) {
+                    case 'n': value.append('\n'); break;
+                    case 't': value.append('\t'); break;
+                    default:  value.append(*v);   break;
+                    }
+                }
+                else
+                    value.append(*v);
+            }
+        }
+        else
+        {
+            // unquoted, " #" starts a comment
+            for (const char* c = v; c < vEnd; ++c)
+                if (*c == '#' && c > v && isSpace(c[-1])) {
+                    vEnd = trimEnd(v, c);
+                    break;
+                }
+
+            value = QByteArray(v, int(vEnd - v));
+        }
+
+        addRecord(QString::fromLatin1(p, int(nameEnd - p)),
+                  ValueCodec::decode(QString::fromUtf8(value)), scope);
+    }
+
+    void EnvironmentImporter::parseRegistryLine(const char *begin, const char *end)
+    {
+        const char* p = skipSpace(begin, end);
+        if (p == end)
+            return;
+
+        if (*p == '[')
+        {
+            inEnvironmentKey = false;
+            if (p + 1 < end && p[1] == '-') // deleted key
+                return;
+
+            const char* close = static_cast<const char*>(memchr(p, ']', end - p));
+            QByteArray key = QByteArray(p + 1, int((close ? close : end) - p - 1)).toUpper();
+
+            if (key == machineEnvironmentKey)
+                keyScope = Variable::Global;
+            else if (key == userEnvironmentKey)
+                keyScope = Variable::User;
+            else
+                return;
+
+            inEnvironmentKey = true;
+            return;
+        }
+
+        if (!inEnvironmentKey || *p != '"')
+            return;
+
+        QByteArray name;
+        p = parseRegString(p + 1, end, name);
+        if (!p || name.isEmpty())
+            return;
+
+        p = skipSpace(p, end);
+        if (p == end || *p != '=')
+            return;
+
+        p = skipSpace(p + 1, end);
+        if (p == end)
+            return;
+
+        if (*p == '-') // "NAME"=- deletes the value
+        {
+            addRecord(QString::fromUtf8(name), QVariant(), keyScope);
+        }
+        else if (*p == '"') // REG_SZ
+        {
+            QByteArray value;
+            if (parseRegString(p + 1, end, value))
+                addRecord(QString::fromUtf8(name), ValueCodec::decode(QString::fromUtf8(value)), keyScope);
+        }
+        else if (end - p > 7 && memcmp(p, "hex(2):", 7) == 0) // REG_EXPAND_SZ, UTF-16LE
+        {
+            QByteArray bytes = parseHex(p + 7, end);
+            QString value = QString::fromUtf16(reinterpret_cast<const ushort*>(bytes.constData()),
+                                               bytes.size() / 2);
+
+            while (value.endsWith(QChar('\0')))
+                value.chop(1);
+
+            addRecord(QString::fromUtf8(name), ValueCodec::decode(value), keyScope, true);
+        }
+    }
+
+    void EnvironmentImporter::addRecord(const QString &name, const QVariant &value,
+                                        Variable::Type type, bool expandable)
+    {
+        Variable var;
+        var.name = name;
+        var.value = value;
+        var.type = type;
+        var.expandable = expandable;
+
+        if (batch.isEmpty())
+            batch.reserve(batchSize);
+
+        batch.append(var);
+        ++records;
+
+        if (batch.count() >= batchSize)
+            flush();
+    }
+
+    void EnvironmentImporter::flush()
+    {
+        if (batch.isEmpty())
+            return;
+
+        emit batchReady(batch);
+        batch.clear();
+    }
+}
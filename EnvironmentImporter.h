@@ -0,0 +1,103 @@
+#ifndef ENVIRONMENTIMPORTER_H
+#define ENVIRONMENTIMPORTER_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// EnvironmentImporter streams variables from .env files, shell
+// scripts (export NAME=value) and registry exports (.reg).
+// The input is scanned line by line straight from the file, mapped
+// a window at a time; records are handed out in batches of a fixed
+// size. importFile() may run on a worker thread, batchReady() is
+// then connected with Qt::BlockingQueuedConnection so that at most
+// one batch is in flight.
+//
+
+#include <QByteArray>
+#include <QObject>
+#include <QList>
+
+#include "EnvironmentSnapshot.h"
+
+class QFile;
+
+namespace EnvironmentExplorer
+{
+    class EnvironmentImporter : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        enum Format { Auto, DotEnv, ShellExport, Registry };
+
+        EnvironmentImporter(QObject* parent = 0);
+
+        // Picks the format from the file extension.
+        static Format detectFormat(const QString &fileName);
+
+        void setFormat(Format f)
+        { format = f; }
+
+        // Scope of variables from .env and shell files
+        // (.reg files name their scope in the key).
+        void setScope(Variable::Type t)
+        { scope = t; }
+
+        void setBatchSize(int size)
+        { batchSize = qMax(1, size); }
+
+        bool importFile(const QString &fileName);
+
+        // Incremental interface, importFile() uses these.
+        void feed(const char* data, qint64 size);
+        void finish();
+
+        qint64 recordCount() const
+        { return records; }
+
+        QString errorString() const
+        { return error; }
+
+    signals:
+        // Invalid values in a batch mean removal (.reg "NAME"=-).
+        void batchReady(const QList<Variable> &batch);
+        void progress(qint64 done, qint64 total);
+
+    private:
+        bool importMapped(QFile &file);
+        bool readWindow(QFile &file, qint64 pos, qint64 size);
+        bool importUtf16(QFile &file);
+
+        void parseLine(const char* begin, const char* end);
+        void parseAssignment(const char* begin, const char* end, bool exportOnly);
+        void parseRegistryLine(const char* begin, const char* end);
+
+        void addRecord(const QString &name, const QVariant &value,
+                       Variable::Type type, bool expandable = false);
+        void flush();
+
+        Format format, activeFormat;
+        Variable::Type scope;
+        int batchSize;
+
+        // Incomplete line carried over between chunks.
+        QByteArray pending;
+
+        // .reg state: lines ending with '\' and the current key.
+        QByteArray continued;
+        bool inEnvironmentKey;
+        Variable::Type keyScope;
+
+        QList<Variable> batch;
+        qint64 records;
+        QString error;
+    };
+}
+
+#endif // ENVIRONMENTIMPORTER_H
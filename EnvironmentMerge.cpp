@@ -0,0 +1,100 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "EnvironmentMerge.h"
+#include "ValueCodec.h"
+
+#include <QSet>
+
+namespace EnvironmentExplorer
+{
+    static bool isPresent(const Variable &var)
+    { return var.value.isValid() && !ValueCodec::isBlank(var.value); }
+
+    static bool isSame(const Variable &a, const Variable &b)
+    {
+        if (!isPresent(a) || !isPresent(b))
+            return isPresent(a) == isPresent(b);
+
+        return a.expandable == b.expandable &&
+               ValueCodec::encode(a.value) == ValueCodec::encode(b.value);
+    }
+
+    bool EnvironmentMerge::merge(const Variable &base, const Variable &ours,
+                                 const Variable &theirs, Variable *result)
+    {
+        if (isSame(ours, theirs) || isSame(base, theirs)) {
+            *result = ours;
+            return true;
+        }
+
+        if (isSame(base, ours)) {
+            *result = theirs;
+            return true;
+        }
+
+        // removed on one side, changed on the other; or added twice
+        if (!isPresent(base) || !isPresent(ours) || !isPresent(theirs))
+            return false;
+
+        if (!ValueCodec::isList(base.value) && !ValueCodec::isList(ours.value) &&
+            !ValueCodec::isList(theirs.value))
+            return false;
+
+        QStringList baseEntries = ValueCodec::entries(base.value);
+        QStringList ourEntries = ValueCodec::entries(ours.value);
+
+        // only reordered by us, which does not survive their change
+        if (baseEntries.toSet() == ourEntries.toSet())
+            return false;
+
+        QStringList merged = mergeEntries(baseEntries, ourEntries, ValueCodec::entries(theirs.value));
+
+        *result = ours;
+        result->value = (merged.count() == 1) ? QVariant(merged.first()) : QVariant(merged);
+        result->expandable = ours.expandable || theirs.expandable;
+        return true;
+    }
+
+    QStringList EnvironmentMerge::mergeEntries(const QStringList &base, const QStringList &ours,
+                                               const QStringList &theirs)
+    {
+        QSet<QString> baseSet = base.toSet();
+        QSet<QString> ourSet = ours.toSet();
+
+        // theirs, less what we took out
+        QStringList result;
+        QSet<QString> resultSet;
+        foreach (const QString &entry, theirs)
+            if (!baseSet.contains(entry) || ourSet.contains(entry)) {
+                result.append(entry);
+                resultSet.insert(entry);
+            }
+
+        // plus what we put in, after the entry it follows in our list
+        for (int i = 0; i < ours.count(); ++i)
+        {
+            const QString &entry = ours.at(i);
+            if (baseSet.contains(entry) || resultSet.contains(entry))
+                continue;
+
+            int at = (i == 0) ? 0 : result.indexOf(ours.at(i - 1)) + 1;
+            if (i > 0 && at == 0)
+                at = result.count();
+
+            result.insert(at, entry);
+            resultSet.insert(entry);
+        }
+
+        return result;
+    }
+
+    uint EnvironmentMerge::storedHash(const QString &raw, bool expandable)
+    { return qHash(raw) ^ (expandable ? 0x9e3779b9u : 0u); }
+}
@@ -0,0 +1,53 @@
+#ifndef ENVIRONMENTMERGE_H
+#define ENVIRONMENTMERGE_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// EnvironmentMerge merges our edit of a variable with a change made
+// to the store by someone else since the load (three-way, against
+// the loaded value). Lists are merged entry by entry: their entries
+// are kept in their order, ours are taken out or put in next to the
+// entry they follow in our list.
+//
+
+#include <QStringList>
+#include <QList>
+
+#include "EnvironmentSnapshot.h"
+
+namespace EnvironmentExplorer
+{
+    // A variable changed on both sides in ways that do not merge.
+    struct MergeConflict
+    {
+        Variable base, ours, theirs;
+
+        // What to save, ours unless chosen otherwise.
+        Variable resolved;
+    };
+
+    class EnvironmentMerge
+    {
+    public:
+        // Invalid values stand for a missing variable. Returns false
+        // on a conflict, result is left alone then.
+        static bool merge(const Variable &base, const Variable &ours,
+                          const Variable &theirs, Variable *result);
+
+        static QStringList mergeEntries(const QStringList &base,
+                                        const QStringList &ours,
+                                        const QStringList &theirs);
+
+        // Hash of a value as stored, to tell changes without comparing.
+        static uint storedHash(const QString &raw, bool expandable);
+    };
+}
+
+#endif // ENVIRONMENTMERGE_H
@@ -0,0 +1,258 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "EnvironmentProfiles.h"
+#include "ValueCodec.h"
+
+#include <QStandardPaths>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QFile>
+#include <QDir>
+
+#include <algorithm>
+
+namespace EnvironmentExplorer
+{
+    static const quint32 profileMagic = 0x31504545; // "EEP1"
+
+    enum ProfileFlags
+    {
+        IsSet = 0x1,
+        IsExpandable = 0x2
+    };
+
+    static bool isSame(const Variable &a, const Variable &b)
+    {
+        if (!a.value.isValid() || !b.value.isValid())
+            return a.value.isValid() == b.value.isValid();
+
+        // as stored: a one-entry list comes back from a profile as a string
+        return a.expandable == b.expandable &&
+               ValueCodec::encode(a.value) == ValueCodec::encode(b.value);
+    }
+
+    EnvironmentProfile EnvironmentProfiles::capture(const QString &name,
+                                                    const EnvironmentSnapshot &snapshot)
+    {
+        EnvironmentProfile profile;
+        profile.name = name;
+        profile.globals = snapshot.edits(Variable::Global);
+        profile.locals = snapshot.edits(Variable::User);
+        return profile;
+    }
+
+    QList<ReplaceChange> EnvironmentProfiles::plan(const EnvironmentProfile &profile,
+                                                   const EnvironmentSnapshot &snapshot)
+    {
+        QList<ReplaceChange> changes;
+
+        for (int scope = Variable::Global; scope <= Variable::User; ++scope)
+        {
+            const VariableTable &delta = profile.table(Variable::Type(scope));
+
+            VariableTable::const_iterator it = delta.constBegin();
+            for (; it != delta.constEnd(); ++it)
+            {
+                ReplaceChange change;
+                change.after = it.value();
+
+                if (!snapshot.lookup(it.key(), change.after.type, &change.before))
+                {
+                    change.before = change.after;
+                    change.before.value = QVariant();
+                }
+
+                if (!isSame(change.before, change.after))
+                    changes.append(change);
+            }
+        }
+
+        return changes;
+    }
+
+    QList<ProfileDifference> EnvironmentProfiles::compare(const EnvironmentProfile &first,
+                                                          const EnvironmentProfile &second)
+    {
+        QList<ProfileDifference> result;
+
+        for (int scope = Variable::Global; scope <= Variable::User; ++scope)
+        {
+            Variable::Type type = Variable::Type(scope);
+            const VariableTable &a = first.table(type);
+            const VariableTable &b = second.table(type);
+
+            // keys of both deltas, nothing else can differ
+            QStringList keys = a.keys();
+            foreach (const QString &key, b.keys())
+                if (!a.contains(key))
+                    keys.append(key);
+
+            std::sort(keys.begin(), keys.end());
+
+            foreach (const QString &key, keys)
+            {
+                ProfileDifference diff;
+                diff.name = key;
+                diff.type = type;
+                diff.inFirst = a.contains(key);
+                diff.inSecond = b.contains(key);
+                diff.first = a.value(key);
+                diff.second = b.value(key);
+
+                if (diff.inFirst != diff.inSecond || !isSame(diff.first, diff.second))
+                    result.append(diff);
+            }
+        }
+
+        return result;
+    }
+
+    ProfileStore::ProfileStore(const QString &directory)
+        : directory(directory)
+    {}
+
+    QString ProfileStore::defaultDirectory()
+    {
+        return QStandardPaths::writableLocation(QStandardPaths::DataLocation)
+                .append("/profiles");
+    }
+
+    bool ProfileStore::isValidName(const QString &name)
+    { return QRegExp("[\\w .-]+").exactMatch(name) && !name.startsWith('.'); }
+
+    QString ProfileStore::filePath(const QString &name) const
+    { return QDir(directory).filePath(name + ".profile"); }
+
+    QStringList ProfileStore::names() const
+    {
+        QStringList result;
+        foreach (const QFileInfo &info, QDir(directory).entryInfoList(QStringList() << "*.profile",
+                                                                      QDir::Files, QDir::Name))
+            result.append(info.completeBaseName());
+        return result;
+    }
+
+    bool ProfileStore::save(const EnvironmentProfile &profile)
+    {
+        if (!isValidName(profile.name))
+        {
+            error = QString("'%1' is not a valid profile name.").arg(profile.name);
+            return false;
+        }
+
+        QDir().mkpath(directory);
+
+        QSaveFile file(filePath(profile.name));
+        if (!file.open(QFile::WriteOnly))
+        {
+            error = file.errorString();
+            return false;
+        }
+
+        QDataStream out(&file);
+        out.setVersion(QDataStream::Qt_5_0);
+        out << profileMagic << quint32(profile.count());
+
+        QList<Variable> variables = profile.globals.values() + profile.locals.values();
+        foreach (const Variable &var, variables)
+        {
+            quint8 flags = (var.value.isValid() ? IsSet : 0) | (var.expandable ? IsExpandable : 0);
+            out << quint8(var.type) << flags << var.name.toUtf8();
+            if (flags & IsSet)
+                out << ValueCodec::encode(var.value).toUtf8();
+        }
+
+        if (!file.commit())
+        {
+            error = file.errorString();
+            return false;
+        }
+
+        return true;
+    }
+
+    bool ProfileStore::load(const QString &name, EnvironmentProfile *profile)
+    {
+        if (!isValidName(name))
+        {
+            error = QString("'%1' is not a valid profile name.").arg(name);
+            return false;
+        }
+
+        QFile file(filePath(name));
+        if (!file.open(QFile::ReadOnly))
+        {
+            error = file.errorString();
+            return false;
+        }
+
+        QDataStream in(&file);
+        in.setVersion(QDataStream::Qt_5_0);
+
+        quint32 magic = 0, count = 0;
+        in >> magic >> count;
+
+        if (magic != profileMagic)
+        {
+            error = QString("%1 is not a profile.").arg(file.fileName());
+            return false;
+        }
+
+        profile->name = name;
+        profile->globals.clear();
+        profile->locals.clear();
+
+        for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+        {
+            quint8 type = 0, flags = 0;
+            QByteArray varName, value;
+
+            in >> type >> flags >> varName;
+            if (flags & IsSet)
+                in >> value;
+
+            Variable var;
+            var.name = QString::fromUtf8(varName);
+            var.type = (type == Variable::Global) ? Variable::Global : Variable::User;
+            var.expandable = (flags & IsExpandable) != 0;
+            if (flags & IsSet)
+                var.value = ValueCodec::decode(QString::fromUtf8(value));
+
+            ((var.type == Variable::Global) ? profile->globals : profile->locals).insert(var.name, var);
+        }
+
+        if (in.status() != QDataStream::Ok)
+        {
+            error = QString("%1 is truncated.").arg(file.fileName());
+            return false;
+        }
+
+        return true;
+    }
+
+    bool ProfileStore::remove(const QString &name)
+    {
+        if (!isValidName(name))
+        {
+            error = QString("'%1' is not a valid profile name.").arg(name);
+            return false;
+        }
+
+        if (!QFile::remove(filePath(name)))
+        {
+            error = QString("Could not remove the profile '%1'.").arg(name);
+            return false;
+        }
+
+        return true;
+    }
+}
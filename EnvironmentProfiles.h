@@ -0,0 +1,99 @@
+#ifndef ENVIRONMENTPROFILES_H
+#define ENVIRONMENTPROFILES_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// Named profiles (toolchain setups and the like) stored as sparse
+// deltas against the saved environment: only the variables a profile
+// sets or removes are kept. Applying one computes the puts and
+// deletes which actually change something; comparing two only looks
+// at the keys of their deltas.
+//
+
+#include <QStringList>
+#include <QString>
+#include <QList>
+
+#include "EnvironmentSnapshot.h"
+#include "BulkReplace.h"
+
+namespace EnvironmentExplorer
+{
+    struct EnvironmentProfile
+    {
+        QString name;
+
+        // an invalid value removes the variable
+        VariableTable globals, locals;
+
+        const VariableTable &table(Variable::Type type) const
+        { return (type == Variable::Global) ? globals : locals; }
+
+        int count() const
+        { return globals.count() + locals.count(); }
+    };
+
+    // A key two profiles treat differently.
+    struct ProfileDifference
+    {
+        QString name;
+        Variable::Type type;
+
+        // false when the profile leaves the variable alone
+        bool inFirst, inSecond;
+        Variable first, second;
+    };
+
+    class EnvironmentProfiles
+    {
+    public:
+        // The unsaved edits of the snapshot, i.e. its delta.
+        static EnvironmentProfile capture(const QString &name,
+                                          const EnvironmentSnapshot &snapshot);
+
+        // Puts and deletes needed to get from the snapshot to the
+        // profile; what is already so is left out. Applied as one
+        // batch (see BatchEditCommand).
+        static QList<ReplaceChange> plan(const EnvironmentProfile &profile,
+                                    const EnvironmentSnapshot &snapshot);
+
+        static QList<ProfileDifference> compare(const EnvironmentProfile &first,
+                                                const EnvironmentProfile &second);
+    };
+
+    // One file per profile in a directory.
+    class ProfileStore
+    {
+    public:
+        ProfileStore(const QString &directory = defaultDirectory());
+
+        static QString defaultDirectory();
+
+        // Letters, digits, spaces, '.', '_' and '-'.
+        static bool isValidName(const QString &name);
+
+        QStringList names() const;
+
+        bool save(const EnvironmentProfile &profile);
+        bool load(const QString &name, EnvironmentProfile *profile);
+        bool remove(const QString &name);
+
+        QString errorString() const
+        { return error; }
+
+    private:
+        QString filePath(const QString &name) const;
+
+        QString directory;
+        QString error;
+    };
+}
+
+#endif // ENVIRONMENTPROFILES_H
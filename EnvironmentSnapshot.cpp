@@ -0,0 +1,140 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "EnvironmentSnapshot.h"
+
+namespace EnvironmentExplorer
+{
+    Variable EnvironmentBaseline::pack(const Variable &var)
+    {
+        if (var.value.type() != QVariant::StringList)
+            return var;
+
+        Variable packed = var;
+        packed.value = QVariant::fromValue(PathList(var.value.toStringList(), paths));
+        return packed;
+    }
+
+    void EnvironmentBaseline::pack()
+    {
+        for (VariableTable::iterator it = globals.begin(); it != globals.end(); ++it)
+            it.value() = pack(it.value());
+
+        for (VariableTable::iterator it = locals.begin(); it != locals.end(); ++it)
+            it.value() = pack(it.value());
+
+        packedNodes = paths->nodeCount();
+    }
+
+    void EnvironmentBaseline::compact()
+    {
+        if (paths->nodeCount() <= 2 * packedNodes + 1024)
+            return;
+
+        paths = QSharedPointer<PathTrie>(new PathTrie());
+
+        for (VariableTable::iterator it = globals.begin(); it != globals.end(); ++it)
+            it.value() = pack(unpack(it.value()));
+
+        for (VariableTable::iterator it = locals.begin(); it != locals.end(); ++it)
+            it.value() = pack(unpack(it.value()));
+
+        packedNodes = paths->nodeCount();
+    }
+
+    Variable EnvironmentBaseline::unpack(const Variable &var)
+    {
+        if (var.value.userType() != qMetaTypeId<PathList>())
+            return var;
+
+        Variable unpacked = var;
+        unpacked.value = var.value.value<PathList>().toStringList();
+        return unpacked;
+    }
+
+    EnvironmentSnapshot::EnvironmentSnapshot()
+        : baseline(new EnvironmentBaseline()), ver(0)
+    {}
+
+    bool EnvironmentSnapshot::contains(const QString &name) const
+    { return lookup(name, Variable::User) || lookup(name, Variable::Global); }
+
+    bool EnvironmentSnapshot::lookup(const QString &name, Variable::Type type, Variable *var) const
+    {
+        const VariableTable &edits = overlayTable(type);
+        VariableTable::const_iterator it = edits.constFind(name);
+
+        if (it != edits.constEnd())
+        {
+            if (!it.value().value.isValid()) // removed
+                return false;
+
+            if (var)
+                *var = it.value();
+            return true;
+        }
+
+        const VariableTable &base = baselineTable(type);
+        it = base.constFind(name);
+
+        if (it == base.constEnd())
+            return false;
+
+        if (var)
+            *var = EnvironmentBaseline::unpack(it.value());
+        return true;
+    }
+
+    Variable EnvironmentSnapshot::variable(const QString &name) const
+    {
+        Variable var;
+        if (lookup(name, Variable::User, &var))
+            return var;
+
+        if (lookup(name, Variable::Global, &var))
+            return var;
+
+        Q_ASSERT(false);
+        return Variable();
+    }
+
+    Variable EnvironmentSnapshot::defaultVariable(const QString &name, Variable::Type type) const
+    {
+        const VariableTable &base = baselineTable(type);
+        VariableTable::const_iterator it = base.constFind(name);
+
+        if (it != base.constEnd())
+            return EnvironmentBaseline::unpack(it.value());
+
+        Variable var;
+        var.name = name;
+        var.type = type;
+        return var;
+    }
+
+    QList<Variable> EnvironmentSnapshot::environment(Variable::Type type) const
+    {
+        const VariableTable &base = baselineTable(type);
+        const VariableTable &edits = overlayTable(type);
+
+        QList<Variable> result;
+        result.reserve(base.count() + edits.count());
+
+        VariableTable::const_iterator it = base.constBegin();
+        for (; it != base.constEnd(); ++it)
+            if (!edits.contains(it.key()))
+                result.append(EnvironmentBaseline::unpack(it.value()));
+
+        for (it = edits.constBegin(); it != edits.constEnd(); ++it)
+            if (it.value().value.isValid())
+                result.append(it.value());
+
+        return result;
+    }
+}
@@ -0,0 +1,158 @@
+#ifndef ENVIRONMENTSNAPSHOT_H
+#define ENVIRONMENTSNAPSHOT_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// EnvironmentSnapshot is an immutable view of the variables
+// (loaded baseline + overlay of edits) at one point in time.
+// Snapshots are cheap to copy and safe to read from any thread.
+//
+
+#include <QSharedPointer>
+#include <QVariant>
+#include <QList>
+#include <QHash>
+
+#include "PathTrie.h"
+
+namespace EnvironmentExplorer
+{
+    struct Variable
+    {
+        Variable()
+            : type(User), expandable(false) {}
+
+        // Represents the name of env. var.
+        QString name;
+
+        // Represents the current value.
+        // (an invalid value marks a removed variable)
+        QVariant value;
+
+        enum Type { Global, User };
+        Type type;
+
+        // Stored as REG_EXPAND_SZ rather than REG_SZ.
+        bool expandable;
+
+        // "<type><name>", one key for both scopes.
+        static QString key(const QString &name, Type type)
+        { return QString::number(type) + name; }
+
+        static QString nameOfKey(const QString &key)
+        { return key.mid(1); }
+
+        static Type typeOfKey(const QString &key)
+        { return Type(key.at(0).digitValue()); }
+    };
+
+    typedef QHash<QString, Variable> VariableTable;
+
+    // Variables as they were loaded from the registry. Never modified
+    // once built, so it is shared rather than copied.
+    struct EnvironmentBaseline
+    {
+        EnvironmentBaseline()
+            : globalStamp(0), localStamp(0), paths(new PathTrie()), packedNodes(0) {}
+
+        // Moves the entries of a list value into the path trie.
+        Variable pack(const Variable &var);
+        void pack();
+
+        // Nodes of replaced values are never freed, and the trie goes
+        // from baseline to baseline on every save. Once it has grown
+        // to twice the nodes last packed, the values are packed again
+        // into a new trie; older snapshots keep the old one alive.
+        void compact();
+
+        // Values read straight off the tables may be packed (PathList),
+        // unpack() turns them back into a QStringList.
+        static Variable unpack(const Variable &var);
+
+        VariableTable globals, locals;
+
+        // Last write time of the registry keys and hashes of the
+        // values as read, to tell changes made by others at save.
+        qint64 globalStamp, localStamp;
+        QHash<QString, uint> globalHashes, localHashes;
+
+        // Shared with the copies made on save.
+        QSharedPointer<PathTrie> paths;
+
+        // Size of the trie after the last pack() or compact().
+        int packedNodes;
+    };
+
+    class EnvironmentSnapshot
+    {
+        friend class VariablesManager;
+
+    public:
+        EnvironmentSnapshot();
+
+        // Increases with every published change.
+        quint64 version() const
+        { return ver; }
+
+        bool contains(const QString &name) const;
+
+        bool contains(const QString &name,
+                      Variable::Type type) const
+        { return lookup(name, type); }
+
+        // Looks the variable up in the overlay first, then in the baseline.
+        bool lookup(const QString &name, Variable::Type type,
+                    Variable *var = 0) const;
+
+        // User variables shadow the system ones.
+        Variable variable(const QString &name) const;
+
+        // Returns the variable as it was loaded (invalid value if none).
+        Variable defaultVariable(const QString &name,
+                                 Variable::Type type) const;
+
+        bool isModified(const QString &name,
+                        Variable::Type type) const
+        { return overlayTable(type).contains(name); }
+
+        QList<Variable> environment(Variable::Type type) const;
+
+        QList<Variable> userEnvironment() const
+        { return environment(Variable::User); }
+
+        QList<Variable> systemEnvironment() const
+        { return environment(Variable::Global); }
+
+        const VariableTable &edits(Variable::Type type) const
+        { return overlayTable(type); }
+
+        // The loaded variables, list values still packed (PathList);
+        // for reading many without unpacking each one.
+        const VariableTable &baselineTable(Variable::Type type) const
+        { return (type == Variable::Global) ? baseline->globals : baseline->locals; }
+
+    private:
+
+        const VariableTable &overlayTable(Variable::Type type) const
+        { return (type == Variable::Global) ? globalEdits : localEdits; }
+
+        QSharedPointer<const EnvironmentBaseline> baseline;
+
+        // Sparse overlay of edits on top of the baseline.
+        VariableTable globalEdits, localEdits;
+
+        quint64 ver;
+    };
+}
+
+// Batches of variables are handed between threads (import).
+Q_DECLARE_METATYPE(EnvironmentExplorer::Variable)
+
+#endif // ENVIRONMENTSNAPSHOT_H
@@ -0,0 +1,416 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "ExportPipeline.h"
+#include "ValueCodec.h"
+#include "RunMetrics.h"
+#include "AllocationTracker.h"
+
+#include <QWaitCondition>
+#include <QThreadPool>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QVector>
+#include <QMutex>
+#include <QQueue>
+#include <QtEndian>
+#include <QFuture>
+#include <QFile>
+
+#include <QtConcurrent/QtConcurrentRun>
+
+namespace EnvironmentExplorer
+{
+    static const int batchSize = 256;
+    static const int queueCapacity = 16;        // batches
+    static const int bufferSize = 64 * 1024;    // written out when reached
+
+    // template.html, read from the resources once
+    static const QString &exportTemplate()
+    {
+        static QString cached;
+        if (cached.isEmpty())
+        {
+            QFile f("://template.html");
+            f.open(QFile::ReadOnly);
+            cached = f.readAll();
+        }
+        return cached;
+    }
+
+    //
+    // Encoders append the formatted records to the output buffer.
+    //
+    class RecordEncoder
+    {
+    public:
+        virtual ~RecordEncoder() {}
+
+        virtual void begin(QByteArray &) {}
+        virtual void encode(const Variable &var, QByteArray &out) = 0;
+        virtual void end(QByteArray &) {}
+    };
+
+    class HtmlEncoder : public RecordEncoder
+    {
+    public:
+        HtmlEncoder(const QString &computer, const QString &timestamp)
+        {
+            // the rows go where %3 is
+            QString page = exportTemplate();
+            int rows = page.indexOf("%3");
+
+            header = page.left(rows).arg(computer, timestamp).toUtf8();
+            footer = page.mid(rows + 2).toUtf8();
+        }
+
+        void begin(QByteArray &out)
+        { out.append(header); }
+
+        void encode(const Variable &var, QByteArray &out)
+        {
+            out.append("           <tr>\r\n                <td>");
+            out.append(var.name.toUtf8()).append("</td>\r\n                <td>\r\n");
+
+            foreach (const QString &value, ValueCodec::entries(var.value))
+                out.append("             ").append(value.toUtf8()).append("<br>\r\n");
+
+            out.append("           </tr>\r\n");
+        }
+
+        void end(QByteArray &out)
+        { out.append(footer); }
+
+    private:
+        QByteArray header, footer;
+    };
+
+    class PlainTextEncoder : public RecordEncoder
+    {
+    public:
+        void encode(const Variable &var, QByteArray &out)
+        {
+            out.append("Name: ").append(var.name.toUtf8()).append(" \r\n");
+            out.append("Value(s):\r\n");
+
+            foreach (const QString &value, ValueCodec::entries(var.value))
+                out.append("       ").append(value.toUtf8()).append("\r\n");
+
+            out.append("-----------------------------------------------\r\n");
+        }
+    };
+
+    class JsonEncoder : public RecordEncoder
+    {
+    public:
+        JsonEncoder(const QString &computer, const QString &timestamp)
+            : computer(computer), timestamp(timestamp), first(true) {}
+
+        void begin(QByteArray &out)
+        {
+            out.append("{\n  \"computer\": ");
+            appendString(out, computer);
+            out.append(",\n  \"timestamp\": ");
+            appendString(out, timestamp);
+            out.append(",\n  \"variables\": [");
+        }
+
+        void encode(const Variable &var, QByteArray &out)
+        {
+            out.append(first ? "\n    {\"name\": " : ",\n    {\"name\": ");
+            first = false;
+
+            appendString(out, var.name);
+            out.append(var.type == Variable::Global ? ", \"scope\": \"system\"" : ", \"scope\": \"user\"");
+            out.append(var.expandable ? ", \"expandable\": true" : ", \"expandable\": false");
+            out.append(", \"value\": [");
+
+            QStringList entries = ValueCodec::entries(var.value);
+            for (int i = 0; i < entries.count(); ++i)
+            {
+                if (i > 0)
+                    out.append(", ");
+                appendString(out, entries.at(i));
+            }
+
+            out.append("]}");
+        }
+
+        void end(QByteArray &out)
+        { out.append("\n  ]\n}\n"); }
+
+    private:
+        static void appendString(QByteArray &out, const QString &text)
+        {
+            out.append('"');
+            foreach (char c, text.toUtf8())
+            {
+                switch (c) {
+                case '"':  out.append("\\\""); break;
+                case '\\': out.append("\\\\"); break;
+                case '\n': out.append("\\n"); break;
+                case '\r': out.append("\\r"); break;
+                case '\t': out.append("\\t"); break;
+                default:
+                    if (uchar(c) < 0x20)
+                        out.append(QString("\\u%1").arg(int(c), 4, 16, QChar('0')).toLatin1());
+                    else
+                        out.append(c);
+                }
+            }
+            out.append('"');
+        }
+
+        QString computer, timestamp;
+        bool first;
+    };
+
+    // Read back by EnvironmentImporter (double quoted values).
+    class DotEnvEncoder : public RecordEncoder
+    {
+    public:
+        void encode(const Variable &var, QByteArray &out)
+        {
+            out.append(var.name.toUtf8()).append("=\"");
+            foreach (char c, ValueCodec::encode(var.value).toUtf8())
+            {
+                switch (c) {
+                case '"':  out.append("\\\""); break;
+                case '\\': out.append("\\\\"); break;
+                case '\n': out.append("\\n"); break;
+                case '\t': out.append("\\t"); break;
+                default:   out.append(c); break;
+                }
+            }
+            out.append("\"\n");
+        }
+    };
+
+    // "EEB1", then per variable [type][flags][size][name][size][value]
+    // (sizes little endian, strings UTF-8), closed by a 0xff byte.
+    class BinaryEncoder : public RecordEncoder
+    {
+    public:
+        void begin(QByteArray &out)
+        { out.append("EEB1"); }
+
+        void encode(const Variable &var, QByteArray &out)
+        {
+            out.append(char(var.type));
+            out.append(char(var.expandable ? 1 : 0));
+            appendBytes(out, var.name.toUtf8());
+            appendBytes(out, ValueCodec::encode(var.value).toUtf8());
+        }
+
+        void end(QByteArray &out)
+        { out.append(char(0xff)); }
+
+    private:
+        static void appendBytes(QByteArray &out, const QByteArray &bytes)
+        {
+            uchar size[4];
+            qToLittleEndian<quint32>(quint32(bytes.size()), size);
+            out.append(reinterpret_cast<const char*>(size), 4);
+            out.append(bytes);
+        }
+    };
+
+    //
+    // Bounded queue of record batches, one per encoder.
+    //
+    class RecordQueue
+    {
+    public:
+        RecordQueue()
+            : closed(false) {}
+
+        // Waits while the queue is full.
+        void push(const QVector<Variable> &batch)
+        {
+            QMutexLocker lock(&mutex);
+            while (batches.count() >= queueCapacity)
+                notFull.wait(&mutex);
+
+            batches.enqueue(batch);
+            notEmpty.wakeOne();
+        }
+
+        void close()
+        {
+            QMutexLocker lock(&mutex);
+            closed = true;
+            notEmpty.wakeOne();
+        }
+
+        // False once closed and drained.
+        bool pop(QVector<Variable> *batch)
+        {
+            QMutexLocker lock(&mutex);
+            while (batches.isEmpty() && !closed)
+                notEmpty.wait(&mutex);
+
+            if (batches.isEmpty())
+                return false;
+
+            *batch = batches.dequeue();
+            notFull.wakeOne();
+            return true;
+        }
+
+    private:
+        QMutex mutex;
+        QWaitCondition notFull, notEmpty;
+        QQueue<QVector<Variable> > batches;
+        bool closed;
+    };
+
+    // Encodes all batches of the queue into the file; the error
+    // (empty when written). Keeps draining after a failure so the
+    // reader is never left waiting.
+    static QString encodeAll(RecordEncoder* encoder, RecordQueue* queue, const QString &fileName)
+    {
+        QSaveFile file(fileName);
+        bool ok = file.open(QFile::WriteOnly);
+
+        QByteArray buffer;
+        buffer.reserve(bufferSize + 4096);
+
+        auto flush = [&](){
+            if (ok && file.write(buffer) != buffer.size())
+                ok = false;
+            buffer.clear();
+        };
+
+        encoder->begin(buffer);
+
+        QVector<Variable> batch;
+        while (queue->pop(&batch))
+        {
+            if (!ok)
+                continue;
+
+            foreach (const Variable &var, batch)
+                encoder->encode(var, buffer);
+
+            if (buffer.size() >= bufferSize)
+                flush();
+        }
+
+        encoder->end(buffer);
+        flush();
+
+        if (!ok || !file.commit())
+            return QString("%1: %2").arg(fileName, file.errorString());
+
+        return QString();
+    }
+
+    ExportPipeline::ExportPipeline(const QString &computer, const QString &timestamp)
+        : computer(computer), timestamp(timestamp)
+    {}
+
+    QString ExportPipeline::suffix(Format format)
+    {
+        static const char* suffixes[] = { "html", "log", "json", "env", "eeb" };
+        return QString(suffixes[format]);
+    }
+
+    QString ExportPipeline::fileName(const QString &base, Format format)
+    {
+        QString name = base;
+        QString current = QFileInfo(base).suffix().toLower();
+
+        for (int f = Html; f <= Binary; ++f)
+            if (current == suffix(Format(f))) {
+                name.chop(current.size() + 1);
+                break;
+            }
+
+        return name + "." + suffix(format);
+    }
+
+    void ExportPipeline::addTarget(Format format, const QString &fileName)
+    {
+        Target target = { format, fileName };
+        targets.append(target);
+    }
+
+    bool ExportPipeline::run(const std::function<bool (Variable*)> &next)
+    {
+        AllocationScope scope("export");
+        OperationTimer timer("export");
+
+        errors.clear();
+
+        int count = targets.count();
+        QVector<RecordEncoder*> encoders(count);
+        QVector<RecordQueue*> queues(count);
+
+        for (int i = 0; i < count; ++i)
+        {
+            switch (targets.at(i).format)
+            {
+                case Html:      encoders[i] = new HtmlEncoder(computer, timestamp); break;
+                case PlainText: encoders[i] = new PlainTextEncoder(); break;
+                case Json:      encoders[i] = new JsonEncoder(computer, timestamp); break;
+                case DotEnv:    encoders[i] = new DotEnvEncoder(); break;
+                default:        encoders[i] = new BinaryEncoder(); break;
+            }
+            queues[i] = new RecordQueue();
+        }
+
+        // a thread for every encoder: the reader waits on full
+        // queues, an encoder left without a thread would stall it
+        QThreadPool pool;
+        pool.setMaxThreadCount(qMax(count, 1));
+
+        QList<QFuture<QString> > results;
+        for (int i = 0; i < count; ++i)
+            results.append(QtConcurrent::run(&pool, encodeAll, encoders[i], queues[i], targets.at(i).fileName));
+
+        QVector<Variable> batch;
+        batch.reserve(batchSize);
+
+        Variable var;
+        for (;;)
+        {
+            bool more = next(&var);
+            if (more)
+                batch.append(var);
+
+            if (batch.count() == batchSize || (!more && !batch.isEmpty()))
+            {
+                // shared by all queues, nothing is copied
+                foreach (RecordQueue* queue, queues)
+                    queue->push(batch);
+
+                batch = QVector<Variable>();
+                batch.reserve(batchSize);
+            }
+
+            if (!more)
+                break;
+        }
+
+        foreach (RecordQueue* queue, queues)
+            queue->close();
+
+        for (int i = 0; i < count; ++i)
+        {
+            QString error = results[i].result();
+            if (!error.isEmpty())
+                errors.append(error);
+
+            delete encoders[i];
+            delete queues[i];
+        }
+
+        return errors.isEmpty();
+    }
+}
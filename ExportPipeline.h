@@ -0,0 +1,73 @@
+#ifndef EXPORTPIPELINE_H
+#define EXPORTPIPELINE_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// ExportPipeline writes several formats in one pass over the
+// variables. The caller's thread reads the records and hands them,
+// in batches, to one encoder per format; each encoder runs on its
+// own thread and writes through its own buffer. The queues between
+// them are bounded, so a slow encoder holds the reader back instead
+// of the batches piling up:
+//
+//     ExportPipeline pipeline(computerName, timestamp);
+//     pipeline.addTarget(ExportPipeline::Html, "env.html");
+//     pipeline.addTarget(ExportPipeline::Json, "env.json");
+//     pipeline.run([&](Variable* var){ ... return more; });
+//
+
+#include <QStringList>
+#include <QString>
+#include <QList>
+
+#include <functional>
+
+#include "EnvironmentSnapshot.h"
+
+namespace EnvironmentExplorer
+{
+    class ExportPipeline
+    {
+    public:
+        enum Format { Html, PlainText, Json, DotEnv, Binary };
+
+        ExportPipeline(const QString &computer, const QString &timestamp);
+
+        // "html", "log", "json", "env", "eeb"
+        static QString suffix(Format format);
+
+        // The base name with the suffix of the format, in place of
+        // the suffix of any other format.
+        static QString fileName(const QString &base, Format format);
+
+        void addTarget(Format format, const QString &fileName);
+
+        // Calls next() until it returns false; each call fills in one
+        // record. False when a target could not be written.
+        bool run(const std::function<bool (Variable*)> &next);
+
+        // One line per target which failed.
+        QString errorString() const
+        { return errors.join("\n"); }
+
+    private:
+        struct Target
+        {
+            Format format;
+            QString fileName;
+        };
+
+        QString computer, timestamp;
+        QList<Target> targets;
+        QStringList errors;
+    };
+}
+
+#endif // EXPORTPIPELINE_H
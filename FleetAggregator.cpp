@@ -0,0 +1,436 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "FleetAggregator.h"
+#include "EnvironmentImporter.h"
+#include "ValueCodec.h"
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QVector>
+#include <QThread>
+#include <QMutex>
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QDir>
+
+#include <algorithm>
+#include <math.h>
+
+namespace EnvironmentExplorer
+{
+    // Upper-cased name -> entries, as one machine sees it.
+    typedef QHash<QString, QStringList> MachineEnvironment;
+
+    static void addToMachine(MachineEnvironment &env, const QString &name, const QStringList &entries)
+    {
+        QString key = name.toUpper();
+
+        // user PATH comes after the system one
+        if (key == "PATH" && env.contains(key))
+            env[key] += entries;
+        else
+            env.insert(key, entries);
+    }
+
+    // Our own exports: "Name: X" followed by indented entries (.log),
+    // or "<td>X</td>" followed by "entry<br>" lines (.html).
+    static bool readExport(const QString &fileName, bool html, MachineEnvironment &env)
+    {
+        QFile file(fileName);
+        if (!file.open(QFile::ReadOnly|QFile::Text))
+            return false;
+
+        QString name;
+        QStringList entries;
+        bool inBody = !html; // skip the table header of the template
+
+        while (!file.atEnd())
+        {
+            QString line = QString::fromUtf8(file.readLine()).trimmed();
+
+            bool starts = html ? (line.startsWith("<td>") && line.endsWith("</td>"))
+                               : line.startsWith("Name:");
+            bool ends = html ? line.startsWith("</tr>") : line.startsWith("-----");
+
+            if (html && line.startsWith("<tbody>"))
+                inBody = true;
+
+            if (!inBody)
+                continue;
+
+            if (starts || ends)
+            {
+                if (!name.isEmpty())
+                    addToMachine(env, name, entries);
+
+                name = starts ? (html ? line.mid(4, line.size() - 9) : line.mid(5).trimmed())
+                              : QString();
+                entries.clear();
+            }
+            else if (!name.isEmpty())
+            {
+                if (html && line.endsWith("<br>"))
+                    entries.append(line.left(line.size() - 4));
+                else if (!html && !line.isEmpty() && line != "Value(s):")
+                    entries.append(line);
+            }
+        }
+
+        if (!name.isEmpty())
+            addToMachine(env, name, entries);
+
+        return true;
+    }
+
+    static bool readSnapshot(const QString &fileName, MachineEnvironment &env)
+    {
+        QString suffix = QFileInfo(fileName).suffix().toLower();
+
+        if (suffix == "log")
+            return readExport(fileName, false, env);
+        if (suffix == "html" || suffix == "htm")
+            return readExport(fileName, true, env);
+
+        EnvironmentImporter importer;
+        importer.setFormat(EnvironmentImporter::detectFormat(fileName));
+
+        // same thread, the connection is direct
+        QObject::connect(&importer, &EnvironmentImporter::batchReady, [&](const QList<Variable> &batch){
+            foreach (const Variable &var, batch)
+                if (var.value.isValid())
+                    addToMachine(env, var.name, ValueCodec::entries(var.value));
+        });
+
+        return importer.importFile(fileName);
+    }
+
+    struct FleetMachine
+    {
+        QString name;
+
+        // (name id, value id), sorted by name id
+        QVector<QPair<int, int> > variables;
+    };
+
+    // Merged result of the files read so far.
+    struct FleetAggregate
+    {
+        FleetAggregate()
+            : failedCount(0) {}
+
+        int intern(const QString &text)
+        {
+            QHash<QString, int>::const_iterator it = ids.constFind(text);
+            if (it != ids.constEnd())
+                return it.value();
+
+            int id = strings.count();
+            strings.append(text);
+            ids.insert(text, id);
+            return id;
+        }
+
+        void merge(const QString &machineName, const MachineEnvironment &env)
+        {
+            FleetMachine machine;
+            machine.name = machineName;
+            machine.variables.reserve(env.count());
+
+            MachineEnvironment::const_iterator it = env.constBegin();
+            for (; it != env.constEnd(); ++it)
+            {
+                int nameId = intern(it.key());
+                int valueId = intern(it.value().join(";"));
+
+                ++variableCount[nameId];
+                ++valueCount[nameId][valueId];
+                machine.variables.append(qMakePair(nameId, valueId));
+
+                if (it.key() != "PATH")
+                    continue;
+
+                // each entry counts once per machine
+                QSet<int> seen;
+                foreach (const QString &entry, it.value())
+                {
+                    if (entry.isEmpty())
+                        continue;
+
+                    int entryId = intern(entry);
+                    if (!seen.contains(entryId)) {
+                        seen.insert(entryId);
+                        ++entryCount[entryId];
+                    }
+                }
+            }
+
+            std::sort(machine.variables.begin(), machine.variables.end());
+            machines.append(machine);
+        }
+
+        QHash<QString, int> ids;
+        QVector<QString> strings;
+
+        QHash<int, int> variableCount;              // name id -> machines
+        QHash<int, int> entryCount;                 // PATH entry id -> machines
+        QHash<int, QHash<int, int> > valueCount;    // name id -> value id -> machines
+
+        QVector<FleetMachine> machines;
+        int failedCount;
+
+        QMutex mutex;
+    };
+
+    // Takes files off the shared list until none is left; at most
+    // one parsed file per worker is alive at a time.
+    class FleetWorker : public QRunnable
+    {
+    public:
+        FleetWorker(FleetAggregate &aggregate, const QStringList &files, QAtomicInt &next)
+            : aggregate(aggregate), files(files), next(next) {}
+
+        void run()
+        {
+            for (;;)
+            {
+                int index = next.fetchAndAddRelaxed(1);
+                if (index >= files.count())
+                    return;
+
+                const QString &fileName = files.at(index);
+
+                MachineEnvironment env;
+                bool ok = readSnapshot(fileName, env);
+
+                QMutexLocker lock(&aggregate.mutex);
+                if (ok && !env.isEmpty())
+                    aggregate.merge(QFileInfo(fileName).completeBaseName(), env);
+                else
+                    ++aggregate.failedCount;
+            }
+        }
+
+    private:
+        FleetAggregate &aggregate;
+        const QStringList &files;
+        QAtomicInt &next;
+    };
+
+    static bool countLessThan(const FleetCount &a, const FleetCount &b)
+    {
+        if (a.machines != b.machines)
+            return a.machines > b.machines;
+        return a.text < b.text;
+    }
+
+    static bool clusterLessThan(const FleetCluster &a, const FleetCluster &b)
+    {
+        if (a.values.count() != b.values.count())
+            return a.values.count() > b.values.count();
+        return a.name < b.name;
+    }
+
+    static bool outlierLessThan(const FleetOutlier &a, const FleetOutlier &b)
+    {
+        if (a.score != b.score)
+            return a.score > b.score;
+        return a.machine < b.machine;
+    }
+
+    static QList<FleetCount> ranked(const QHash<int, int> &counts, const QVector<QString> &strings)
+    {
+        QList<FleetCount> result;
+        result.reserve(counts.count());
+
+        QHash<int, int>::const_iterator it = counts.constBegin();
+        for (; it != counts.constEnd(); ++it)
+        {
+            FleetCount count;
+            count.text = strings.at(it.key());
+            count.machines = it.value();
+            result.append(count);
+        }
+
+        std::sort(result.begin(), result.end(), countLessThan);
+        return result;
+    }
+
+    static QList<FleetOutlier> findOutliers(const FleetAggregate &aggregate)
+    {
+        int total = aggregate.machines.count();
+        if (total < 3)
+            return QList<FleetOutlier>();
+
+        // rare: held by at most 1% of the fleet (one machine at least),
+        // common: held by all the others
+        int rare = qMax(1, total / 100);
+        int common = total - rare;
+
+        QVector<int> commonNames;
+        QHash<int, int>::const_iterator it = aggregate.variableCount.constBegin();
+        for (; it != aggregate.variableCount.constEnd(); ++it)
+            if (it.value() >= common)
+                commonNames.append(it.key());
+
+        QList<FleetOutlier> candidates;
+        double sum = 0, squares = 0;
+
+        foreach (const FleetMachine &machine, aggregate.machines)
+        {
+            FleetOutlier outlier;
+            outlier.machine = machine.name;
+
+            typedef QPair<int, int> Pair;
+            foreach (const Pair &var, machine.variables)
+                if (aggregate.valueCount.constFind(var.first)->value(var.second) <= rare &&
+                    aggregate.variableCount.value(var.first) > rare)
+                    outlier.rareValues.append(aggregate.strings.at(var.first));
+
+            foreach (int nameId, commonNames)
+            {
+                QVector<Pair>::const_iterator found =
+                        std::lower_bound(machine.variables.constBegin(), machine.variables.constEnd(),
+                                         qMakePair(nameId, -1));
+
+                if (found == machine.variables.constEnd() || found->first != nameId)
+                    outlier.missingVariables.append(aggregate.strings.at(nameId));
+            }
+
+            outlier.score = outlier.rareValues.count() + outlier.missingVariables.count();
+            sum += outlier.score;
+            squares += double(outlier.score) * outlier.score;
+
+            if (outlier.score > 0)
+                candidates.append(outlier);
+        }
+
+        // more than two standard deviations above the mean
+        double mean = sum / total;
+        double deviation = sqrt(qMax(0.0, squares / total - mean * mean));
+
+        QList<FleetOutlier> outliers;
+        foreach (const FleetOutlier &outlier, candidates)
+            if (outlier.score > mean + 2 * deviation)
+                outliers.append(outlier);
+
+        std::sort(outliers.begin(), outliers.end(), outlierLessThan);
+        return outliers;
+    }
+
+    QStringList FleetAggregator::snapshotFiles(const QString &directory)
+    {
+        QStringList filters;
+        filters << "*.env" << "*.sh" << "*.bash" << "*.reg" << "*.log" << "*.html" << "*.htm";
+
+        QDir dir(directory);
+        QStringList files;
+        foreach (const QString &name, dir.entryList(filters, QDir::Files, QDir::Name))
+            files.append(dir.filePath(name));
+
+        return files;
+    }
+
+    FleetStatistics FleetAggregator::aggregate(const QString &directory, int threads)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        QStringList files = snapshotFiles(directory);
+        if (threads <= 0)
+            threads = QThread::idealThreadCount();
+        threads = qBound(1, threads, qMax(1, files.count()));
+
+        FleetAggregate aggregate;
+        QAtomicInt next(0);
+
+        // A private pool: the global one may be busy with the GUI's work.
+        QThreadPool pool;
+        pool.setMaxThreadCount(threads);
+        for (int i = 0; i < threads; ++i)
+            pool.start(new FleetWorker(aggregate, files, next));
+        pool.waitForDone();
+
+        FleetStatistics stats;
+        stats.machineCount = aggregate.machines.count();
+        stats.failedCount = aggregate.failedCount;
+        stats.variables = ranked(aggregate.variableCount, aggregate.strings);
+        stats.pathEntries = ranked(aggregate.entryCount, aggregate.strings);
+
+        QHash<int, QHash<int, int> >::const_iterator name = aggregate.valueCount.constBegin();
+        for (; name != aggregate.valueCount.constEnd(); ++name)
+        {
+            FleetCluster cluster;
+            cluster.name = aggregate.strings.at(name.key());
+            cluster.machines = aggregate.variableCount.value(name.key());
+            cluster.values = ranked(name.value(), aggregate.strings);
+            stats.clusters.append(cluster);
+        }
+        std::sort(stats.clusters.begin(), stats.clusters.end(), clusterLessThan);
+
+        stats.outliers = findOutliers(aggregate);
+        stats.elapsed = timer.elapsed();
+        return stats;
+    }
+
+    static QString shortened(const QString &text, int length = 80)
+    { return (text.size() > length) ? text.left(length - 3) + "..." : text; }
+
+    QString FleetAggregator::report(const FleetStatistics &stats, int top)
+    {
+        QString out;
+        out += QString("Fleet: %1 machine(s), %2 unreadable file(s), %3 ms\n")
+               .arg(stats.machineCount).arg(stats.failedCount).arg(stats.elapsed);
+
+        out += "\nMost common variables:\n";
+        for (int i = 0; i < stats.variables.count() && i < top; ++i)
+            out += QString("%1  %2\n").arg(stats.variables.at(i).machines, 8)
+                                      .arg(stats.variables.at(i).text);
+
+        out += "\nMost common PATH entries:\n";
+        for (int i = 0; i < stats.pathEntries.count() && i < top; ++i)
+            out += QString("%1  %2\n").arg(stats.pathEntries.at(i).machines, 8)
+                                      .arg(stats.pathEntries.at(i).text);
+
+        out += "\nMost divergent variables:\n";
+        for (int i = 0; i < stats.clusters.count() && i < top; ++i)
+        {
+            const FleetCluster &cluster = stats.clusters.at(i);
+            if (cluster.values.count() < 2)
+                break;
+
+            out += QString("  %1: %2 value(s) on %3 machine(s)\n")
+                   .arg(cluster.name).arg(cluster.values.count()).arg(cluster.machines);
+
+            for (int j = 0; j < cluster.values.count() && j < 5; ++j)
+                out += QString("%1  %2\n").arg(cluster.values.at(j).machines, 8)
+                                          .arg(shortened(cluster.values.at(j).text));
+        }
+
+        out += "\nOutliers:\n";
+        for (int i = 0; i < stats.outliers.count() && i < top; ++i)
+        {
+            const FleetOutlier &outlier = stats.outliers.at(i);
+            out += QString("%1  %2\n").arg(outlier.score, 8).arg(outlier.machine);
+
+            if (!outlier.rareValues.isEmpty())
+                out += QString("          rare: %1\n").arg(shortened(outlier.rareValues.join(", ")));
+            if (!outlier.missingVariables.isEmpty())
+                out += QString("          missing: %1\n").arg(shortened(outlier.missingVariables.join(", ")));
+        }
+
+        return out;
+    }
+}
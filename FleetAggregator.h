@@ -0,0 +1,76 @@
+#ifndef FLEETAGGREGATOR_H
+#define FLEETAGGREGATOR_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// FleetAggregator reads a directory of environment snapshots, one
+// file per machine (.env, .sh, .reg or our own .log/.html exports),
+// and reduces them into fleet statistics. Files are parsed by a
+// bounded set of workers, each result is merged as soon as it is
+// read; names and values are interned, so memory grows with the
+// number of distinct strings rather than with the number of files.
+//
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+namespace EnvironmentExplorer
+{
+    struct FleetCount
+    {
+        QString text;
+        int machines;
+    };
+
+    // Distinct values of one variable, most common first.
+    struct FleetCluster
+    {
+        QString name;
+        int machines;
+        QList<FleetCount> values;
+    };
+
+    struct FleetOutlier
+    {
+        QString machine;
+        int score;
+
+        QStringList rareValues;         // values (almost) nobody else has
+        QStringList missingVariables;   // variables (almost) everybody else has
+    };
+
+    struct FleetStatistics
+    {
+        int machineCount;
+        int failedCount;
+        qint64 elapsed;     // ms
+
+        QList<FleetCount> variables;    // most common first
+        QList<FleetCount> pathEntries;
+        QList<FleetCluster> clusters;
+        QList<FleetOutlier> outliers;   // highest score first
+    };
+
+    class FleetAggregator
+    {
+    public:
+        static QStringList snapshotFiles(const QString &directory);
+
+        // Blocks until all files are read; threads <= 0 picks
+        // QThread::idealThreadCount().
+        static FleetStatistics aggregate(const QString &directory, int threads = 0);
+
+        // Plain text summary, top entries of each list.
+        static QString report(const FleetStatistics &stats, int top = 20);
+    };
+}
+
+#endif // FLEETAGGREGATOR_H
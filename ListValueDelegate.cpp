@@ -0,0 +1,239 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "ListValueDelegate.h"
+
+#include <QApplication>
+#include <QMouseEvent>
+#include <QHeaderView>
+#include <QTableView>
+#include <QPainter>
+
+#include <limits.h>
+
+namespace EnvironmentExplorer
+{
+    static const int margin = 3;
+
+    // Upper bound of cached rows, a screen needs only a handful.
+    static const int maxCachedRows = 2048;
+
+    ListValueDelegate::ListValueDelegate(QObject *parent)
+        : QStyledItemDelegate(parent), view(0), column(0), maxEntries(8),
+          dirtyFirst(-1), dirtyLast(-1)
+    {
+        relayoutTimer.setSingleShot(true);
+        relayoutTimer.setInterval(0);
+        connect(&relayoutTimer, &QTimer::timeout, this, &ListValueDelegate::resizeRows);
+    }
+
+    void ListValueDelegate::setMaximumEntries(int count)
+    {
+        maxEntries = qMax(1, count);
+        invalidate();
+    }
+
+    void ListValueDelegate::attach(QTableView *view, int column)
+    {
+        this->view = view;
+        this->column = column;
+
+        view->setItemDelegateForColumn(column, this);
+        view->verticalHeader()->setSectionResizeMode(QHeaderView::Interactive);
+
+        QAbstractItemModel* model = view->model();
+        connect(model, &QAbstractItemModel::dataChanged, this, &ListValueDelegate::invalidateRows);
+        connect(model, &QAbstractItemModel::rowsInserted, this, &ListValueDelegate::insertRows);
+        connect(model, &QAbstractItemModel::rowsRemoved, this, &ListValueDelegate::invalidate);
+        connect(model, &QAbstractItemModel::modelReset, this, &ListValueDelegate::invalidate);
+        connect(model, &QAbstractItemModel::layoutChanged, this, &ListValueDelegate::invalidate);
+    }
+
+    void ListValueDelegate::invalidate()
+    {
+        cache.clear();
+        markRows(0, INT_MAX);
+    }
+
+    void ListValueDelegate::invalidateRows(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+    {
+        for (int row = topLeft.row(); row <= bottomRight.row(); ++row)
+            cache.remove(row);
+
+        markRows(topLeft.row(), bottomRight.row());
+    }
+
+    void ListValueDelegate::insertRows(const QModelIndex &, int first, int last)
+    {
+        // the rows below have moved, their layouts are keyed by row
+        cache.clear();
+        markRows(first, last);
+    }
+
+    void ListValueDelegate::markRows(int first, int last)
+    {
+        dirtyFirst = (dirtyFirst < 0) ? first : qMin(dirtyFirst, first);
+        dirtyLast = qMax(dirtyLast, last);
+        relayoutTimer.start();
+    }
+
+    int ListValueDelegate::visibleLines(const QModelIndex &index) const
+    {
+        int count = index.data(EntriesRole).toStringList().count();
+
+        if (count <= maxEntries)
+            return qMax(1, count);
+
+        // + the toggle line
+        return index.data(ExpandedRole).toBool() ? count + 1 : maxEntries + 1;
+    }
+
+    int ListValueDelegate::rowHeight(const QModelIndex &index) const
+    {
+        int spacing = view ? view->fontMetrics().lineSpacing()
+                           : QApplication::fontMetrics().lineSpacing();
+
+        return visibleLines(index) * spacing + 2 * margin;
+    }
+
+    const ListValueDelegate::RowLayout &ListValueDelegate::rowLayout(const QModelIndex &index) const
+    {
+        QHash<int, RowLayout>::const_iterator it = cache.constFind(index.row());
+        if (it != cache.constEnd())
+            return it.value();
+
+        if (cache.count() >= maxCachedRows)
+            cache.clear();
+
+        QStringList entries = index.data(EntriesRole).toStringList();
+        bool expanded = index.data(ExpandedRole).toBool();
+        int shown = (entries.count() <= maxEntries || expanded) ? entries.count() : maxEntries;
+
+        RowLayout layout;
+        layout.lines.reserve(shown);
+
+        for (int i = 0; i < shown; ++i)
+        {
+            QStaticText line(entries.at(i));
+            line.setTextFormat(Qt::PlainText);
+            layout.lines.append(line);
+        }
+
+        layout.hasToggle = entries.count() > maxEntries;
+        if (layout.hasToggle)
+        {
+            layout.toggle.setText(expanded ? QString("show less")
+                                           : QString("+%1 more").arg(entries.count() - shown));
+            layout.toggle.setTextFormat(Qt::PlainText);
+        }
+
+        return cache.insert(index.row(), layout).value();
+    }
+
+    void ListValueDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option,
+                                  const QModelIndex &index) const
+    {
+        // background, selection and focus as usual, text is ours
+        QStyleOptionViewItem opt = option;
+        initStyleOption(&opt, index);
+        opt.text.clear();
+
+        const QWidget* widget = option.widget;
+        QStyle* style = widget ? widget->style() : QApplication::style();
+        style->drawControl(QStyle::CE_ItemViewItem, &opt, painter, widget);
+
+        const RowLayout &layout = rowLayout(index);
+        int spacing = option.fontMetrics.lineSpacing();
+
+        QPalette::ColorGroup group = (option.state & QStyle::State_Enabled) ? QPalette::Normal
+                                                                             : QPalette::Disabled;
+        QPalette::ColorRole role = (option.state & QStyle::State_Selected) ? QPalette::HighlightedText
+                                                                            : QPalette::Text;
+        painter->save();
+        painter->setClipRect(option.rect);
+        painter->setFont(option.font);
+        painter->setPen(option.palette.color(group, role));
+
+        QPointF pos(option.rect.left() + margin, option.rect.top() + margin);
+        foreach (const QStaticText &line, layout.lines)
+        {
+            if (pos.y() > option.rect.bottom())
+                break;
+
+            painter->drawStaticText(pos, line);
+            pos.ry() += spacing;
+        }
+
+        if (layout.hasToggle)
+        {
+            painter->setPen(option.palette.color(group, QPalette::Link));
+            painter->drawStaticText(pos, layout.toggle);
+        }
+
+        painter->restore();
+    }
+
+    QSize ListValueDelegate::sizeHint(const QStyleOptionViewItem &option,
+                                      const QModelIndex &index) const
+    {
+        const RowLayout &layout = rowLayout(index);
+
+        int width = 0;
+        foreach (const QStaticText &line, layout.lines)
+            width = qMax(width, option.fontMetrics.width(line.text()));
+
+        return QSize(width + 2 * margin, rowHeight(index));
+    }
+
+    bool ListValueDelegate::editorEvent(QEvent *event, QAbstractItemModel *model,
+                                        const QStyleOptionViewItem &option, const QModelIndex &index)
+    {
+        if (event->type() != QEvent::MouseButtonRelease)
+            return QStyledItemDelegate::editorEvent(event, model, option, index);
+
+        const RowLayout &layout = rowLayout(index);
+        if (!layout.hasToggle)
+            return QStyledItemDelegate::editorEvent(event, model, option, index);
+
+        QMouseEvent* mouse = static_cast<QMouseEvent*>(event);
+        int line = (mouse->pos().y() - option.rect.top() - margin) / option.fontMetrics.lineSpacing();
+
+        if (line != layout.lines.count())
+            return QStyledItemDelegate::editorEvent(event, model, option, index);
+
+        // dataChanged() drops the cached layout of the row
+        model->setData(index, !index.data(ExpandedRole).toBool(), ExpandedRole);
+
+        if (view)
+            view->setRowHeight(index.row(), rowHeight(index));
+
+        return true;
+    }
+
+    void ListValueDelegate::resizeRows()
+    {
+        int first = dirtyFirst, last = dirtyLast;
+        dirtyFirst = dirtyLast = -1;
+
+        if (!view || !view->model() || first < 0)
+            return;
+
+        // Heights only depend on the entry count, no text is laid
+        // out, so rows outside the viewport are sized as well.
+        QAbstractItemModel* model = view->model();
+        last = qMin(last, model->rowCount() - 1);
+
+        for (int row = first; row <= last; ++row)
+        {
+            int wanted = rowHeight(model->index(row, column));
+            if (view->rowHeight(row) != wanted)
+                view->setRowHeight(row, wanted);
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef LISTVALUEDELEGATE_H
+#define LISTVALUEDELEGATE_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// ListValueDelegate draws the entries of a (list) value one per line,
+// straight from the QStringList stored in EntriesRole. Long lists are
+// collapsed into a "+N more" line which expands on click.
+// Row heights follow from the entry count alone, so every row is
+// sized without laying out any text and the scroll range does not
+// change while scrolling. The display text stays the joined value
+// (copy, accessibility); only the drawing is ours.
+//
+
+#include <QStyledItemDelegate>
+#include <QStaticText>
+#include <QVector>
+#include <QTimer>
+#include <QHash>
+
+class QTableView;
+
+namespace EnvironmentExplorer
+{
+    class ListValueDelegate : public QStyledItemDelegate
+    {
+        Q_OBJECT
+
+    public:
+        enum { EntriesRole = Qt::UserRole + 1, ExpandedRole };
+
+        ListValueDelegate(QObject* parent = 0);
+
+        // Entries shown before the rest is collapsed.
+        void setMaximumEntries(int count);
+        int maximumEntries() const
+        { return maxEntries; }
+
+        // Takes over row sizing of the view for the given column.
+        void attach(QTableView* view, int column);
+
+        void paint(QPainter* painter, const QStyleOptionViewItem &option,
+                   const QModelIndex &index) const;
+        QSize sizeHint(const QStyleOptionViewItem &option,
+                       const QModelIndex &index) const;
+
+        int rowHeight(const QModelIndex &index) const;
+
+    public slots:
+        void resizeRows();
+        void invalidate();
+
+    protected:
+        bool editorEvent(QEvent* event, QAbstractItemModel* model,
+                         const QStyleOptionViewItem &option, const QModelIndex &index);
+
+    private:
+        struct RowLayout
+        {
+            QVector<QStaticText> lines;
+            QStaticText toggle;  // "+N more" / "show less"
+            bool hasToggle;
+        };
+
+        const RowLayout &rowLayout(const QModelIndex &index) const;
+        int visibleLines(const QModelIndex &index) const;
+        void invalidateRows(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+        void insertRows(const QModelIndex &parent, int first, int last);
+
+        // Rows to be sized on the next resizeRows().
+        void markRows(int first, int last);
+
+        QTableView* view;
+        int column;
+        int maxEntries;
+
+        // row -> prepared lines, dropped when the row changes
+        mutable QHash<int, RowLayout> cache;
+
+        // coalesces relayout requests (model changes)
+        QTimer relayoutTimer;
+        int dirtyFirst, dirtyLast;
+    };
+}
+
+#endif // LISTVALUEDELEGATE_H
@@ -10,6 +10,12 @@
 #include "MainDialog.h"
 #include "MainDialogUi.h"
 #include "VariablesManager.h"
+#include "EnvironmentImporter.h"
+#include "ValueCodec.h"
+#include "AllocationTracker.h"
+#include "RunMetrics.h"
+#include "StartupProfiler.h"
+#include "ExportPipeline.h"
 
 #include <QApplication>
 #include <QTime>
@@ -17,6 +23,12 @@
 #include <QFile>
 #include <QString>
 #include <QtDebug>
+#include <QUndoStack>
+#include <QEventLoop>
+#include <QTimer>
+#include <QSet>
+
+#include <QtConcurrent/QtConcurrentRun>
 
 #if defined(Q_OS_WIN32)
 #include <qt_windows.h>
@@ -51,7 +63,12 @@ namespace EnvironmentExplorer
     MainDialog::MainDialog(QWidget *parent)
         : QWidget(parent), ui(new UserInterface()),
           variableManager(new VariablesManager()),
-          variableDialog(new VariableDialog(this))
+          variableDialog(0),
+          effectiveEnvironment(0), effectiveDialog(0), processDialog(0),
+          refillPending(false), changesHeld(false), changeTimer(new QTimer(this)),
+          launcher(0), launchDialog(0),
+          undoStack(new QUndoStack(this)), filterTimer(new QTimer(this)),
+          allocationDialog(0), sizeProfiler(0), profilerDialog(0)
     {
         setWindowTitle(tr("Environment explorer"));
         setLayout(ui->layout);
@@ -63,10 +80,9 @@ namespace EnvironmentExplorer
         if (!isInvokerAdmin())
             ui->saveButton->setDisabled(true);
 
-
-
+        // fills the table, see environmentReset
         variableManager->loadVariables();
-        fillTable();
+        StartupProfiler::mark("variables loaded");
     }
 
     MainDialog::~MainDialog()
@@ -78,92 +94,304 @@ namespace EnvironmentExplorer
         connect(ui->addButton, &QPushButton::pressed, this, &MainDialog::addVariable);
         connect(ui->closeButton, &QPushButton::pressed, this, &MainDialog::close);
         connect(ui->exportButton, &QPushButton::pressed, this, &MainDialog::exportEnvironment);
+        connect(ui->importButton, &QPushButton::pressed, this, &MainDialog::importEnvironment);
+        connect(ui->replaceButton, &QPushButton::pressed, this, &MainDialog::replaceValues);
+
+        // undo...
+        QAction* undoAction = undoStack->createUndoAction(this);
+        undoAction->setShortcut(QKeySequence::Undo);
+        addAction(undoAction);
+
+        QAction* redoAction = undoStack->createRedoAction(this);
+        redoAction->setShortcut(QKeySequence::Redo);
+        addAction(redoAction);
+
+        // rows follow the manager; a batch is applied at once
+        changeTimer->setSingleShot(true);
+        changeTimer->setInterval(0);
+        connect(changeTimer, &QTimer::timeout, this, &MainDialog::applyChanges);
+        connect(variableManager, &VariablesManager::variableChanged, [&](const QString &name, Variable::Type type){
+            // many rows at once (an import, a large batch) are
+            // quicker to fill again than to move one by one
+            if (!refillPending && changedKeys.count() >= qMax(1000, order.count() / 8))
+            {
+                refillPending = true;
+                changedKeys.clear();
+            }
+
+            if (!refillPending)
+                changedKeys.insert(Variable::key(name, type));
+
+            if (!changesHeld)
+                changeTimer->start();
+        });
+        connect(variableManager, &VariablesManager::environmentReset, this, &MainDialog::fillTable);
+
         connect(ui->saveButton, &QPushButton::pressed, this, &MainDialog::saveEnvironment);
         connect(ui->resetButton, &QPushButton::pressed, this, &MainDialog::resetTable);
+        connect(ui->effectiveButton, &QPushButton::pressed, this, &MainDialog::showEffectiveEnvironment);
+        connect(ui->processesButton, &QPushButton::pressed, this, &MainDialog::showProcessEnvironments);
+        connect(ui->profilesButton, &QPushButton::pressed, this, &MainDialog::showProfiles);
+        connect(ui->launchButton, &QPushButton::pressed, this, &MainDialog::showLauncher);
+        connect(ui->diagnosticsButton, &QPushButton::pressed, this, &MainDialog::showDiagnostics);
+        connect(ui->profilerButton, &QPushButton::pressed, this, &MainDialog::showProfiler);
 
         // table...
         connect(ui->mainTable, &QTableWidget::itemDoubleClicked, this, &MainDialog::editVariable);
         connect(ui->mainTable, &QTableWidget::customContextMenuRequested, this, &MainDialog::contextMenu);
+
+        // filter, compiled once typing pauses
+        filterTimer->setSingleShot(true);
+        filterTimer->setInterval(250);
+        connect(filterTimer, &QTimer::timeout, this, &MainDialog::applyFilter);
+        connect(ui->filterEdit, &QLineEdit::textChanged, [&](const QString &){ filterTimer->start(); });
+        connect(ui->filterEdit, &QLineEdit::returnPressed, this, &MainDialog::applyFilter);
+
+        // order
+        connect(ui->sortBox, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+                this, &MainDialog::applyOrder);
+        connect(ui->groupBox, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+                this, &MainDialog::applyOrder);
+        connect(ui->descendingCheck, &QCheckBox::toggled, this, &MainDialog::applyOrder);
     }
 
     void MainDialog::fillTable()
     {
-        QList<Variable> systems = variableManager->systemEnvironment();
-        QList<Variable> locals = variableManager->userEnvironment();
+        AllocationScope scope("fillTable");
+
+        EnvironmentSnapshot snapshot = variableManager->snapshot();
+
+        changeTimer->stop();
+        changedKeys.clear();
+        refillPending = false;
+
+        order.rebuild(snapshot);
+
+        int count = order.count();
+        ui->mainTable->setRowCount(count);
+
+        for (int row = 0; row < count; ++row)
+        {
+            const OrderEntry &entry = order.at(row);
+
+            Variable var;
+            snapshot.lookup(entry.name, entry.type, &var);
+            setRow(row, var, snapshot.isModified(entry.name, entry.type));
+        }
+
+        // Values are stretched and their rows sized by the delegate,
+        // only the names need measuring.
+        ui->mainTable->resizeColumnToContents(0);
+
+        applyFilter();
+    }
+
+    void MainDialog::setRow(int row, const Variable &var, bool modified)
+    {
+        QColor background = (var.type == Variable::Global) ? globalsVariablesColor : localsVariablesColor;
+
+        QTableWidgetItem* nameItem = new QTableWidgetItem(var.name);
+        nameItem->setBackground(QBrush(background));
+        nameItem->setData(Qt::UserRole, int(var.type));
+
+        if (modified)
+        {
+            QFont font = nameItem->font();
+            font.setBold(true);
+            nameItem->setFont(font);
+        }
+
+        // the delegate draws the entries, the text serves copying
+        QTableWidgetItem* valueItem = new QTableWidgetItem(ValueCodec::encode(var.value));
+        valueItem->setData(ListValueDelegate::EntriesRole, ValueCodec::entries(var.value));
+        valueItem->setBackground(QBrush(background));
+
+        ui->mainTable->setItem(row, 0, nameItem);
+        ui->mainTable->setItem(row, 1, valueItem);
+    }
+
+    void MainDialog::applyChanges()
+    {
+        changeTimer->stop();
+
+        if (refillPending)
+        {
+            fillTable();
+            return;
+        }
+
+        QSet<QString> keys;
+        keys.swap(changedKeys);
 
-            count_systems = systems.count();
-        int count_locals = locals.count();
-        ui->mainTable->setRowCount(count_locals + count_systems);
+        EnvironmentSnapshot snapshot = variableManager->snapshot();
 
-        for(int i = 0; i < count_systems; i++)
+        foreach (const QString &key, keys)
         {
-            Variable var = systems.at(i);
-            QTableWidgetItem* nameItem = new QTableWidgetItem(var.name);
-            nameItem->setBackground(QBrush(globalsVariablesColor));
+            QString name = Variable::nameOfKey(key);
+            Variable::Type type = Variable::typeOfKey(key);
+
+            int from, to;
+            order.update(snapshot, name, type, &from, &to);
+
+            if (from >= 0 && from != to)
+                ui->mainTable->removeRow(from);
+
+            if (to < 0)
+                continue;
+
+            if (from != to)
+                ui->mainTable->insertRow(to);
+
+            Variable var;
+            snapshot.lookup(name, type, &var);
+            setRow(to, var, snapshot.isModified(name, type));
+        }
 
-            QString result = var.defaultValue.toString();
-            if (var.defaultValue.type() == QMetaType::QStringList ||
-                var.defaultValue.type() == QVariant::StringList)
-                result = var.defaultValue.toStringList().join("\n");
+        // new rows are to be matched against the filter as well
+        if (!filterQuery.isEmpty())
+            filterTimer->start();
+    }
 
-            QTableWidgetItem* valueItem = new QTableWidgetItem(result);
-            valueItem->setBackground(QBrush(globalsVariablesColor));
+    void MainDialog::applyOrder()
+    {
+        Qt::SortOrder direction = ui->descendingCheck->isChecked() ? Qt::DescendingOrder : Qt::AscendingOrder;
 
-            ui->mainTable->setItem(i, 0, nameItem);
-            ui->mainTable->setItem(i, 1, valueItem);
+        order.setSorting(VariableOrder::Field(ui->sortBox->currentIndex()), direction);
+        order.setGrouping(VariableOrder::Grouping(ui->groupBox->currentIndex()));
+        fillTable();
+    }
+
+    void MainDialog::applyFilter()
+    {
+        filterTimer->stop();
+
+        VariableQuery query;
+        if (!query.compile(ui->filterEdit->text()))
+        {
+            // keep the last good filter while the text is being fixed
+            ui->filterEdit->setStyleSheet("color: red");
+            ui->filterEdit->setToolTip(query.errorString());
+            return;
         }
 
-        for (int i = 0; i < count_locals; ++i)
+        ui->filterEdit->setStyleSheet(QString());
+        ui->filterEdit->setToolTip(QString());
+        filterQuery = query;
+
+        int count = ui->mainTable->rowCount();
+        if (filterQuery.isEmpty())
         {
-            Variable var = locals.at(i);
-            QTableWidgetItem* nameItem = new QTableWidgetItem(var.name);
-            nameItem->setBackground(QBrush(localsVariablesColor));
+            for (int row = 0; row < count; ++row)
+                ui->mainTable->setRowHidden(row, false);
+
+            ui->filterStatus->clear();
+            return;
+        }
 
-            QString result = var.defaultValue.toString();
-            if (var.defaultValue.type() == QMetaType::QStringList ||
-                var.defaultValue.type() == QVariant::StringList)
-                result = var.defaultValue.toStringList().join("\n");
+        QueryResult result = filterQuery.select(variableManager->snapshot());
 
-            QTableWidgetItem* valueItem = new QTableWidgetItem(result);
-            valueItem->setBackground(QBrush(localsVariablesColor));
+        QSet<QString> selected;
+        foreach (const Variable &var, result.variables)
+            selected.insert(Variable::key(var.name, var.type));
 
-            ui->mainTable->setItem(i + count_systems, 0, nameItem);
-            ui->mainTable->setItem(i + count_systems, 1, valueItem);
+        for (int row = 0; row < count; ++row)
+        {
+            QTableWidgetItem* nameItem = ui->mainTable->item(row, 0);
+            Variable::Type type = Variable::Type(nameItem->data(Qt::UserRole).toInt());
+            ui->mainTable->setRowHidden(row, !selected.contains(Variable::key(nameItem->text(), type)));
         }
 
-        ui->mainTable->resizeColumnsToContents();
-        ui->mainTable->resizeRowsToContents();
+        ui->filterStatus->setText(QString("%1 of %2 variables, %3 entries")
+                                  .arg(result.variables.count()).arg(count).arg(result.entries));
+    }
+
+    Variable MainDialog::rowVariable(const EnvironmentSnapshot &snapshot, int row) const
+    {
+        QTableWidgetItem* nameItem = ui->mainTable->item(row, 0);
+
+        Variable var;
+        var.name = nameItem->text();
+        var.type = Variable::Type(nameItem->data(Qt::UserRole).toInt());
+        snapshot.lookup(var.name, var.type, &var);
+        return var;
+    }
+
+    VariableDialog* MainDialog::variableEditor()
+    {
+        // built on first use, it is not needed to show the window
+        if (!variableDialog)
+            variableDialog = new VariableDialog(this);
+        return variableDialog;
+    }
+
+    EffectiveEnvironment* MainDialog::mergedEnvironment()
+    {
+        if (!effectiveEnvironment)
+            effectiveEnvironment = new EffectiveEnvironment(variableManager, this);
+        return effectiveEnvironment;
     }
 
     void MainDialog::resetTable()
     {
-        for (int row = 0; row < ui->mainTable->rowCount(); ++row)
+        // Dropping the edits brings back the loaded environment
+        // (and the table, on environmentReset).
+        variableManager->reset();
+    }
+
+    void MainDialog::showEffectiveEnvironment()
+    {
+        if (!effectiveDialog)
+            effectiveDialog = new EffectiveEnvironmentDialog(mergedEnvironment(), this);
+
+        effectiveDialog->show();
+        effectiveDialog->raise();
+    }
+
+    void MainDialog::showProcessEnvironments()
+    {
+        if (!processDialog)
         {
-            QString variableName = ui->mainTable->item(row, 0)->text();
-            Variable var = variableManager->variable(variableName);
+            processDialog = new ProcessScanDialog(mergedEnvironment(), this);
+            processDialog->scan();
+        }
 
-            qDebug() << var.defaultName << var.name << var.defaultValue << var.value;
+        processDialog->show();
+        processDialog->raise();
+    }
 
-            if (var.defaultName.isEmpty())
-            {   // non-existing variable, remove.
-                ui->mainTable->removeRow(row);
-                continue;
-            }
+    void MainDialog::showLauncher()
+    {
+        if (!launchDialog)
+        {
+            launcher = new ProcessLauncher(mergedEnvironment(), this);
+            launchDialog = new LaunchDialog(launcher, this);
+        }
 
-            if (var.defaultName != var.name)
-            {   // restore default name
-                ui->mainTable->item(row, 0)->setText(var.defaultName);
-            }
+        launchDialog->show();
+        launchDialog->raise();
+    }
 
-            if (var.defaultValue != var.value)
-            {   // restore default values.
-                QString result = ((var.defaultValue.type() == QVariant::StringList) ?
-                                      var.defaultValue.toStringList().join("\n") :
-                                      var.defaultValue.toString());
-                ui->mainTable->item(row, 1)->setText(result);
-            }
+    void MainDialog::showDiagnostics()
+    {
+        if (!allocationDialog)
+            allocationDialog = new AllocationDialog(this);
+
+        allocationDialog->refresh();
+        allocationDialog->show();
+        allocationDialog->raise();
+    }
 
+    void MainDialog::showProfiler()
+    {
+        if (!profilerDialog)
+        {
+            sizeProfiler = new SizeProfiler(variableManager, this);
+            profilerDialog = new ProfilerDialog(sizeProfiler, this);
         }
+
+        profilerDialog->refresh();
+        profilerDialog->show();
+        profilerDialog->raise();
     }
 
     void MainDialog::contextMenu()
@@ -179,7 +407,7 @@ namespace EnvironmentExplorer
 
     void MainDialog::addVariable()
     {
-         variableDialog->setDialogMode(VariableDialog::AddVariable);
+         variableEditor()->setDialogMode(VariableDialog::AddVariable);
          int result = variableDialog->exec();
 
          if (result == QDialog::Accepted)
@@ -188,40 +416,28 @@ namespace EnvironmentExplorer
              QVariant val = variableDialog->variableValue();
              Variable::Type type = variableDialog->variableType();
 
-             QString str;
-             if (val.type() == QMetaType::QString)
-                 str = val.toString();
-             if (val.type() == QMetaType::QStringList)
-                 str = val.toStringList().join("\n");
-
-             QColor background = (type == Variable::Global) ? globalsVariablesColor : localsVariablesColor;
-
-             QTableWidgetItem* nameItem = new QTableWidgetItem(name);
-             nameItem->setBackground(QBrush(background));
-             QTableWidgetItem* valueItem = new QTableWidgetItem(str);
-             valueItem->setBackground(QBrush(background));
-
-             ui->mainTable->setRowCount(ui->mainTable->rowCount()+1);
-
-             int row = (type == Variable::Global) ? count_systems : ui->mainTable->rowCount();
-
-             ui->mainTable->insertRow(row);
-             ui->mainTable->setItem(row, 0, nameItem);
-             ui->mainTable->setItem(row, 1, valueItem);
-
+             // the row is put in its place on variableChanged
              if (type == Variable::Global)
                  variableManager->addGlobalVariable(name, val);
              else
                  variableManager->addUserVariable(name, val);
+
+             applyChanges();
+
+             int row = order.indexOf(name, type);
+             if (row >= 0)
+                 ui->mainTable->scrollToItem(ui->mainTable->item(row, 0));
          }
     }
 
     void MainDialog::editVariable(QTableWidgetItem* item)
     {
         QString oldName = ui->mainTable->item(item->row(), 0)->text();
-        variableDialog->setDialogMode(VariableDialog::EditVariable);
+        Variable oldVariable = rowVariable(variableManager->snapshot(), item->row());
+
+        variableEditor()->setDialogMode(VariableDialog::EditVariable);
         variableDialog->setVariableName(oldName);
-        variableDialog->setVariableValue(ui->mainTable->item(item->row(), 1)->text());
+        variableDialog->setVariableValue(ValueCodec::entries(oldVariable.value).join("\n"));
 
         int result = variableDialog->exec();
         if (result == QDialog::Accepted)
@@ -229,27 +445,15 @@ namespace EnvironmentExplorer
             QString name = variableDialog->variableName();
             QVariant val = variableDialog->variableValue();
 
-            QString str;
-            if (val.type() == QMetaType::QString)
-                str = val.toString();
-            if (val.type() == QMetaType::QStringList)
-                str = val.toStringList().join("\n");
-
-            ui->mainTable->item(item->row(), 0)->setText(name);
-            ui->mainTable->item(item->row(), 1)->setText(str);
-            ui->mainTable->resizeRowToContents(item->row());
-            ui->mainTable->resizeColumnToContents(0);
-            ui->mainTable->resizeColumnToContents(1);
-
             // reset variable
             Variable var;
             var.name = name;
             var.value = val;
+            var.type = oldVariable.type;
+            var.expandable = oldVariable.expandable;
 
-            Variable oldVariable = variableManager->variable(oldName);
-            variableManager->removeVariable(oldName); // We can not have a duplicate.
-            var.defaultName = oldVariable.defaultName;
-            var.defaultValue = oldVariable.defaultValue;
+            if (name != oldName) // We can not have a duplicate.
+                variableManager->removeVariable(oldName, oldVariable.type);
 
             variableManager->addVariable(var);
         }
@@ -257,115 +461,150 @@ namespace EnvironmentExplorer
 
     void MainDialog::removeVariable()
     {
-        QList<QTableWidgetItem*> selection = ui->mainTable->selectedItems();
-        QTableWidgetItem* nameItem = selection.at(0);
+        QModelIndexList selection = ui->mainTable->selectionModel()->selectedRows();
+        if (selection.isEmpty())
+            return;
+
+        EnvironmentSnapshot snapshot = variableManager->snapshot();
+
+        QList<ReplaceChange> changes;
+        foreach (const QModelIndex &index, selection)
+        {
+            ReplaceChange change;
+            change.before = change.after = rowVariable(snapshot, index.row());
+            change.after.value = QVariant(); // removed
+            changes.append(change);
+        }
 
-        variableManager->removeVariable(nameItem->text());
-        ui->mainTable->removeRow(ui->mainTable->row(nameItem));
+        undoStack->push(new BatchEditCommand(variableManager, changes,
+                                             QString("Remove %1 variable(s)").arg(changes.count())));
     }
 
-    void MainDialog::saveEnvironment()
-    { variableManager->saveVariables(); }
+    void MainDialog::replaceValues()
+    {
+        ReplaceDialog dialog(variableManager, this);
 
-    void MainDialog::exportEnvironment()
+        if (dialog.exec() != QDialog::Accepted || dialog.changes().isEmpty())
+            return;
+
+        undoStack->push(new BatchEditCommand(variableManager, dialog.changes(), QString("Replace in values")));
+    }
+
+    void MainDialog::showProfiles()
     {
-        QString filterType;
-        QString fileName = QFileDialog::getSaveFileName(0, "Save to file...", QString(),
-                                     QString("HTML (*.html);;Text file (*.log)"),
-                                     &filterType);
+        ProfilesDialog dialog(variableManager, this);
 
-        if (fileName.isEmpty() && filterType.isEmpty())
+        if (dialog.exec() != QDialog::Accepted || dialog.changes().isEmpty())
             return;
-        else
-        {
-            if (filterType == "Text file (*.log)")
-               exportPlainText(fileName);
-            else
-               exportHtml(fileName);
-        }
+
+        undoStack->push(new BatchEditCommand(variableManager, dialog.changes(), QString("Apply profile")));
     }
 
-    void MainDialog::exportHtml(const QString &file)
+    void MainDialog::saveEnvironment()
     {
-        QString escapedName;
-        if (!file.endsWith(".html") && file.contains("."))
+        QList<MergeConflict> conflicts;
+
+        if (!variableManager->saveVariables(&conflicts))
         {
-            QString nakedName = file.left(file.lastIndexOf(".") - 1); // excluding dot
-            escapedName = nakedName.append(".html");
+            MergeDialog dialog(conflicts, this);
+            if (dialog.exec() != QDialog::Accepted)
+                return;
+
+            variableManager->resolveConflicts(dialog.resolutions());
+
+            if (!variableManager->saveVariables(&conflicts))
+                QMessageBox::warning(this, QString("Save"),
+                                     QString("The registry changed again, nothing was saved."));
         }
 
-        QFile fileHandle(escapedName);
+        // others' changes come in with the saved environment
+        // (environmentReset fills the table again)
+    }
 
-        if (!fileHandle.open(QFile::WriteOnly|QFile::Text))
-            QMessageBox::critical(0, QString("Error"),
-                                  QString("Error occured:").append(fileHandle.errorString())
-                                  .append("Canceling export."));
-        else
-        {
-            QFile f("://template.html");
-            f.open(QFile::ReadOnly);
+    void MainDialog::exportEnvironment()
+    {
+        ExportDialog dialog(this);
+        if (dialog.exec() != QDialog::Accepted || dialog.formats().isEmpty())
+            return;
 
-            QString templateFile = f.readAll();
-            QString timestamp = QTime::currentTime().toString();
+        wchar_t ch_user[128];
+        DWORD d = 128;
+        GetComputerNameW(ch_user, &d); // WinAPI
 
-            wchar_t ch_user[128];
-            DWORD d = 128;
-            GetComputerNameW(ch_user, &d); // WinAPI
+        ExportPipeline pipeline(QString::fromWCharArray(ch_user, d), QTime::currentTime().toString());
+        foreach (ExportPipeline::Format format, dialog.formats())
+            pipeline.addTarget(format, ExportPipeline::fileName(dialog.baseName(), format));
 
-            QString compName = QString::fromWCharArray(ch_user, d);
+        // one walk over the visible rows for all formats
+        EnvironmentSnapshot snapshot = variableManager->snapshot();
+        int row = 0;
 
-            QString tmpStr("");
-            for (int row = 0; row < ui->mainTable->rowCount(); ++row)
-            {
-                QString name = ui->mainTable->item(row, 0)->text();
-                QString val = ui->mainTable->item(row, 1)->text();
-                tmpStr.append("           <tr>\r\n                <td>");
-                tmpStr.append(name).append("</td>\r\n                <td>\r\n");
+        bool written = pipeline.run([&](Variable* var){
+            while (row < ui->mainTable->rowCount() && ui->mainTable->isRowHidden(row))
+                ++row;
 
-                QStringList list = (val.contains("\n")) ? val.split("\n") : QStringList(val);
-                foreach(QString value, list) tmpStr.append("             " + value + "<br>\r\n");
+            if (row == ui->mainTable->rowCount())
+                return false;
 
-                tmpStr.append("           </tr>\r\n");
-            }
+            *var = rowVariable(snapshot, row++);
+            return true;
+        });
 
-            fileHandle.write(templateFile.arg(compName, timestamp, tmpStr).toStdString().c_str());
-            fileHandle.close();
-        }
+        if (!written)
+            QMessageBox::critical(0, QString("Error"),
+                                  QString("Error occured:\n").append(pipeline.errorString()));
     }
 
-    void MainDialog::exportPlainText(const QString &file)
+    void MainDialog::importEnvironment()
     {
-        QString escapedName;
-        if (!file.endsWith(".log") && file.contains("."))
-        {
-            QString nakedName = file.left(file.lastIndexOf(".") - 1); // excluding dot
-            escapedName = nakedName.append(".log");
-        }
+        QString fileName = QFileDialog::getOpenFileName(this, "Import from file...", QString(),
+                                     QString("Environment (*.env *.sh *.reg);;All files (*)"));
+        if (fileName.isEmpty())
+            return;
 
-        QFile fileHandle(escapedName);
+        EnvironmentImporter importer;
+        importer.setFormat(EnvironmentImporter::detectFormat(fileName));
 
-        if (!fileHandle.open(QFile::WriteOnly|QFile::Text))
-            QMessageBox::critical(0, QString("Error"),
-                                  QString("Error occured:").append(fileHandle.errorString())
-                                  .append("Canceling export."));
-        else
+        // .reg files carry the scope in the key name.
+        if (EnvironmentImporter::detectFormat(fileName) != EnvironmentImporter::Registry)
         {
-            for (int row = 0; row < ui->mainTable->rowCount(); ++row)
-            {
-                QString name = ui->mainTable->item(row, 0)->text();
-                QString val = ui->mainTable->item(row, 1)->text();
-
-                QStringList list = (val.contains("\n")) ? val.split("\n") : QStringList(val);
-                fileHandle.write(QString("Name: %1 \r\n").arg(name).toStdString().c_str());
-                fileHandle.write("Value(s):\r\n");
-
-                foreach(QString value, list)
-                    fileHandle.write(QString("       %1\r\n").arg(value).toStdString().c_str());
-
-                fileHandle.write("-----------------------------------------------\r\n");
-            }
-            fileHandle.close();
+            bool ok = false;
+            QString scope = QInputDialog::getItem(this, "Import", "Scope:",
+                                                  QStringList() << "Local (User)" << "Global (System)",
+                                                  0, false, &ok);
+            if (!ok)
+                return;
+
+            importer.setScope((scope == "Global (System)") ? Variable::Global : Variable::User);
         }
+
+        QProgressDialog progress("Importing variables...", QString(), 0, 1000, this);
+        progress.setWindowModality(Qt::WindowModal);
+        progress.setMinimumDuration(500);
+
+        // The file is read on a worker thread. Batches are applied here
+        // while the reader waits, so only one batch is held at a time.
+        connect(&importer, &EnvironmentImporter::batchReady, variableManager,
+                &VariablesManager::addVariables, Qt::BlockingQueuedConnection);
+        connect(&importer, &EnvironmentImporter::progress, &progress, [&](qint64 done, qint64 total){
+            progress.setValue(total ? int(done * 1000 / total) : 1000);
+        });
+
+        // the table follows once, at the end
+        changesHeld = true;
+
+        QEventLoop loop;
+        QFutureWatcher<bool> watcher;
+        connect(&watcher, &QFutureWatcher<bool>::finished, &loop, &QEventLoop::quit);
+        watcher.setFuture(QtConcurrent::run(&importer, &EnvironmentImporter::importFile, fileName));
+        loop.exec(QEventLoop::ExcludeUserInputEvents);
+
+        changesHeld = false;
+        applyChanges();
+
+        if (!watcher.result())
+            QMessageBox::critical(this, QString("Error"),
+                                  QString("Error occured:").append(importer.errorString())
+                                  .append("Canceling import."));
     }
 }
-
@@ -11,13 +11,29 @@
 
 #include <QtWidgets/QWidget>
 
+#include "EnvironmentSnapshot.h"
+#include "VariableQuery.h"
+#include "VariableOrder.h"
+
+#include <QSet>
+
 class QTableWidgetItem;
+class QUndoStack;
+class QTimer;
 
 namespace EnvironmentExplorer
 {
     struct UserInterface;
     class VariablesManager;
     class VariableDialog;
+    class EffectiveEnvironment;
+    class EffectiveEnvironmentDialog;
+    class ProcessScanDialog;
+    class AllocationDialog;
+    class ProcessLauncher;
+    class LaunchDialog;
+    class SizeProfiler;
+    class ProfilerDialog;
 
     // Main window.
     class MainDialog : public QWidget
@@ -33,7 +49,41 @@ namespace EnvironmentExplorer
         // Dialog
         VariableDialog* variableDialog;
 
-        int count_systems;
+        // Merged system + user view
+        EffectiveEnvironment* effectiveEnvironment;
+        EffectiveEnvironmentDialog* effectiveDialog;
+
+        // Running processes view
+        ProcessScanDialog* processDialog;
+
+        // Row order, kept up to date change by change.
+        VariableOrder order;
+
+        // Changed variables (Variable::key()), applied together
+        // once control returns to the event loop. Past a threshold
+        // the table is filled again instead and no keys are kept.
+        QSet<QString> changedKeys;
+        bool refillPending;
+        bool changesHeld;       // while importing
+        QTimer* changeTimer;
+
+        // Runs commands with the unsaved environment
+        ProcessLauncher* launcher;
+        LaunchDialog* launchDialog;
+
+        // Batch edits (replace, remove), undoable as a whole.
+        QUndoStack* undoStack;
+
+        // Rows not matching the query are hidden (and not exported).
+        VariableQuery filterQuery;
+        QTimer* filterTimer;
+
+        // Allocation counters (CONFIG+=alloc_tracking builds)
+        AllocationDialog* allocationDialog;
+
+        // Sizes and edit counts, followed from the first use on
+        SizeProfiler* sizeProfiler;
+        ProfilerDialog* profilerDialog;
 
     public:
             MainDialog(QWidget *parent = 0);
@@ -42,6 +92,14 @@ namespace EnvironmentExplorer
     protected:
             void initConnections();
             void fillTable();
+            void setRow(int row, const Variable &var, bool modified);
+
+            // Created on first use.
+            VariableDialog* variableEditor();
+            EffectiveEnvironment* mergedEnvironment();
+
+            // Variable shown in the row, as of the snapshot.
+            Variable rowVariable(const EnvironmentSnapshot &snapshot, int row) const;
 
     protected slots:
             void contextMenu();
@@ -49,12 +107,20 @@ namespace EnvironmentExplorer
             void addVariable();
             void editVariable(QTableWidgetItem* item);
             void removeVariable();
+            void replaceValues();
+            void showProfiles();
             void saveEnvironment();
             void exportEnvironment();
+            void importEnvironment();
             void resetTable();
-
-            void exportPlainText(const QString &file);
-            void exportHtml(const QString &file);
+            void showEffectiveEnvironment();
+            void showProcessEnvironments();
+            void showLauncher();
+            void applyFilter();
+            void applyChanges();
+            void applyOrder();
+            void showDiagnostics();
+            void showProfiler();
 
     };
 }
@@ -8,15 +8,20 @@
 */
 
 #include "MainDialogUi.h"
+#include "ValueCodec.h"
 
 #include <QRegExpValidator>
+#include <QApplication>
 #include <QKeyEvent>
+#include <QClipboard>
 #include <QRegExp>
-#include <QDebug>
+#include <QFile>
+
+#include <QtConcurrent/QtConcurrentRun>
 
 namespace EnvironmentExplorer
 {
-    bool DeleteKeyEventFilter::eventFilter(QObject *obj, QEvent *e)
+    bool ListKeyEventFilter::eventFilter(QObject *obj, QEvent *e)
     {
         if (e->type() == QEvent::KeyPress) {
             QKeyEvent* event = dynamic_cast<QKeyEvent*>(e);
@@ -24,6 +29,10 @@ namespace EnvironmentExplorer
                 emit deleteKeyPressed();
                 return true;
             }
+            if (event->matches(QKeySequence::Paste)) {
+                emit pasteKeyPressed();
+                return true;
+            }
         }
         return obj->eventFilter(obj,e);
     }
@@ -43,26 +52,16 @@ namespace EnvironmentExplorer
 
         nameLabel = new QLabel("Name:");
         nameLabel->setBuddy(nameEdit);
-        connect(nameEdit, &QLineEdit::textChanged, [&](const QString &text){
-            if (text.trimmed().isEmpty() ||
-                text.contains(" ") ||
-                valueEdit->text().isEmpty())
-                addButton->setDisabled(true);
-            else
-                addButton->setDisabled(false);
+        connect(nameEdit, &QLineEdit::textChanged, [&](const QString &){
+            updateAddButton();
         });
 
         valueEdit = new QLineEdit();
         valueLabel = new QLabel("Value:");
         valueLabel->setBuddy(valueEdit);
 
-        connect(valueEdit, &QLineEdit::textChanged, [&](const QString &text) {
-            if (text.trimmed().isEmpty() ||
-                text.contains(" ") ||
-                nameEdit->text().isEmpty())
-                addButton->setDisabled(true);
-            else
-                addButton->setDisabled(false);
+        connect(valueEdit, &QLineEdit::textChanged, [&](const QString &) {
+            updateAddButton();
         });
 
         scopeLabel = new QLabel("Scope:");
@@ -85,56 +84,42 @@ namespace EnvironmentExplorer
                 valueEdit->show();
                 resize(sizeHint());
             }
+            updateAddButton();
         });
 
-        itemsList = new QListWidget();
-        DeleteKeyEventFilter* filter = new DeleteKeyEventFilter();
-        itemsList->installEventFilter(filter);
-        itemsList->setEditTriggers(QListWidget::DoubleClicked);
+        // Entries are kept in a flat model; uniform item sizes spare
+        // the view from measuring each row of long PATH-like lists.
+        itemsModel = new ValueListModel(this);
+        itemsList = new QListView();
+        itemsList->setModel(itemsModel);
+        itemsList->setUniformItemSizes(true);
+        itemsList->setSelectionMode(QListView::ExtendedSelection);
+        itemsList->setEditTriggers(QListView::DoubleClicked);
 
-        QListWidgetItem* addValueItem = new QListWidgetItem(itemsList);
-        addValueItem->setText("Add new value...");
-        addValueItem->setFlags(Qt::ItemIsEnabled|Qt::ItemIsSelectable);
-
-        connect(filter, &DeleteKeyEventFilter::deleteKeyPressed, [&](){
-            QList<QListWidgetItem*> selection = itemsList->selectedItems();
+        ListKeyEventFilter* filter = new ListKeyEventFilter(this);
+        itemsList->installEventFilter(filter);
 
-            foreach (QListWidgetItem* item, selection)
-            {
-               delete item;
-            }
+        connect(filter, &ListKeyEventFilter::deleteKeyPressed, [&](){
+            itemsModel->removeEntries(itemsList->selectionModel()->selectedIndexes());
+        });
 
+        connect(filter, &ListKeyEventFilter::pasteKeyPressed, [&](){
+            pasteEntries();
         });
 
-        connect(itemsList, &QListWidget::itemDoubleClicked,
-            [&](QListWidgetItem* item){
-                if (item == itemsList->item(itemsList->count()-1)) {
-                    QListWidgetItem* newItem = new QListWidgetItem();
-                    newItem->setFlags(newItem->flags() | Qt::ItemIsEditable);
-                    itemsList->insertItem(itemsList->count() - 1, newItem);
+        connect(itemsList, &QListView::doubleClicked,
+            [&](const QModelIndex &index){
+                if (itemsModel->isPlaceholder(index)) {
+                    int row = index.row();
+                    itemsModel->insertEntries(row, QStringList(QString()));
+                    itemsList->edit(itemsModel->index(row));
                 }
             });
 
-        connect(itemsList->model(), &QAbstractItemModel::rowsInserted,
-           [&](const QModelIndex &/*parent*/, int /*first*/, int /*last*/)
-                {
-                    int count = itemsList->count();
-                    bool valsAreEmpty = true;
-
-                    for (int i = 0; i < count-1; i++)
-                    {
-                        QString val = itemsList->item(i)->text();
-                        qDebug() << val;
-                        if (!val.trimmed().isEmpty())
-                            { valsAreEmpty = false; break; }
-                    }
-
-                    if (count > 1 && !valsAreEmpty)
-                        addButton->setDisabled(false);
-                    else
-                        addButton->setDisabled(true);
-
-                });
+        connect(itemsModel, &ValueListModel::nonEmptyCountChanged,
+           [&](int /*count*/) {
+                updateAddButton();
+           });
 
         dialogButtonBox = new QDialogButtonBox();
         addButton = dialogButtonBox->addButton("Add", QDialogButtonBox::AcceptRole);
@@ -161,12 +146,7 @@ namespace EnvironmentExplorer
             QString val = value.toString();
             if (val.contains("\n"))
             {
-                QStringList list = val.split("\n");
-                foreach(QString item, list) {
-                    QListWidgetItem* listItem = new QListWidgetItem(item);
-                    listItem->setFlags(listItem->flags() | Qt::ItemIsEditable);
-                     itemsList->insertItem(itemsList->count() - 1, listItem);
-                }
+                itemsModel->setEntries(val.split("\n"));
 
                 multipleValuesCheck->setChecked(true);
                 addButton->setDisabled(((val.isEmpty()) ? true : false));
@@ -184,9 +164,7 @@ namespace EnvironmentExplorer
     {
         dialogMode = mode;
 
-        itemsList->clear();
-        QListWidgetItem* item = new QListWidgetItem("Add new item...", itemsList);
-        itemsList->addItem(item);
+        itemsModel->setEntries(QStringList());
 
         if (mode == AddVariable)
         {
@@ -206,13 +184,39 @@ namespace EnvironmentExplorer
         if (!multipleValuesCheck->isChecked())
             return QVariant(valueEdit->text());
         else
-        {
-            QStringList list;
-            for (int i = 0; i < itemsList->count(); ++i)
-                list.append(itemsList->item(i)->text());
+            return QVariant(itemsModel->entries());
+    }
 
-            return QVariant(list);
-        }
+    void VariableDialog::pasteEntries()
+    {
+        QString text = QApplication::clipboard()->text();
+        if (text.isEmpty())
+            return;
+
+        text.replace("\r\n", "\n");
+        QStringList list = text.split("\n");
+        if (list.last().isEmpty())
+            list.removeLast();
+
+        // Paste before the current entry, or append when nothing is selected.
+        QModelIndex current = itemsList->currentIndex();
+        int row = current.isValid() ? current.row() : itemsModel->entries().count();
+
+        itemsModel->insertEntries(row, list);
+    }
+
+    void VariableDialog::updateAddButton()
+    {
+        QString name = nameEdit->text();
+        bool valid = !name.trimmed().isEmpty() && !name.contains(" ");
+
+        if (multipleValuesCheck->isChecked())
+            valid = valid && itemsModel->nonEmptyCount() > 0;
+        else
+            valid = valid && !valueEdit->text().trimmed().isEmpty() &&
+                    !valueEdit->text().contains(" ");
+
+        addButton->setDisabled(!valid);
     }
 
     Variable::Type VariableDialog::variableType()
@@ -230,4 +234,902 @@ namespace EnvironmentExplorer
         else
             scopeBox->setCurrentIndex(1);
     }
+
+    EffectiveEnvironmentDialog::EffectiveEnvironmentDialog(EffectiveEnvironment* environment,
+                                                           QWidget* parent)
+        : QDialog(parent), environment(environment)
+    {
+        setWindowTitle("Effective environment");
+        resize(750, 500);
+
+        QVBoxLayout* layout = new QVBoxLayout(this);
+
+        table = new QTableWidget(0, 3);
+        table->setEditTriggers(QTableWidget::NoEditTriggers);
+        table->setHorizontalHeaderLabels(QStringList() << "Name" << "Scope" << "Value");
+        table->horizontalHeader()->setStretchLastSection(true);
+        table->setSelectionBehavior(QAbstractItemView::SelectRows);
+        table->verticalHeader()->hide();
+        layout->addWidget(table);
+
+        expandCheck = new QCheckBox("Expand references");
+        expandCheck->setChecked(environment->expandReferences());
+        connect(expandCheck, &QCheckBox::toggled, environment, &EffectiveEnvironment::setExpandReferences);
+        layout->addWidget(expandCheck);
+
+        buttonBox = new QDialogButtonBox();
+        exportButton = buttonBox->addButton(QString("Export"), QDialogButtonBox::ActionRole);
+        buttonBox->addButton(QDialogButtonBox::Close);
+        connect(exportButton, &QPushButton::pressed, [&](){ exportEnvironment(); });
+        connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::close);
+        layout->addWidget(buttonBox);
+
+        connect(environment, &EffectiveEnvironment::rebuilt, [&](){ fillTable(); });
+        connect(environment, &EffectiveEnvironment::variableChanged,
+                [&](const QString &key){ updateRow(key); });
+
+        fillTable();
+    }
+
+    void EffectiveEnvironmentDialog::fillTable()
+    {
+        QList<EffectiveVariable> variables = environment->variables();
+
+        rows.clear();
+        table->setRowCount(variables.count());
+
+        for (int row = 0; row < variables.count(); ++row)
+        {
+            const EffectiveVariable &var = variables.at(row);
+            rows.insert(var.name.toUpper(), row);
+
+            table->setItem(row, 0, new QTableWidgetItem());
+            table->setItem(row, 1, new QTableWidgetItem());
+            table->setItem(row, 2, new QTableWidgetItem());
+            setRow(row, var);
+        }
+
+        table->resizeColumnToContents(0);
+        table->resizeColumnToContents(1);
+    }
+
+    void EffectiveEnvironmentDialog::updateRow(const QString &key)
+    {
+        QHash<QString, int>::const_iterator it = rows.constFind(key);
+
+        // Added or removed variables shift rows, start over.
+        if (it == rows.constEnd() || !environment->contains(key))
+        {
+            fillTable();
+            return;
+        }
+
+        setRow(it.value(), environment->variable(key));
+    }
+
+    void EffectiveEnvironmentDialog::setRow(int row, const EffectiveVariable &var)
+    {
+        QString scope;
+        if (var.fromSystem && var.fromUser)
+            scope = EffectiveEnvironment::isAppended(var.name.toUpper()) ? "System + User" : "User";
+        else
+            scope = var.fromUser ? "User" : "System";
+
+        table->item(row, 0)->setText(var.name);
+        table->item(row, 1)->setText(scope);
+        table->item(row, 2)->setText(var.expandedValue);
+    }
+
+    void EffectiveEnvironmentDialog::exportEnvironment()
+    {
+        QString fileName = QFileDialog::getSaveFileName(this, "Save to file...", QString(),
+                                                        QString("Environment file (*.env)"));
+        if (fileName.isEmpty())
+            return;
+
+        QFile fileHandle(fileName);
+
+        if (!fileHandle.open(QFile::WriteOnly|QFile::Text))
+            QMessageBox::critical(this, QString("Error"),
+                                  QString("Error occured:").append(fileHandle.errorString())
+                                  .append("Canceling export."));
+        else
+        {
+            foreach (const EffectiveVariable &var, environment->variables())
+                fileHandle.write(QString("%1=%2\r\n").arg(var.name, var.expandedValue).toUtf8());
+
+            fileHandle.close();
+        }
+    }
+
+    ProcessScanDialog::ProcessScanDialog(EffectiveEnvironment* environment,
+                                         QWidget* parent)
+        : QDialog(parent), environment(environment)
+    {
+        setWindowTitle("Process environments");
+        resize(750, 500);
+
+        result.processCount = result.deniedCount = 0;
+        result.elapsed = 0;
+
+        QVBoxLayout* layout = new QVBoxLayout(this);
+
+        tree = new QTreeWidget();
+        tree->setColumnCount(3);
+        tree->setHeaderLabels(QStringList() << "Variable / Value" << "Processes" << "Configured");
+        tree->setUniformRowHeights(true);
+        layout->addWidget(tree);
+
+        differingCheck = new QCheckBox("Only values differing from the configuration");
+        layout->addWidget(differingCheck);
+
+        statusLabel = new QLabel();
+        layout->addWidget(statusLabel);
+
+        QDialogButtonBox* buttonBox = new QDialogButtonBox();
+        scanButton = buttonBox->addButton(QString("Scan"), QDialogButtonBox::ActionRole);
+        buttonBox->addButton(QDialogButtonBox::Close);
+        layout->addWidget(buttonBox);
+
+        connect(scanButton, &QPushButton::pressed, [&](){ scan(); });
+        connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::close);
+        connect(differingCheck, &QCheckBox::toggled, [&](bool){ fillTree(); });
+        connect(tree, &QTreeWidget::itemExpanded, [&](QTreeWidgetItem* item){ expandItem(item); });
+
+        connect(&watcher, &QFutureWatcher<ProcessScanResult>::finished, [&](){
+            result = watcher.result();
+            scanButton->setEnabled(true);
+            fillTree();
+        });
+    }
+
+    void ProcessScanDialog::scan()
+    {
+        if (watcher.isRunning())
+            return;
+
+        scanButton->setEnabled(false);
+        statusLabel->setText("Scanning...");
+        watcher.setFuture(QtConcurrent::run(&ProcessScanner::scan));
+    }
+
+    void ProcessScanDialog::fillTree()
+    {
+        tree->clear();
+
+        bool onlyDiffering = differingCheck->isChecked();
+        int stale = 0;
+
+        QList<QTreeWidgetItem*> items;
+        for (int i = 0; i < result.variables.count(); ++i)
+        {
+            const ProcessVariable &var = result.variables.at(i);
+
+            bool configured = environment->contains(var.name);
+            QString expected = environment->variable(var.name).expandedValue;
+
+            int differing = 0;
+            QList<QTreeWidgetItem*> children;
+
+            for (int j = 0; j < var.values.count(); ++j)
+            {
+                const ProcessVariableValue &val = var.values.at(j);
+                bool matches = configured && val.value == expected;
+
+                if (configured && !matches)
+                    differing += val.pids.count();
+
+                if (onlyDiffering && (!configured || matches))
+                    continue;
+
+                QTreeWidgetItem* child = new QTreeWidgetItem();
+                child->setText(0, val.value);
+                child->setText(1, QString::number(val.pids.count()));
+                child->setText(2, configured ? (matches ? "matches" : "differs") : QString());
+                child->setData(0, VariableRole, i);
+                child->setData(0, ValueRole, j);
+                child->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+                children.append(child);
+            }
+
+            if (differing)
+                ++stale;
+
+            if (children.isEmpty())
+                continue;
+
+            QTreeWidgetItem* item = new QTreeWidgetItem();
+            item->setText(0, var.name);
+            item->setText(1, QString::number(var.processCount()));
+
+            if (!configured)
+                item->setText(2, "not configured");
+            else if (differing)
+                item->setText(2, QString("%1 differ").arg(differing));
+            else
+                item->setText(2, "matches");
+
+            item->addChildren(children);
+            items.append(item);
+        }
+
+        tree->addTopLevelItems(items);
+        tree->resizeColumnToContents(1);
+
+        statusLabel->setText(QString("%1 processes read, %2 not accessible, %3 variables differ (%4 ms)")
+                             .arg(result.processCount).arg(result.deniedCount)
+                             .arg(stale).arg(result.elapsed));
+    }
+
+    void ProcessScanDialog::expandItem(QTreeWidgetItem* item)
+    {
+        // PIDs are only materialized when a value is opened.
+        if (!item->parent() || item->childCount() > 0)
+            return;
+
+        int var = item->data(0, VariableRole).toInt();
+        int val = item->data(0, ValueRole).toInt();
+
+        QList<QTreeWidgetItem*> pids;
+        foreach (qint64 pid, result.variables.at(var).values.at(val).pids)
+            pids.append(new QTreeWidgetItem(QStringList() << QString("PID %1").arg(pid)));
+
+        item->addChildren(pids);
+    }
+
+    ReplaceDialog::ReplaceDialog(VariablesManager* manager, QWidget* parent)
+        : QDialog(parent), manager(manager)
+    {
+        setWindowTitle("Replace in values...");
+        resize(700, 450);
+
+        QGridLayout* layout = new QGridLayout(this);
+
+        findEdit = new QLineEdit();
+        replaceEdit = new QLineEdit();
+        nameEdit = new QLineEdit();
+        nameEdit->setPlaceholderText("e.g. *PATH* (all variables when empty)");
+
+        scopeBox = new QComboBox();
+        scopeBox->addItems(QStringList() << "All" << "Global (System)" << "Local (User)");
+
+        regexCheck = new QCheckBox("Regular expression");
+        caseCheck = new QCheckBox("Case sensitive");
+        caseCheck->setChecked(false);
+
+        previewTable = new QTableWidget(0, 4);
+        previewTable->setEditTriggers(QTableWidget::NoEditTriggers);
+        previewTable->setHorizontalHeaderLabels(QStringList() << "Name" << "Scope" << "Before" << "After");
+        previewTable->horizontalHeader()->setStretchLastSection(true);
+        previewTable->verticalHeader()->hide();
+
+        statusLabel = new QLabel();
+
+        QDialogButtonBox* buttonBox = new QDialogButtonBox();
+        previewButton = buttonBox->addButton(QString("Preview"), QDialogButtonBox::ActionRole);
+        applyButton = buttonBox->addButton(QString("Apply"), QDialogButtonBox::AcceptRole);
+        buttonBox->addButton(QDialogButtonBox::Cancel);
+        applyButton->setDisabled(true);
+
+        layout->addWidget(new QLabel("Find:"), 0, 0);
+        layout->addWidget(findEdit, 0, 1);
+        layout->addWidget(new QLabel("Replace with:"), 1, 0);
+        layout->addWidget(replaceEdit, 1, 1);
+        layout->addWidget(new QLabel("Names:"), 2, 0);
+        layout->addWidget(nameEdit, 2, 1);
+        layout->addWidget(new QLabel("Scope:"), 3, 0);
+        layout->addWidget(scopeBox, 3, 1);
+        layout->addWidget(regexCheck, 4, 1);
+        layout->addWidget(caseCheck, 5, 1);
+        layout->addWidget(previewTable, 6, 0, 1, 2);
+        layout->addWidget(statusLabel, 7, 0, 1, 2);
+        layout->addWidget(buttonBox, 8, 0, 1, 2);
+
+        connect(previewButton, &QPushButton::pressed, [&](){ updatePreview(); });
+        connect(applyButton, &QPushButton::pressed, this, &QDialog::accept);
+        connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+        // a stale preview must not be applied
+        auto invalidate = [&](){
+            pending.clear();
+            applyButton->setDisabled(true);
+        };
+        connect(findEdit, &QLineEdit::textChanged, invalidate);
+        connect(replaceEdit, &QLineEdit::textChanged, invalidate);
+        connect(nameEdit, &QLineEdit::textChanged, invalidate);
+        connect(regexCheck, &QCheckBox::toggled, invalidate);
+        connect(caseCheck, &QCheckBox::toggled, invalidate);
+        connect(scopeBox, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), invalidate);
+    }
+
+    ReplaceOptions ReplaceDialog::options() const
+    {
+        ReplaceOptions options;
+        options.find = findEdit->text();
+        options.replacement = replaceEdit->text();
+        options.regularExpression = regexCheck->isChecked();
+        options.caseSensitivity = caseCheck->isChecked() ? Qt::CaseSensitive : Qt::CaseInsensitive;
+        options.system = scopeBox->currentIndex() != 2;
+        options.user = scopeBox->currentIndex() != 1;
+        options.nameFilter = nameEdit->text().trimmed();
+        return options;
+    }
+
+    void ReplaceDialog::updatePreview()
+    {
+        ReplaceOptions opts = options();
+
+        QString error;
+        if (!BulkReplace::isValid(opts, &error))
+        {
+            statusLabel->setText(error);
+            return;
+        }
+
+        pending = BulkReplace::preview(manager->snapshot(), opts);
+
+        previewTable->setRowCount(pending.count());
+        int entries = 0;
+
+        for (int row = 0; row < pending.count(); ++row)
+        {
+            const ReplaceChange &change = pending.at(row);
+
+            // only the entries which change
+            QStringList before = ValueCodec::entries(change.before.value);
+            QStringList after = ValueCodec::entries(change.after.value);
+            QStringList removed, added;
+
+            for (int i = 0; i < before.count() && i < after.count(); ++i)
+                if (before.at(i) != after.at(i)) {
+                    removed.append(before.at(i));
+                    added.append(after.at(i));
+                }
+
+            entries += added.count();
+
+            previewTable->setItem(row, 0, new QTableWidgetItem(change.before.name));
+            previewTable->setItem(row, 1, new QTableWidgetItem(change.before.type == Variable::Global ? "System" : "User"));
+            previewTable->setItem(row, 2, new QTableWidgetItem(removed.join("\n")));
+            previewTable->setItem(row, 3, new QTableWidgetItem(added.join("\n")));
+        }
+
+        previewTable->resizeColumnToContents(0);
+        previewTable->resizeColumnToContents(1);
+
+        statusLabel->setText(QString("%1 entries in %2 variables will change.")
+                             .arg(entries).arg(pending.count()));
+        applyButton->setDisabled(pending.isEmpty());
+    }
+
+    static QString conflictText(const Variable &var)
+    {
+        if (!var.value.isValid())
+            return QString("(removed)");
+        return ValueCodec::entries(var.value).join("\n");
+    }
+
+    MergeDialog::MergeDialog(const QList<MergeConflict> &conflicts, QWidget* parent)
+        : QDialog(parent), conflicts(conflicts)
+    {
+        setWindowTitle("Changed outside");
+        resize(850, 450);
+
+        QVBoxLayout* layout = new QVBoxLayout(this);
+        layout->addWidget(new QLabel("These variables were changed by someone else since they were loaded:"));
+
+        table = new QTableWidget(conflicts.count(), 5);
+        table->setEditTriggers(QTableWidget::NoEditTriggers);
+        table->setHorizontalHeaderLabels(QStringList() << "Name" << "Loaded" << "Mine" << "Theirs" << "Keep");
+        table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+        table->verticalHeader()->hide();
+        layout->addWidget(table);
+
+        for (int row = 0; row < conflicts.count(); ++row)
+        {
+            const MergeConflict &conflict = conflicts.at(row);
+
+            table->setItem(row, 0, new QTableWidgetItem(conflict.ours.name));
+            table->setItem(row, 1, new QTableWidgetItem(conflictText(conflict.base)));
+            table->setItem(row, 2, new QTableWidgetItem(conflictText(conflict.ours)));
+            table->setItem(row, 3, new QTableWidgetItem(conflictText(conflict.theirs)));
+
+            QComboBox* choice = new QComboBox();
+            choice->addItems(QStringList() << "Mine" << "Theirs");
+            table->setCellWidget(row, 4, choice);
+            choices.append(choice);
+        }
+
+        table->resizeRowsToContents();
+
+        QDialogButtonBox* buttonBox = new QDialogButtonBox(QDialogButtonBox::Save|QDialogButtonBox::Cancel);
+        connect(buttonBox, &QDialogButtonBox::accepted, this, &QDialog::accept);
+        connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+        layout->addWidget(buttonBox);
+    }
+
+    QList<MergeConflict> MergeDialog::resolutions() const
+    {
+        QList<MergeConflict> result = conflicts;
+
+        // an invalid value (removed on their side) removes it here too
+        for (int row = 0; row < result.count(); ++row)
+            if (choices.at(row)->currentIndex() == 1)
+                result[row].resolved = result.at(row).theirs;
+
+        return result;
+    }
+
+    ProfilesDialog::ProfilesDialog(VariablesManager* manager, QWidget* parent)
+        : QDialog(parent), manager(manager)
+    {
+        setWindowTitle("Profiles");
+        resize(700, 450);
+
+        QVBoxLayout* layout = new QVBoxLayout(this);
+
+        list = new QListWidget();
+        list->setSelectionMode(QAbstractItemView::ExtendedSelection);
+        layout->addWidget(list);
+
+        differences = new QTableWidget(0, 4);
+        differences->setEditTriggers(QTableWidget::NoEditTriggers);
+        differences->setHorizontalHeaderLabels(QStringList() << "Name" << "Scope" << "First" << "Second");
+        differences->horizontalHeader()->setStretchLastSection(true);
+        differences->verticalHeader()->hide();
+        differences->hide();
+        layout->addWidget(differences);
+
+        statusLabel = new QLabel();
+        layout->addWidget(statusLabel);
+
+        QDialogButtonBox* buttonBox = new QDialogButtonBox();
+        saveButton = buttonBox->addButton(QString("Save edits as..."), QDialogButtonBox::ActionRole);
+        compareButton = buttonBox->addButton(QString("Compare"), QDialogButtonBox::ActionRole);
+        removeButton = buttonBox->addButton(QString("Delete"), QDialogButtonBox::ActionRole);
+        applyButton = buttonBox->addButton(QString("Apply"), QDialogButtonBox::AcceptRole);
+        buttonBox->addButton(QDialogButtonBox::Close);
+        layout->addWidget(buttonBox);
+
+        connect(saveButton, &QPushButton::pressed, [&](){ saveProfile(); });
+        connect(applyButton, &QPushButton::pressed, [&](){ applyProfile(); });
+        connect(compareButton, &QPushButton::pressed, [&](){ compareProfiles(); });
+        connect(removeButton, &QPushButton::pressed, [&](){ removeProfiles(); });
+        connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+        connect(list, &QListWidget::itemDoubleClicked, [&](QListWidgetItem*){ applyProfile(); });
+
+        connect(list, &QListWidget::itemSelectionChanged, [&](){
+            int selected = selectedNames().count();
+            applyButton->setEnabled(selected == 1);
+            compareButton->setEnabled(selected == 2);
+            removeButton->setEnabled(selected > 0);
+        });
+
+        refreshList();
+    }
+
+    void ProfilesDialog::refreshList()
+    {
+        list->clear();
+        list->addItems(store.names());
+
+        applyButton->setDisabled(true);
+        compareButton->setDisabled(true);
+        removeButton->setDisabled(true);
+        EnvironmentSnapshot snapshot = manager->snapshot();
+        saveButton->setEnabled(!snapshot.edits(Variable::Global).isEmpty() ||
+                               !snapshot.edits(Variable::User).isEmpty());
+    }
+
+    QStringList ProfilesDialog::selectedNames() const
+    {
+        QStringList names;
+        foreach (QListWidgetItem* item, list->selectedItems())
+            names.append(item->text());
+        return names;
+    }
+
+    void ProfilesDialog::saveProfile()
+    {
+        bool ok = false;
+        QString name = QInputDialog::getText(this, QString("Save profile"), QString("Name:"),
+                                             QLineEdit::Normal, QString(), &ok).trimmed();
+        if (!ok || name.isEmpty())
+            return;
+
+        EnvironmentProfile profile = EnvironmentProfiles::capture(name, manager->snapshot());
+
+        if (!store.save(profile))
+        {
+            statusLabel->setText(store.errorString());
+            return;
+        }
+
+        refreshList();
+        statusLabel->setText(QString("Saved %1 changed variable(s) as '%2'.").arg(profile.count()).arg(name));
+    }
+
+    void ProfilesDialog::applyProfile()
+    {
+        QStringList names = selectedNames();
+        if (names.count() != 1)
+            return;
+
+        EnvironmentProfile profile;
+        if (!store.load(names.first(), &profile))
+        {
+            statusLabel->setText(store.errorString());
+            return;
+        }
+
+        pending = EnvironmentProfiles::plan(profile, manager->snapshot());
+
+        if (pending.isEmpty())
+        {
+            statusLabel->setText(QString("'%1' is already applied.").arg(profile.name));
+            return;
+        }
+
+        accept();
+    }
+
+    static QString profileText(bool inProfile, const Variable &var)
+    {
+        if (!inProfile)
+            return QString("(not set)");
+        if (!var.value.isValid())
+            return QString("(removed)");
+        return ValueCodec::entries(var.value).join("\n");
+    }
+
+    void ProfilesDialog::compareProfiles()
+    {
+        QStringList names = selectedNames();
+        if (names.count() != 2)
+            return;
+
+        EnvironmentProfile first, second;
+        if (!store.load(names.at(0), &first) || !store.load(names.at(1), &second))
+        {
+            statusLabel->setText(store.errorString());
+            return;
+        }
+
+        QList<ProfileDifference> diffs = EnvironmentProfiles::compare(first, second);
+
+        differences->setHorizontalHeaderLabels(QStringList() << "Name" << "Scope" << first.name << second.name);
+        differences->setRowCount(diffs.count());
+
+        for (int row = 0; row < diffs.count(); ++row)
+        {
+            const ProfileDifference &diff = diffs.at(row);
+
+            differences->setItem(row, 0, new QTableWidgetItem(diff.name));
+            differences->setItem(row, 1, new QTableWidgetItem(diff.type == Variable::Global ? "System" : "User"));
+            differences->setItem(row, 2, new QTableWidgetItem(profileText(diff.inFirst, diff.first)));
+            differences->setItem(row, 3, new QTableWidgetItem(profileText(diff.inSecond, diff.second)));
+        }
+
+        differences->resizeColumnToContents(0);
+        differences->resizeColumnToContents(1);
+        differences->resizeRowsToContents();
+        differences->show();
+
+        statusLabel->setText(QString("%1 variable(s) differ.").arg(diffs.count()));
+    }
+
+    void ProfilesDialog::removeProfiles()
+    {
+        QStringList names = selectedNames();
+
+        if (QMessageBox::question(this, QString("Delete"),
+                                  QString("Delete %1 profile(s)?").arg(names.count())) != QMessageBox::Yes)
+            return;
+
+        foreach (const QString &name, names)
+            if (!store.remove(name))
+                statusLabel->setText(store.errorString());
+
+        differences->hide();
+        refreshList();
+    }
+
+    ExportDialog::ExportDialog(QWidget* parent)
+        : QDialog(parent)
+    {
+        setWindowTitle("Export");
+
+        QGridLayout* layout = new QGridLayout(this);
+
+        fileEdit = new QLineEdit();
+        fileEdit->setPlaceholderText("e.g. C:\\environment");
+        QPushButton* browseButton = new QPushButton("Browse...");
+
+        layout->addWidget(new QLabel("File:"), 0, 0);
+        layout->addWidget(fileEdit, 0, 1);
+        layout->addWidget(browseButton, 0, 2);
+
+        QStringList names = QStringList() << "HTML (*.html)" << "Text file (*.log)" << "JSON (*.json)"
+                                          << "Environment (*.env)" << "Binary snapshot (*.eeb)";
+        for (int i = 0; i < names.count(); ++i)
+        {
+            QCheckBox* check = new QCheckBox(names.at(i));
+            check->setChecked(i < 2);
+            layout->addWidget(check, i + 1, 1, 1, 2);
+            formatChecks.append(check);
+        }
+
+        QDialogButtonBox* buttonBox = new QDialogButtonBox();
+        exportButton = buttonBox->addButton(QString("Export"), QDialogButtonBox::AcceptRole);
+        buttonBox->addButton(QDialogButtonBox::Cancel);
+        exportButton->setDisabled(true);
+        layout->addWidget(buttonBox, names.count() + 1, 0, 1, 3);
+
+        connect(browseButton, &QPushButton::pressed, [&](){
+            QString fileName = QFileDialog::getSaveFileName(this, "Export to...", fileEdit->text());
+            if (!fileName.isEmpty())
+                fileEdit->setText(fileName);
+        });
+
+        auto validate = [&](){ exportButton->setEnabled(!baseName().isEmpty() && !formats().isEmpty()); };
+        connect(fileEdit, &QLineEdit::textChanged, validate);
+        foreach (QCheckBox* check, formatChecks)
+            connect(check, &QCheckBox::toggled, validate);
+
+        connect(buttonBox, &QDialogButtonBox::accepted, this, &QDialog::accept);
+        connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    }
+
+    QList<ExportPipeline::Format> ExportDialog::formats() const
+    {
+        QList<ExportPipeline::Format> result;
+        for (int i = 0; i < formatChecks.count(); ++i)
+            if (formatChecks.at(i)->isChecked())
+                result.append(ExportPipeline::Format(i));
+        return result;
+    }
+
+    LaunchDialog::LaunchDialog(ProcessLauncher* launcher, QWidget* parent)
+        : QDialog(parent), launcher(launcher)
+    {
+        setWindowTitle("Run with the edited environment");
+        resize(700, 450);
+
+        QGridLayout* layout = new QGridLayout(this);
+
+        commandEdit = new QLineEdit();
+        commandEdit->setPlaceholderText("e.g. cmd /c set");
+        directoryEdit = new QLineEdit();
+        directoryEdit->setPlaceholderText("(current directory)");
+        detachedCheck = new QCheckBox("Detached: leave it running, without output (e.g. for notepad)");
+
+        output = new QPlainTextEdit();
+        output->setReadOnly(true);
+        output->setLineWrapMode(QPlainTextEdit::NoWrap);
+
+        statusLabel = new QLabel();
+
+        QDialogButtonBox* buttonBox = new QDialogButtonBox();
+        runButton = buttonBox->addButton(QString("Run"), QDialogButtonBox::ActionRole);
+        buttonBox->addButton(QDialogButtonBox::Close);
+
+        layout->addWidget(new QLabel("Command:"), 0, 0);
+        layout->addWidget(commandEdit, 0, 1);
+        layout->addWidget(new QLabel("Directory:"), 1, 0);
+        layout->addWidget(directoryEdit, 1, 1);
+        layout->addWidget(detachedCheck, 2, 1);
+        layout->addWidget(output, 3, 0, 1, 2);
+        layout->addWidget(statusLabel, 4, 0, 1, 2);
+        layout->addWidget(buttonBox, 5, 0, 1, 2);
+
+        connect(runButton, &QPushButton::pressed, [&](){ launch(); });
+        connect(commandEdit, &QLineEdit::returnPressed, [&](){ launch(); });
+        connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::close);
+        connect(launcher, &ProcessLauncher::finished, this, &LaunchDialog::showResult);
+    }
+
+    void LaunchDialog::launch()
+    {
+        QString command = commandEdit->text().trimmed();
+        if (command.isEmpty())
+            return;
+
+        // a detached launch reports at once
+        if (detachedCheck->isChecked())
+            launcher->launch(command, directoryEdit->text().trimmed(), true);
+        else
+        {
+            launcher->launch(command, directoryEdit->text().trimmed());
+            statusLabel->setText(QString("%1 running...").arg(launcher->running()));
+        }
+    }
+
+    void LaunchDialog::showResult(const LaunchResult &result)
+    {
+        output->appendPlainText(QString("> %1").arg(result.command));
+        output->appendPlainText(QString::fromLocal8Bit(result.output));
+
+        if (!result.errorString.isEmpty())
+            output->appendPlainText(result.errorString);
+
+        QString status;
+        if (!result.started)
+            status = QString("'%1' could not be started.").arg(result.command);
+        else if (result.detached)
+            status = QString("'%1' started detached.").arg(result.command);
+        else
+            status = QString("'%1' exited with %2 after %3 ms.")
+                     .arg(result.command).arg(result.exitCode).arg(result.elapsed);
+
+        if (launcher->running() > 0)
+            status += QString(" %1 still running.").arg(launcher->running());
+
+        statusLabel->setText(status);
+    }
+
+    ProfilerDialog::ProfilerDialog(SizeProfiler* profiler, QWidget* parent)
+        : QDialog(parent), profiler(profiler)
+    {
+        setWindowTitle("Sizes and edits");
+        resize(800, 550);
+
+        QVBoxLayout* layout = new QVBoxLayout(this);
+
+        summaryLabel = new QLabel();
+        layout->addWidget(summaryLabel);
+
+        rankingBox = new QComboBox();
+        rankingBox->addItems(QStringList() << "Size" << "Entries" << "Entries found elsewhere" << "Edits");
+
+        QHBoxLayout* rankingLayout = new QHBoxLayout();
+        rankingLayout->addWidget(new QLabel("Rank by:"));
+        rankingLayout->addWidget(rankingBox);
+        rankingLayout->addStretch();
+        layout->addLayout(rankingLayout);
+
+        variableTable = new QTableWidget(0, 7);
+        variableTable->setEditTriggers(QTableWidget::NoEditTriggers);
+        variableTable->setHorizontalHeaderLabels(QStringList() << "Name" << "Scope" << "Bytes" << "% of limit"
+                                                               << "Entries" << "Elsewhere" << "Edits");
+        variableTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+        variableTable->verticalHeader()->hide();
+        layout->addWidget(variableTable, 2);
+
+        layout->addWidget(new QLabel("Repeated entries:"));
+
+        entryTable = new QTableWidget(0, 3);
+        entryTable->setEditTriggers(QTableWidget::NoEditTriggers);
+        entryTable->setHorizontalHeaderLabels(QStringList() << "Entry" << "Occurrences" << "Bytes");
+        entryTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+        entryTable->verticalHeader()->hide();
+        layout->addWidget(entryTable, 1);
+
+        QDialogButtonBox* buttonBox = new QDialogButtonBox();
+        QPushButton* exportButton = buttonBox->addButton(QString("Export report..."), QDialogButtonBox::ActionRole);
+        buttonBox->addButton(QDialogButtonBox::Close);
+        layout->addWidget(buttonBox);
+
+        refreshTimer.setSingleShot(true);
+        refreshTimer.setInterval(250);
+        connect(&refreshTimer, &QTimer::timeout, [&](){ refresh(); });
+        connect(profiler, &SizeProfiler::changed, [&](){
+            if (isVisible())
+                refreshTimer.start();
+        });
+
+        connect(rankingBox, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+                [&](int){ refresh(); });
+        connect(exportButton, &QPushButton::pressed, [&](){ exportReport(); });
+        connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::close);
+    }
+
+    void ProfilerDialog::refresh()
+    {
+        refreshTimer.stop();
+
+        SizeProfiler::Ranking ranking = SizeProfiler::Ranking(rankingBox->currentIndex());
+        QList<VariableStats> variables = profiler->top(ranking, shownRows);
+
+        variableTable->setRowCount(variables.count());
+        for (int row = 0; row < variables.count(); ++row)
+        {
+            const VariableStats &s = variables.at(row);
+
+            variableTable->setItem(row, 0, new QTableWidgetItem(s.name));
+            variableTable->setItem(row, 1, new QTableWidgetItem(s.type == Variable::Global ? "System" : "User"));
+            variableTable->setItem(row, 2, new QTableWidgetItem(QString::number(s.bytes)));
+            variableTable->setItem(row, 3, new QTableWidgetItem(QString::number(s.length * 100 / SizeProfiler::maxValueLength)));
+            variableTable->setItem(row, 4, new QTableWidgetItem(QString::number(s.entries)));
+            variableTable->setItem(row, 5, new QTableWidgetItem(QString::number(s.duplicates)));
+            variableTable->setItem(row, 6, new QTableWidgetItem(QString::number(s.edits)));
+        }
+
+        QList<EntryStats> entries = profiler->topEntries(shownRows);
+
+        entryTable->setRowCount(entries.count());
+        for (int row = 0; row < entries.count(); ++row)
+        {
+            const EntryStats &e = entries.at(row);
+
+            entryTable->setItem(row, 0, new QTableWidgetItem(e.entry));
+            entryTable->setItem(row, 1, new QTableWidgetItem(QString::number(e.occurrences)));
+            entryTable->setItem(row, 2, new QTableWidgetItem(QString::number(e.bytes)));
+        }
+
+        summaryLabel->setText(QString("%1 variables. Environment block: %2 bytes (system), %3 bytes (user).")
+                              .arg(profiler->variableCount())
+                              .arg(profiler->blockBytes(Variable::Global))
+                              .arg(profiler->blockBytes(Variable::User)));
+    }
+
+    void ProfilerDialog::exportReport()
+    {
+        QString fileName = QFileDialog::getSaveFileName(this, "Export report...", QString(),
+                                                        QString("Text file (*.txt)"));
+        if (fileName.isEmpty())
+            return;
+
+        QFile file(fileName);
+        if (!file.open(QFile::WriteOnly|QFile::Text) || file.write(profiler->report().toUtf8()) < 0)
+            QMessageBox::critical(this, QString("Error"),
+                                  QString("Error occured:").append(file.errorString()));
+    }
+
+    AllocationDialog::AllocationDialog(QWidget* parent)
+        : QDialog(parent)
+    {
+        setWindowTitle("Allocations");
+        resize(600, 350);
+
+        QVBoxLayout* layout = new QVBoxLayout(this);
+
+        table = new QTableWidget(0, 5);
+        table->setEditTriggers(QTableWidget::NoEditTriggers);
+        table->setHorizontalHeaderLabels(QStringList() << "Operation" << "Calls" << "Allocations"
+                                                       << "Bytes" << "Peak");
+        table->horizontalHeader()->setStretchLastSection(true);
+        table->verticalHeader()->hide();
+        layout->addWidget(table);
+
+        totalLabel = new QLabel();
+        layout->addWidget(totalLabel);
+
+        QDialogButtonBox* buttonBox = new QDialogButtonBox();
+        QPushButton* refreshButton = buttonBox->addButton(QString("Refresh"), QDialogButtonBox::ActionRole);
+        buttonBox->addButton(QDialogButtonBox::Reset);
+        buttonBox->addButton(QDialogButtonBox::Close);
+        layout->addWidget(buttonBox);
+
+        connect(refreshButton, &QPushButton::pressed, [&](){ refresh(); });
+        connect(buttonBox->button(QDialogButtonBox::Reset), &QPushButton::pressed, [&](){
+            AllocationTracker::reset();
+            refresh();
+        });
+        connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::close);
+    }
+
+    void AllocationDialog::refresh()
+    {
+        QList<AllocationStats> statistics = AllocationTracker::statistics();
+        table->setRowCount(statistics.count());
+
+        for (int row = 0; row < statistics.count(); ++row)
+        {
+            const AllocationStats &stats = statistics.at(row);
+
+            table->setItem(row, 0, new QTableWidgetItem(stats.tag));
+            table->setItem(row, 1, new QTableWidgetItem(QString::number(stats.calls)));
+            table->setItem(row, 2, new QTableWidgetItem(QString::number(stats.allocations)));
+            table->setItem(row, 3, new QTableWidgetItem(QString::number(stats.bytes)));
+            table->setItem(row, 4, new QTableWidgetItem(QString::number(stats.peak)));
+        }
+
+        table->resizeColumnToContents(0);
+
+        totalLabel->setText(QString("operator new only (Qt strings and containers are not counted). "
+                                    "Process: %1 allocations, %2 bytes in use, peak %3 bytes.")
+                            .arg(AllocationTracker::totalAllocations())
+                            .arg(AllocationTracker::currentBytes())
+                            .arg(AllocationTracker::peakBytes()));
+    }
 }
@@ -24,33 +24,53 @@
 #include <QtWidgets/QComboBox>
 #include <QtWidgets/QFormLayout>
 #include <QtWidgets/QHeaderView>
+#include <QtWidgets/QListView>
 #include <QtWidgets/QListWidget>
 #include <QtWidgets/QPushButton>
+#include <QtWidgets/QPlainTextEdit>
 #include <QtWidgets/QVBoxLayout>
+#include <QtWidgets/QHBoxLayout>
 #include <QtWidgets/QMessageBox>
 #include <QtWidgets/QFileDialog>
+#include <QtWidgets/QInputDialog>
+#include <QtWidgets/QProgressDialog>
 #include <QtWidgets/QTableWidget>
+#include <QtWidgets/QTreeWidget>
 #include <QtWidgets/QDialogButtonBox>
 #include <QtWidgets/QTableWidgetItem>
 
 #include "VariablesManager.h"
+#include "ValueListModel.h"
+#include "EffectiveEnvironment.h"
+#include "ProcessScanner.h"
+#include "ListValueDelegate.h"
+#include "BulkReplace.h"
+#include "AllocationTracker.h"
+#include "EnvironmentProfiles.h"
+#include "ProcessLauncher.h"
+#include "ExportPipeline.h"
+#include "SizeProfiler.h"
+
+#include <QFutureWatcher>
+#include <QTimer>
 
 namespace EnvironmentExplorer
 {
     //
     // UI structure.
     //
-    class DeleteKeyEventFilter : public QObject
+    class ListKeyEventFilter : public QObject
     {
         Q_OBJECT
 
     public:
-        DeleteKeyEventFilter(QObject* parent = 0)
+        ListKeyEventFilter(QObject* parent = 0)
             : QObject(parent) {}
 
         bool eventFilter(QObject *obj, QEvent *e);
     signals:
         void deleteKeyPressed();
+        void pasteKeyPressed();
     };
 
     // VariableDialog
@@ -81,12 +101,16 @@ namespace EnvironmentExplorer
         Variable::Type variableType();
 
     private:
+        void pasteEntries();
+        void updateAddButton();
+
         DialogMode dialogMode;
 
         QGridLayout* mainLayout;
         QDialogButtonBox* dialogButtonBox;
 
-        QListWidget* itemsList;
+        QListView* itemsList;
+        ValueListModel* itemsModel;
 
         QPushButton* addButton,
                    * cancelButton;
@@ -102,23 +126,291 @@ namespace EnvironmentExplorer
         QComboBox* scopeBox;
     };
 
+    // Shows the merged (system + user) environment.
+    class EffectiveEnvironmentDialog : public QDialog
+    {
+        Q_OBJECT
+
+    public:
+        EffectiveEnvironmentDialog(EffectiveEnvironment* environment,
+                                   QWidget* parent = 0);
+
+    private:
+        void fillTable();
+        void updateRow(const QString &key);
+        void setRow(int row, const EffectiveVariable &var);
+        void exportEnvironment();
+
+        EffectiveEnvironment* environment;
+
+        // Upper-cased name -> table row.
+        QHash<QString, int> rows;
+
+        QTableWidget* table;
+        QCheckBox* expandCheck;
+        QDialogButtonBox* buttonBox;
+        QPushButton* exportButton;
+    };
+
+    // Shows what running processes carry, compared
+    // with the configured (effective) environment.
+    class ProcessScanDialog : public QDialog
+    {
+        Q_OBJECT
+
+    public:
+        ProcessScanDialog(EffectiveEnvironment* environment,
+                          QWidget* parent = 0);
+
+        void scan();
+
+    private:
+        void fillTree();
+        void expandItem(QTreeWidgetItem* item);
+
+        enum { VariableRole = Qt::UserRole, ValueRole };
+
+        EffectiveEnvironment* environment;
+        ProcessScanResult result;
+        QFutureWatcher<ProcessScanResult> watcher;
+
+        QTreeWidget* tree;
+        QLabel* statusLabel;
+        QCheckBox* differingCheck;
+        QPushButton* scanButton;
+    };
+
+    // Find and replace in all values, with a preview of the changes.
+    class ReplaceDialog : public QDialog
+    {
+        Q_OBJECT
+
+    public:
+        ReplaceDialog(VariablesManager* manager, QWidget* parent = 0);
+
+        // Changes of the last preview.
+        QList<ReplaceChange> changes() const
+        { return pending; }
+
+    private:
+        ReplaceOptions options() const;
+        void updatePreview();
+
+        VariablesManager* manager;
+        QList<ReplaceChange> pending;
+
+        QLineEdit* findEdit,
+                 * replaceEdit,
+                 * nameEdit;
+
+        QCheckBox* regexCheck,
+                 * caseCheck;
+
+        QComboBox* scopeBox;
+        QTableWidget* previewTable;
+        QLabel* statusLabel;
+
+        QPushButton* previewButton,
+                   * applyButton;
+    };
+
+    // Keys changed both here and in the registry since the load;
+    // for each the user keeps either side.
+    class MergeDialog : public QDialog
+    {
+        Q_OBJECT
+
+    public:
+        MergeDialog(const QList<MergeConflict> &conflicts, QWidget* parent = 0);
+
+        // The conflicts with the chosen values.
+        QList<MergeConflict> resolutions() const;
+
+    private:
+        QList<MergeConflict> conflicts;
+
+        QTableWidget* table;
+        QList<QComboBox*> choices;
+    };
+
+    // Saved profiles: store the current edits under a name, apply
+    // one, or compare two.
+    class ProfilesDialog : public QDialog
+    {
+        Q_OBJECT
+
+    public:
+        ProfilesDialog(VariablesManager* manager, QWidget* parent = 0);
+
+        // Changes to apply when accepted.
+        QList<ReplaceChange> changes() const
+        { return pending; }
+
+    private:
+        void refreshList();
+        QStringList selectedNames() const;
+
+        void saveProfile();
+        void applyProfile();
+        void compareProfiles();
+        void removeProfiles();
+
+        VariablesManager* manager;
+        ProfileStore store;
+        QList<ReplaceChange> pending;
+
+        QListWidget* list;
+        QTableWidget* differences;
+        QLabel* statusLabel;
+
+        QPushButton* saveButton,
+                   * applyButton,
+                   * compareButton,
+                   * removeButton;
+    };
+
+    // Where to export and in which formats; all of them are written
+    // in one pass, next to each other.
+    class ExportDialog : public QDialog
+    {
+        Q_OBJECT
+
+    public:
+        ExportDialog(QWidget* parent = 0);
+
+        // File name without (or with any) format suffix.
+        QString baseName() const
+        { return fileEdit->text().trimmed(); }
+
+        QList<ExportPipeline::Format> formats() const;
+
+    private:
+        QLineEdit* fileEdit;
+        QList<QCheckBox*> formatChecks;
+        QPushButton* exportButton;
+    };
+
+    // Runs a command with the edited environment and shows its output.
+    class LaunchDialog : public QDialog
+    {
+        Q_OBJECT
+
+    public:
+        LaunchDialog(ProcessLauncher* launcher, QWidget* parent = 0);
+
+    private:
+        void launch();
+        void showResult(const LaunchResult &result);
+
+        ProcessLauncher* launcher;
+
+        QLineEdit* commandEdit,
+                 * directoryEdit;
+        QCheckBox* detachedCheck;
+
+        QPlainTextEdit* output;
+        QLabel* statusLabel;
+        QPushButton* runButton;
+    };
+
+    // Largest, longest, most duplicated and most edited variables,
+    // see SizeProfiler. Shows the top rows only.
+    class ProfilerDialog : public QDialog
+    {
+        Q_OBJECT
+
+    public:
+        ProfilerDialog(SizeProfiler* profiler, QWidget* parent = 0);
+
+        void refresh();
+
+    private:
+        void exportReport();
+
+        enum { shownRows = 200 };
+
+        SizeProfiler* profiler;
+
+        // changes come one by one, the tables follow them in bulk
+        QTimer refreshTimer;
+
+        QComboBox* rankingBox;
+        QTableWidget* variableTable,
+                    * entryTable;
+        QLabel* summaryLabel;
+    };
+
+    // Allocation counters per operation, see AllocationTracker.
+    class AllocationDialog : public QDialog
+    {
+        Q_OBJECT
+
+    public:
+        AllocationDialog(QWidget* parent = 0);
+
+        void refresh();
+
+    private:
+        QTableWidget* table;
+        QLabel* totalLabel;
+    };
+
     struct UserInterface
     {
         QTableWidget* mainTable;
+        ListValueDelegate* valueDelegate;
         QVBoxLayout* layout;
 
+        // query filter, see VariableQuery
+        QLineEdit* filterEdit;
+        QLabel* filterStatus;
+
+        // row order, see VariableOrder
+        QComboBox* sortBox,
+                 * groupBox;
+        QCheckBox* descendingCheck;
+
         QDialogButtonBox* buttonPanel;
         QPushButton* addButton,
+                   * importButton,
+                   * replaceButton,
                    * saveButton,
                    * resetButton,
                    * closeButton,
                    * cancelButton,
-                   * exportButton;
+                   * exportButton,
+                   * effectiveButton,
+                   * processesButton,
+                   * profilesButton,
+                   * launchButton,
+                   * profilerButton,
+                   * diagnosticsButton;
 
         UserInterface()
         {
             layout = new QVBoxLayout();
 
+            filterEdit = new QLineEdit();
+            filterEdit->setPlaceholderText(QString("Filter, e.g. scope:user entries>50 value~\"/opt\""));
+            filterEdit->setClearButtonEnabled(true);
+            filterStatus = new QLabel();
+
+            sortBox = new QComboBox();
+            sortBox->addItems(QStringList() << "Name" << "Scope" << "Value length" << "Entries" << "Modified");
+            groupBox = new QComboBox();
+            groupBox->addItems(QStringList() << "No groups" << "By scope" << "By modified");
+            descendingCheck = new QCheckBox("Descending");
+
+            QHBoxLayout* filterLayout = new QHBoxLayout();
+            filterLayout->addWidget(filterEdit);
+            filterLayout->addWidget(filterStatus);
+            filterLayout->addWidget(new QLabel("Sort:"));
+            filterLayout->addWidget(sortBox);
+            filterLayout->addWidget(descendingCheck);
+            filterLayout->addWidget(new QLabel("Group:"));
+            filterLayout->addWidget(groupBox);
+            layout->addLayout(filterLayout);
+
             mainTable = new QTableWidget(0, 2);
             mainTable->setEditTriggers(QTableWidget::NoEditTriggers);
             mainTable->setContextMenuPolicy(Qt::CustomContextMenu);
@@ -129,9 +421,22 @@ namespace EnvironmentExplorer
             mainTable->setSelectionBehavior(QAbstractItemView::SelectRows);
             layout->addWidget(mainTable);
 
+            valueDelegate = new ListValueDelegate(mainTable);
+            valueDelegate->attach(mainTable, 1);
+
             buttonPanel = new QDialogButtonBox();
             addButton = buttonPanel->addButton(QString("Add"), QDialogButtonBox::ActionRole);
+            importButton = buttonPanel->addButton(QString("Import"), QDialogButtonBox::ActionRole);
+            replaceButton = buttonPanel->addButton(QString("Replace"), QDialogButtonBox::ActionRole);
             exportButton = buttonPanel->addButton(QString("Export"), QDialogButtonBox::ActionRole);
+            effectiveButton = buttonPanel->addButton(QString("Effective"), QDialogButtonBox::ActionRole);
+            processesButton = buttonPanel->addButton(QString("Processes"), QDialogButtonBox::ActionRole);
+            processesButton->setEnabled(ProcessScanner::isSupported());
+            profilesButton = buttonPanel->addButton(QString("Profiles"), QDialogButtonBox::ActionRole);
+            launchButton = buttonPanel->addButton(QString("Run"), QDialogButtonBox::ActionRole);
+            profilerButton = buttonPanel->addButton(QString("Sizes"), QDialogButtonBox::ActionRole);
+            diagnosticsButton = buttonPanel->addButton(QString("Diagnostics"), QDialogButtonBox::ActionRole);
+            diagnosticsButton->setVisible(AllocationTracker::isEnabled());
             saveButton = buttonPanel->addButton(QDialogButtonBox::Save);
             resetButton = buttonPanel->addButton(QDialogButtonBox::Reset);
             closeButton = buttonPanel->addButton(QDialogButtonBox::Close);
@@ -0,0 +1,112 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "PathTrie.h"
+
+#include <string.h>
+
+namespace EnvironmentExplorer
+{
+    static void deleteChildren(PathTrie::Node *node)
+    {
+        foreach (PathTrie::Node* child, node->children)
+        {
+            deleteChildren(child);
+            delete child;
+        }
+    }
+
+    PathTrie::PathTrie()
+        : count(0)
+    {
+        root.parent = 0;
+        root.length = 0;
+    }
+
+    PathTrie::~PathTrie()
+    { deleteChildren(&root); }
+
+    const PathTrie::Node* PathTrie::insert(const QString &entry)
+    {
+        Node* node = &root;
+        int start = 0;
+
+        // "C:\a\b" -> "C:", "\a", "\b"; the components put together
+        // give back the entry exactly.
+        while (start < entry.size())
+        {
+            int end = start + 1;
+            while (end < entry.size() && entry.at(end) != '\\' && entry.at(end) != '/')
+                ++end;
+
+            QString component = entry.mid(start, end - start);
+            QHash<QString, Node*>::const_iterator it = node->children.constFind(component);
+
+            if (it != node->children.constEnd())
+                node = it.value();
+            else
+            {
+                Node* child = new Node();
+                child->parent = node;
+                child->component = component;
+                child->length = node->length + component.size();
+
+                node->children.insert(component, child);
+                node = child;
+                ++count;
+            }
+
+            start = end;
+        }
+
+        return node;
+    }
+
+    QString PathTrie::text(const Node *node)
+    {
+        QString result(node->length, Qt::Uninitialized);
+        QChar* out = result.data();
+
+        // filled from the back, walking up to the root
+        for (; node && node->parent; node = node->parent)
+        {
+            int offset = node->parent->length;
+            memcpy(out + offset, node->component.constData(), node->component.size() * sizeof(QChar));
+        }
+
+        return result;
+    }
+
+    PathList::PathList(const QStringList &entries, const QSharedPointer<PathTrie> &trie)
+        : trie(trie)
+    {
+        leaves.reserve(entries.count());
+        foreach (const QString &entry, entries)
+            leaves.append(trie->insert(entry));
+    }
+
+    QStringList PathList::toStringList() const
+    {
+        QStringList result;
+        result.reserve(leaves.count());
+
+        foreach (const PathTrie::Node* leaf, leaves)
+            result.append(PathTrie::text(leaf));
+
+        return result;
+    }
+
+    int PathList::length() const
+    {
+        int total = qMax(0, leaves.count() - 1);
+        foreach (const PathTrie::Node* leaf, leaves)
+            total += leaf->length;
+        return total;
+    }
+}
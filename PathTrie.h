@@ -0,0 +1,89 @@
+#ifndef PATHTRIE_H
+#define PATHTRIE_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// PathTrie stores list entries (directories mostly) split at '\' and
+// '/', so the prefixes shared by PATH, INCLUDE, LIB & co. are held
+// once. An entry is a pointer to its last node; the string is put
+// back together on demand.
+//
+
+#include <QSharedPointer>
+#include <QStringList>
+#include <QMetaType>
+#include <QVector>
+#include <QHash>
+
+namespace EnvironmentExplorer
+{
+    class PathTrie
+    {
+        Q_DISABLE_COPY(PathTrie)
+
+    public:
+        struct Node
+        {
+            const Node* parent;
+
+            // with its leading separator, e.g. "\bin"
+            QString component;
+
+            // length of the whole entry up to this node
+            int length;
+
+            QHash<QString, Node*> children;
+        };
+
+        PathTrie();
+        ~PathTrie();
+
+        // Nodes are never moved nor removed while the trie lives, and
+        // insert() only touches child tables, so entries may be read
+        // from other threads while the owner keeps inserting.
+        const Node* insert(const QString &entry);
+
+        static QString text(const Node* node);
+
+        int nodeCount() const
+        { return count; }
+
+    private:
+        Node root;
+        int count;
+    };
+
+    // A list value whose entries live in a PathTrie.
+    class PathList
+    {
+    public:
+        PathList() {}
+        PathList(const QStringList &entries, const QSharedPointer<PathTrie> &trie);
+
+        int count() const
+        { return leaves.count(); }
+
+        QString at(int i) const
+        { return PathTrie::text(leaves.at(i)); }
+
+        QStringList toStringList() const;
+
+        // Length of the entries joined with ';', as stored.
+        int length() const;
+
+    private:
+        QSharedPointer<PathTrie> trie; // keeps the nodes alive
+        QVector<const PathTrie::Node*> leaves;
+    };
+}
+
+Q_DECLARE_METATYPE(EnvironmentExplorer::PathList)
+
+#endif // PATHTRIE_H
@@ -0,0 +1,207 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "ProcessLauncher.h"
+#include "EffectiveEnvironment.h"
+#include "RunMetrics.h"
+
+#include <QStringList>
+#include <QProcess>
+
+namespace EnvironmentExplorer
+{
+    ProcessLauncher::ProcessLauncher(EffectiveEnvironment* environment, QObject* parent)
+        : QObject(parent), environment(environment)
+    {
+        connect(environment, &EffectiveEnvironment::variableChanged, this, &ProcessLauncher::patch);
+        connect(environment, &EffectiveEnvironment::rebuilt, this, &ProcessLauncher::rebuild);
+        rebuild();
+    }
+
+    // Nobody is left to show the output of commands still running, so
+    // they are ended rather than waited for; detached ones keep running.
+    ProcessLauncher::~ProcessLauncher()
+    {
+        foreach (QProcess* process, launches.keys())
+        {
+            process->disconnect(this);
+            process->kill();
+        }
+    }
+
+    void ProcessLauncher::rebuild()
+    {
+        OperationTimer timer("environment_block");
+
+        cached = QProcessEnvironment::systemEnvironment();
+
+        foreach (const EffectiveVariable &var, environment->variables())
+            cached.insert(var.name, var.expandedValue);
+
+        // still removed (e.g. when only the expansion changed)
+        QSet<QString> keys = removed;
+        removed.clear();
+        foreach (const QString &key, keys)
+            if (!environment->contains(key)) {
+                cached.remove(key);
+                removed.insert(key);
+            }
+    }
+
+    void ProcessLauncher::patch(const QString &key)
+    {
+        OperationTimer timer("environment_patch");
+
+        if (environment->contains(key))
+        {
+            EffectiveVariable var = environment->variable(key);
+            cached.insert(var.name, var.expandedValue);
+            removed.remove(key);
+        }
+        else
+        {
+            cached.remove(key);
+            removed.insert(key);
+        }
+    }
+
+    void ProcessLauncher::launch(const QString &command, const QString &workingDirectory,
+                                 bool detached)
+    {
+        if (detached)
+        {
+            launchDetached(command, workingDirectory);
+            return;
+        }
+
+        QProcess* process = new QProcess(this);
+
+        Launch &started = launches[process];
+        started.result.command = command;
+        started.elapsed.start();
+
+        connect(process, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+                this, [this, process](){ finish(process); });
+        connect(process, &QProcess::errorOccurred, this, [this, process](QProcess::ProcessError error){
+            // otherwise finished() follows
+            if (error == QProcess::FailedToStart)
+                finish(process);
+        });
+
+        // the copy is shared, later edits detach our side only
+        process->setProcessEnvironment(cached);
+        process->setProcessChannelMode(QProcess::MergedChannels);
+        if (!workingDirectory.isEmpty())
+            process->setWorkingDirectory(workingDirectory);
+
+        OperationTimer timer("launch");
+        process->start(command);
+    }
+
+    // Splits a command line the way QProcess::start() does: blanks
+    // separate arguments, double quotes group them, and three quotes
+    // in a row stand for one literal quote.
+    static QStringList splitCommand(const QString &command)
+    {
+        QStringList args;
+        QString arg;
+        int quotes = 0;
+        bool inQuote = false;
+
+        for (int i = 0; i < command.size(); ++i)
+        {
+            if (command.at(i) == QLatin1Char('"'))
+            {
+                ++quotes;
+                if (quotes == 3)
+                {
+                    quotes = 0;
+                    arg += command.at(i);
+                }
+                continue;
+            }
+
+            if (quotes)
+            {
+                quotes = 0;
+                inQuote = !inQuote;
+            }
+
+            if (!inQuote && command.at(i).isSpace())
+            {
+                if (!arg.isEmpty())
+                {
+                    args.append(arg);
+                    arg.clear();
+                }
+            }
+            else
+                arg += command.at(i);
+        }
+
+        if (!arg.isEmpty())
+            args.append(arg);
+
+        return args;
+    }
+
+    void ProcessLauncher::launchDetached(const QString &command, const QString &workingDirectory)
+    {
+        QElapsedTimer elapsed;
+        elapsed.start();
+
+        LaunchResult result;
+        result.command = command;
+        result.detached = true;
+
+        QStringList args = splitCommand(command);
+        if (!args.isEmpty())
+        {
+            QProcess process;
+            process.setProgram(args.takeFirst());
+            process.setArguments(args);
+            process.setProcessEnvironment(cached);
+            if (!workingDirectory.isEmpty())
+                process.setWorkingDirectory(workingDirectory);
+
+            OperationTimer timer("launch");
+            result.started = process.startDetached();
+        }
+
+        if (!result.started)
+            result.errorString = QString("Could not start '%1'.").arg(command);
+
+        result.elapsed = elapsed.elapsed();
+        emit finished(result);
+    }
+
+    void ProcessLauncher::finish(QProcess* process)
+    {
+        QHash<QProcess*, Launch>::iterator it = launches.find(process);
+        if (it == launches.end())
+            return;
+
+        LaunchResult result = it.value().result;
+        result.elapsed = it.value().elapsed.elapsed();
+        launches.erase(it);
+
+        result.started = process->error() != QProcess::FailedToStart;
+        if (result.started)
+        {
+            result.exitCode = (process->exitStatus() == QProcess::NormalExit) ? process->exitCode() : -1;
+            result.output = process->readAll();
+        }
+
+        if (!result.started || process->exitStatus() != QProcess::NormalExit)
+            result.errorString = process->errorString();
+
+        process->deleteLater();
+        emit finished(result);
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef PROCESSLAUNCHER_H
+#define PROCESSLAUNCHER_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// ProcessLauncher runs commands with the environment as edited,
+// before it is saved: the process environment with the effective
+// (system + user, unsaved edits included) variables on top.
+//
+// The environment is built once and then follows EffectiveEnvironment
+// key by key; a launch only takes a shared copy of it. Processes are
+// watched through their signals, so no thread waits for them. Detached
+// ones are left to run on their own, past the launcher, and report
+// only whether they started.
+//
+
+#include <QProcessEnvironment>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QSet>
+
+class QProcess;
+
+namespace EnvironmentExplorer
+{
+    class EffectiveEnvironment;
+
+    struct LaunchResult
+    {
+        LaunchResult()
+            : started(false), detached(false), exitCode(-1), elapsed(0) {}
+
+        QString command;
+        bool started;
+        bool detached;      // no exit code nor output then
+        int exitCode;
+
+        // stdout and stderr, interleaved
+        QByteArray output;
+        QString errorString;
+
+        qint64 elapsed; // ms
+    };
+
+    class ProcessLauncher : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        ProcessLauncher(EffectiveEnvironment* environment, QObject* parent = 0);
+        ~ProcessLauncher();
+
+        QProcessEnvironment processEnvironment() const
+        { return cached; }
+
+        void launch(const QString &command, const QString &workingDirectory = QString(),
+                    bool detached = false);
+
+        // Launched and not finished yet, detached ones not counted.
+        int running() const
+        { return launches.count(); }
+
+    signals:
+        void finished(const LaunchResult &result);
+
+    private slots:
+        void rebuild();
+        void patch(const QString &key);
+
+    private:
+        struct Launch
+        {
+            LaunchResult result;
+            QElapsedTimer elapsed;
+        };
+
+        void launchDetached(const QString &command, const QString &workingDirectory);
+        void finish(QProcess* process);
+
+        EffectiveEnvironment* environment;
+        QProcessEnvironment cached;
+
+        // Removed by an edit; the process environment still has them.
+        QSet<QString> removed;
+
+        QHash<QProcess*, Launch> launches;
+    };
+}
+
+#endif // PROCESSLAUNCHER_H
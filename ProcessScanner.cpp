@@ -0,0 +1,403 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "ProcessScanner.h"
+
+#include <QtConcurrent/QtConcurrentMap>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QSet>
+#include <QDir>
+
+#include <algorithm>
+#include <string.h>
+
+#if defined(Q_OS_WIN)
+#include <qt_windows.h>
+#include <tlhelp32.h>
+#elif defined(Q_OS_LINUX)
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace EnvironmentExplorer
+{
+    int ProcessVariable::processCount() const
+    {
+        int count = 0;
+        foreach (const ProcessVariableValue &val, values)
+            count += val.pids.count();
+        return count;
+    }
+
+    // Partial result of the scan. Names and values are interned:
+    // PATH & co. are the same in most processes, so each distinct
+    // string is stored (and later decoded) once.
+    struct ScanAggregate
+    {
+        ScanAggregate()
+            : processCount(0), deniedCount(0) {}
+
+        int intern(const char* data, int length)
+        {
+            // Probe with a non-owning view, copy only unseen strings.
+            QByteArray view = QByteArray::fromRawData(data, length);
+            QHash<QByteArray, int>::const_iterator it = ids.constFind(view);
+            if (it != ids.constEnd())
+                return it.value();
+
+            QByteArray copy(data, length);
+            int id = strings.count();
+            strings.append(copy);
+            ids.insert(copy, id);
+            return id;
+        }
+
+        QHash<QByteArray, int> ids;
+        QVector<QByteArray> strings;
+
+        // name id -> value id -> pids
+        QHash<int, QHash<int, QVector<qint64> > > usage;
+
+        int processCount, deniedCount;
+    };
+
+    static void reduceProcess(ScanAggregate &result, const ProcessScanner::ProcessBlock &process)
+    {
+        if (!process.readable)
+        {
+            ++result.deniedCount;
+            return;
+        }
+
+        ++result.processCount;
+
+        // A name may be repeated within one block; like getenv(),
+        // the first one counts and the process is listed once.
+        QSet<int> seen;
+
+        const char* data = process.block.constData();
+        foreach (const ProcessScanner::EntryView &entry, process.entries)
+        {
+            int name = result.intern(data + entry.name, entry.nameLength);
+            if (seen.contains(name))
+                continue;
+            seen.insert(name);
+
+            int value = result.intern(data + entry.value, entry.valueLength);
+            result.usage[name][value].append(process.pid);
+        }
+    }
+
+    static QString decodeString(const QByteArray &bytes)
+    {
+#if defined(Q_OS_WIN)
+        return QString::fromUtf8(bytes);
+#else
+        return QString::fromLocal8Bit(bytes);
+#endif
+    }
+
+    static bool variableLessThan(const ProcessVariable &a, const ProcessVariable &b)
+    { return a.name < b.name; }
+
+    static bool valueLessThan(const ProcessVariableValue &a, const ProcessVariableValue &b)
+    { return a.pids.count() > b.pids.count(); }
+
+    bool ProcessScanner::isSupported()
+    {
+#if defined(Q_OS_WIN)
+        return true;
+#elif defined(Q_OS_LINUX)
+        return QDir("/proc").exists();
+#else
+        return false;
+#endif
+    }
+
+    QList<qint64> ProcessScanner::processIds()
+    {
+        QList<qint64> pids;
+
+#if defined(Q_OS_WIN)
+        HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+        if (snapshot == INVALID_HANDLE_VALUE)
+            return pids;
+
+        PROCESSENTRY32W entry;
+        entry.dwSize = sizeof(entry);
+
+        for (BOOL more = Process32FirstW(snapshot, &entry); more; more = Process32NextW(snapshot, &entry))
+            if (entry.th32ProcessID != 0) // the idle process
+                pids.append(entry.th32ProcessID);
+
+        CloseHandle(snapshot);
+#elif defined(Q_OS_LINUX)
+        foreach (const QString &entry, QDir("/proc").entryList(QDir::Dirs|QDir::NoDotAndDotDot))
+        {
+            bool isPid = false;
+            qint64 pid = entry.toLongLong(&isPid);
+            if (isPid)
+                pids.append(pid);
+        }
+#endif
+
+        return pids;
+    }
+
+    // Decodes the interned strings and sorts by name, then by the
+    // number of processes sharing a value.
+    static ProcessScanResult collect(const ScanAggregate &aggregate)
+    {
+        ProcessScanResult result;
+
+        QVector<QString> decoded(aggregate.strings.count());
+        QVector<bool> isDecoded(aggregate.strings.count(), false);
+
+        QHash<int, QHash<int, QVector<qint64> > >::const_iterator name = aggregate.usage.constBegin();
+        for (; name != aggregate.usage.constEnd(); ++name)
+        {
+            ProcessVariable var;
+            var.name = decodeString(aggregate.strings.at(name.key()));
+
+            QHash<int, QVector<qint64> >::const_iterator value = name.value().constBegin();
+            for (; value != name.value().constEnd(); ++value)
+            {
+                int id = value.key();
+                if (!isDecoded.at(id)) {
+                    decoded[id] = decodeString(aggregate.strings.at(id));
+                    isDecoded[id] = true;
+                }
+
+                ProcessVariableValue val;
+                val.value = decoded.at(id);
+                val.pids = value.value();
+                std::sort(val.pids.begin(), val.pids.end());
+                var.values.append(val);
+            }
+
+            std::sort(var.values.begin(), var.values.end(), valueLessThan);
+            result.variables.append(var);
+        }
+
+        std::sort(result.variables.begin(), result.variables.end(), variableLessThan);
+
+        result.processCount = aggregate.processCount;
+        result.deniedCount = aggregate.deniedCount;
+        return result;
+    }
+
+    static ProcessScanner::ProcessBlock parseProcess(const ProcessScanner::ProcessBlock &process)
+    {
+        ProcessScanner::ProcessBlock result = process;
+        if (result.readable)
+            result.entries = ProcessScanner::parse(result.block);
+        return result;
+    }
+
+    ProcessScanResult ProcessScanner::scan()
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        QList<qint64> pids;
+        if (isSupported())
+            pids = processIds();
+
+        ScanAggregate reduced = QtConcurrent::blockingMappedReduced(pids, &ProcessScanner::readProcess,
+                                                                    reduceProcess, QtConcurrent::UnorderedReduce);
+
+        ProcessScanResult result = collect(reduced);
+        result.elapsed = timer.elapsed();
+        return result;
+    }
+
+    ProcessScanResult ProcessScanner::aggregate(const QList<ProcessBlock> &blocks)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        ScanAggregate reduced = QtConcurrent::blockingMappedReduced(blocks, parseProcess,
+                                                                    reduceProcess, QtConcurrent::UnorderedReduce);
+
+        ProcessScanResult result = collect(reduced);
+        result.elapsed = timer.elapsed();
+        return result;
+    }
+
+    QVector<ProcessScanner::EntryView> ProcessScanner::parse(const QByteArray &block)
+    {
+        QVector<EntryView> entries;
+
+        const char* data = block.constData();
+        int size = block.size();
+        int pos = 0;
+
+        while (pos < size)
+        {
+            const char* start = data + pos;
+            const char* end = static_cast<const char*>(memchr(start, '\0', size - pos));
+            int length = end ? int(end - start) : size - pos;
+
+            // Names never start with '=' except the "=C:" style
+            // entries, so the separator is looked up from the 2nd char.
+            const char* eq = (length > 1) ? static_cast<const char*>(memchr(start + 1, '=', length - 1)) : 0;
+
+            if (eq)
+            {
+                EntryView entry;
+                entry.name = pos;
+                entry.nameLength = int(eq - start);
+                entry.value = entry.name + entry.nameLength + 1;
+                entry.valueLength = length - entry.nameLength - 1;
+                entries.append(entry);
+            }
+
+            pos += length + 1;
+        }
+
+        return entries;
+    }
+
+#if defined(Q_OS_WIN)
+    // Not in the SDK headers; looked up in ntdll.dll.
+    struct ProcessBasicInformation
+    {
+        PVOID exitStatus;
+        PVOID pebBaseAddress;
+        PVOID affinityMask;
+        PVOID basePriority;
+        ULONG_PTR uniqueProcessId;
+        PVOID parentProcessId;
+    };
+
+    typedef LONG (WINAPI *QueryInformationProcess)(HANDLE, int, PVOID, ULONG, PULONG);
+
+    static QueryInformationProcess queryInformationProcess()
+    {
+        static QueryInformationProcess query = reinterpret_cast<QueryInformationProcess>(
+                    GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtQueryInformationProcess"));
+        return query;
+    }
+
+    static bool readMemory(HANDLE process, const void* address, void* buffer, SIZE_T size)
+    {
+        SIZE_T read = 0;
+        return ReadProcessMemory(process, address, buffer, size, &read) && read == size;
+    }
+
+    // Copies the environment block out of the process as UTF-8.
+    static bool readEnvironmentBlock(HANDLE process, QByteArray *block)
+    {
+        QueryInformationProcess query = queryInformationProcess();
+        if (!query)
+            return false;
+
+        // The pointers below are only valid for our own bitness.
+        BOOL ourWow64 = FALSE, theirWow64 = FALSE;
+        if (!IsWow64Process(GetCurrentProcess(), &ourWow64) || !IsWow64Process(process, &theirWow64) ||
+            ourWow64 != theirWow64)
+            return false;
+
+        ProcessBasicInformation info;
+        if (query(process, 0 /* ProcessBasicInformation */, &info, sizeof(info), 0) != 0 || !info.pebBaseAddress)
+            return false;
+
+        // PEB.ProcessParameters, then its Environment and EnvironmentSize
+        // (Vista and later); offsets for x64 and x86.
+        const bool wide = sizeof(void*) == 8;
+        const char* peb = static_cast<const char*>(info.pebBaseAddress);
+
+        const char* parameters = 0;
+        if (!readMemory(process, peb + (wide ? 0x20 : 0x10), &parameters, sizeof(parameters)) || !parameters)
+            return false;
+
+        const void* environment = 0;
+        SIZE_T environmentSize = 0;
+        if (!readMemory(process, parameters + (wide ? 0x80 : 0x48), &environment, sizeof(environment)) ||
+            !readMemory(process, parameters + (wide ? 0x3f0 : 0x290), &environmentSize, sizeof(environmentSize)))
+            return false;
+
+        if (!environment || environmentSize == 0 || environmentSize > 64 * 1024 * 1024)
+            return false;
+
+        QVector<wchar_t> units(int(environmentSize / sizeof(wchar_t)));
+        if (!readMemory(process, environment, units.data(), units.size() * sizeof(wchar_t)))
+            return false;
+
+        *block = QString::fromWCharArray(units.constData(), units.size()).toUtf8();
+        return true;
+    }
+#endif
+
+    ProcessScanner::ProcessBlock ProcessScanner::readProcess(const qint64 &pid)
+    {
+        ProcessBlock result;
+        result.pid = pid;
+        result.readable = false;
+
+#if defined(Q_OS_WIN)
+        HANDLE process = OpenProcess(PROCESS_QUERY_INFORMATION|PROCESS_VM_READ, FALSE, DWORD(pid));
+        if (!process)
+            return result; // access denied: system and other users' processes
+
+        QByteArray block;
+        bool read = readEnvironmentBlock(process, &block);
+        CloseHandle(process);
+
+        if (!read)
+            return result;
+
+        result.readable = true;
+        result.block = block;
+        result.entries = parse(block);
+#elif defined(Q_OS_LINUX)
+        QByteArray path = "/proc/" + QByteArray::number(pid) + "/environ";
+
+        int fd = ::open(path.constData(), O_RDONLY|O_CLOEXEC);
+        if (fd < 0)
+            return result;
+
+        QByteArray block;
+        block.resize(16 * 1024);
+        int size = 0;
+
+        for (;;)
+        {
+            if (size == block.size())
+                block.resize(block.size() * 2);
+
+            ssize_t count = ::read(fd, block.data() + size, block.size() - size);
+            if (count < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+
+                ::close(fd);
+                return result; // EACCES for other users' processes
+            }
+
+            if (count == 0)
+                break;
+
+            size += int(count);
+        }
+
+        ::close(fd);
+
+        block.resize(size);
+        result.readable = true;
+        result.block = block;
+        result.entries = parse(block);
+#endif
+
+        return result;
+    }
+}
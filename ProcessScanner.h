@@ -0,0 +1,89 @@
+#ifndef PROCESSSCANNER_H
+#define PROCESSSCANNER_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// ProcessScanner reads the environment of running processes in
+// parallel and aggregates it by variable and value. On Windows the
+// block is read out of the process (PEB -> process parameters), on
+// Linux from /proc/<pid>/environ. Processes of the other bitness
+// and those we may not open are counted as denied.
+//
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <QList>
+#include <QHash>
+
+namespace EnvironmentExplorer
+{
+    struct ProcessVariableValue
+    {
+        QString value;
+        QVector<qint64> pids;
+    };
+
+    struct ProcessVariable
+    {
+        QString name;
+        QList<ProcessVariableValue> values;
+
+        // Number of processes carrying the variable.
+        int processCount() const;
+    };
+
+    struct ProcessScanResult
+    {
+        QList<ProcessVariable> variables;
+
+        int processCount;   // processes read
+        int deniedCount;    // processes which could not be read
+        qint64 elapsed;     // ms
+    };
+
+    class ProcessScanner
+    {
+    public:
+        static bool isSupported();
+
+        // Blocks until all accessible processes are read.
+        static ProcessScanResult scan();
+
+        // One NUL-separated NAME=value entry, as offsets into the block.
+        struct EntryView
+        {
+            int name, nameLength;
+            int value, valueLength;
+        };
+
+        struct ProcessBlock
+        {
+            qint64 pid;
+            bool readable;
+            QByteArray block;
+            QVector<EntryView> entries;
+        };
+
+        // Splits an environ block (UTF-8 on Windows, local 8-bit
+        // elsewhere) without copying it.
+        static QVector<EntryView> parse(const QByteArray &block);
+
+        // Aggregates blocks read elsewhere, as scan() does with those
+        // of the running processes; the entries are parsed here.
+        static ProcessScanResult aggregate(const QList<ProcessBlock> &blocks);
+
+    private:
+        static QList<qint64> processIds();
+        static ProcessBlock readProcess(const qint64 &pid);
+    };
+}
+
+#endif // PROCESSSCANNER_H
@@ -0,0 +1,210 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "RunMetrics.h"
+#include "ValueCodec.h"
+
+#include <QDateTime>
+#include <QSaveFile>
+
+#include <mutex>
+#include <string.h>
+
+namespace EnvironmentExplorer
+{
+    static const int maxOperations = 128;
+    static OperationStats table[maxOperations];
+    static int operationCount = 0;
+    static std::mutex tableMutex;
+
+    OperationTimer::OperationTimer(const char* operation)
+        : operation(operation)
+    { timer.start(); }
+
+    OperationTimer::~OperationTimer()
+    {
+        qint64 elapsed = timer.nsecsElapsed();
+
+        std::lock_guard<std::mutex> lock(tableMutex);
+
+        int i = 0;
+        while (i < operationCount && strcmp(table[i].operation, operation) != 0)
+            ++i;
+
+        if (i == operationCount)
+        {
+            if (operationCount == maxOperations)
+                return;
+
+            OperationStats stats = { operation, 0, 0, 0 };
+            table[operationCount++] = stats;
+        }
+
+        ++table[i].calls;
+        table[i].total += elapsed;
+        table[i].last = elapsed;
+    }
+
+    QList<OperationStats> RunMetrics::operations()
+    {
+        std::lock_guard<std::mutex> lock(tableMutex);
+
+        QList<OperationStats> result;
+        for (int i = 0; i < operationCount; ++i)
+            result.append(table[i]);
+        return result;
+    }
+
+    // Appends "name{label="value"} sample\n".
+    static void appendSample(QByteArray &out, const char* name, const char* label,
+                             const char* labelValue, const QByteArray &sample)
+    {
+        out.append(name);
+        if (label)
+            out.append('{').append(label).append("=\"").append(labelValue).append("\"}");
+        out.append(' ').append(sample).append('\n');
+    }
+
+    static void appendHeader(QByteArray &out, const char* name, const char* type, const char* help)
+    {
+        out.append("# HELP ").append(name).append(' ').append(help).append('\n');
+        out.append("# TYPE ").append(name).append(' ').append(type).append('\n');
+    }
+
+    static QByteArray seconds(qint64 ns)
+    { return QByteArray::number(double(ns) / 1e9, 'g', 9); }
+
+    // Entries of a value as it is kept in the tables, without unpacking.
+    static int entryCount(const QVariant &value)
+    {
+        if (value.userType() == qMetaTypeId<PathList>())
+            return static_cast<const PathList*>(value.constData())->count();
+
+        if (value.type() == QVariant::StringList)
+            return static_cast<const QStringList*>(value.constData())->count();
+
+        return 1;
+    }
+
+    static QString storedText(const QVariant &value)
+    {
+        if (value.userType() == qMetaTypeId<PathList>())
+            return static_cast<const PathList*>(value.constData())->toStringList().join(";");
+        return ValueCodec::encode(value);
+    }
+
+    // Values compared as stored; lists are only put back together
+    // when the entry counts match.
+    static bool isSameValue(const QVariant &a, const QVariant &b)
+    { return entryCount(a) == entryCount(b) && storedText(a) == storedText(b); }
+
+    bool RunMetrics::writeTextfile(const QString &fileName, const EnvironmentSnapshot &snapshot,
+                                   const EnvironmentBaseline *saved, QString *error)
+    {
+        static const char* scopes[] = { "system", "user" };
+
+        qint64 variables[2], entries[2], maxEntries[2], modified[2];
+
+        for (int scope = 0; scope < 2; ++scope)
+        {
+            Variable::Type type = Variable::Type(scope);
+            const VariableTable &base = snapshot.baselineTable(type);
+            const VariableTable &edits = snapshot.edits(type);
+
+            const VariableTable* last = 0;
+            if (saved)
+                last = (type == Variable::Global) ? &saved->globals : &saved->locals;
+
+            variables[scope] = entries[scope] = maxEntries[scope] = modified[scope] = 0;
+
+            auto count = [&](const Variable &var){
+                int n = entryCount(var.value);
+                ++variables[scope];
+                entries[scope] += n;
+                maxEntries[scope] = qMax(maxEntries[scope], qint64(n));
+
+                if (last)
+                {
+                    VariableTable::const_iterator before = last->constFind(var.name);
+                    if (before == last->constEnd() || !isSameValue(before.value().value, var.value))
+                        ++modified[scope];
+                }
+            };
+
+            // the tables are read in place, values are only put back
+            // together to be compared with the saved ones
+            VariableTable::const_iterator it = base.constBegin();
+            for (; it != base.constEnd(); ++it)
+                if (!edits.contains(it.key()))
+                    count(it.value());
+
+            for (it = edits.constBegin(); it != edits.constEnd(); ++it)
+                if (it.value().value.isValid())
+                    count(it.value());
+
+            // saved by us, removed since
+            if (last)
+                for (it = last->constBegin(); it != last->constEnd(); ++it)
+                    if (!snapshot.contains(it.key(), type))
+                        ++modified[scope];
+        }
+
+        QList<OperationStats> timings = operations();
+
+        QByteArray out;
+        out.reserve(2048 + timings.count() * 256);
+
+        appendHeader(out, "envexplorer_variables", "gauge", "Variables per scope.");
+        for (int scope = 0; scope < 2; ++scope)
+            appendSample(out, "envexplorer_variables", "scope", scopes[scope], QByteArray::number(variables[scope]));
+
+        appendHeader(out, "envexplorer_list_entries", "gauge", "Entries of all values per scope.");
+        for (int scope = 0; scope < 2; ++scope)
+            appendSample(out, "envexplorer_list_entries", "scope", scopes[scope], QByteArray::number(entries[scope]));
+
+        appendHeader(out, "envexplorer_list_entries_max", "gauge", "Entries of the longest value per scope.");
+        for (int scope = 0; scope < 2; ++scope)
+            appendSample(out, "envexplorer_list_entries_max", "scope", scopes[scope], QByteArray::number(maxEntries[scope]));
+
+        if (saved)
+        {
+            appendHeader(out, "envexplorer_modified_variables", "gauge",
+                         "Variables changed outside the program since its last save, per scope.");
+            for (int scope = 0; scope < 2; ++scope)
+                appendSample(out, "envexplorer_modified_variables", "scope", scopes[scope],
+                             QByteArray::number(modified[scope]));
+        }
+
+        appendHeader(out, "envexplorer_operation_last_seconds", "gauge", "Duration of the last call of the operation.");
+        foreach (const OperationStats &stats, timings)
+            appendSample(out, "envexplorer_operation_last_seconds", "operation", stats.operation, seconds(stats.last));
+
+        appendHeader(out, "envexplorer_operation_seconds_total", "counter", "Time spent in the operation.");
+        foreach (const OperationStats &stats, timings)
+            appendSample(out, "envexplorer_operation_seconds_total", "operation", stats.operation, seconds(stats.total));
+
+        appendHeader(out, "envexplorer_operation_calls_total", "counter", "Calls of the operation.");
+        foreach (const OperationStats &stats, timings)
+            appendSample(out, "envexplorer_operation_calls_total", "operation", stats.operation, QByteArray::number(stats.calls));
+
+        appendHeader(out, "envexplorer_run_timestamp_seconds", "gauge", "When the metrics were written.");
+        appendSample(out, "envexplorer_run_timestamp_seconds", 0, 0,
+                     QByteArray::number(QDateTime::currentMSecsSinceEpoch() / 1000));
+
+        QSaveFile file(fileName);
+        if (!file.open(QFile::WriteOnly) || file.write(out) != out.size() || !file.commit())
+        {
+            if (error)
+                *error = file.errorString();
+            return false;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef RUNMETRICS_H
+#define RUNMETRICS_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// RunMetrics times the main operations (load, parse, save, export)
+// and writes them, together with the shape of the environment, as
+// a Prometheus textfile-collector file:
+//
+//     OperationTimer timer("load_variables");
+//     ...
+//     RunMetrics::writeTextfile("envexplorer.prom", manager.snapshot(), &saved);
+//
+// Timers keep a fixed table and allocate nothing.
+//
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QList>
+
+#include "EnvironmentSnapshot.h"
+
+namespace EnvironmentExplorer
+{
+    struct OperationStats
+    {
+        const char* operation;
+        quint64 calls;
+        qint64 total;   // ns
+        qint64 last;    // ns
+    };
+
+    class OperationTimer
+    {
+        Q_DISABLE_COPY(OperationTimer)
+
+    public:
+        // The name must outlive the program (a string literal).
+        explicit OperationTimer(const char* operation);
+        ~OperationTimer();
+
+    private:
+        const char* operation;
+        QElapsedTimer timer;
+    };
+
+    class RunMetrics
+    {
+    public:
+        static QList<OperationStats> operations();
+
+        // Replaces the file at once (written aside, then renamed), so
+        // the collector never reads a half written file. Given the
+        // environment as last saved by the program (replayed from the
+        // change journal), the variables whose value differs from it
+        // are counted as modified: changed outside the program since.
+        static bool writeTextfile(const QString &fileName,
+                                  const EnvironmentSnapshot &snapshot,
+                                  const EnvironmentBaseline *saved = 0,
+                                  QString *error = 0);
+    };
+}
+
+#endif // RUNMETRICS_H
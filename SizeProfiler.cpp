@@ -0,0 +1,254 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "SizeProfiler.h"
+#include "VariablesManager.h"
+#include "ValueCodec.h"
+#include "RunMetrics.h"
+
+#include <algorithm>
+
+namespace EnvironmentExplorer
+{
+    SizeProfiler::SizeProfiler(VariablesManager* manager, QObject* parent)
+        : QObject(parent), manager(manager)
+    {
+        connect(manager, &VariablesManager::variableChanged, this, &SizeProfiler::update);
+        connect(manager, &VariablesManager::environmentReset, this, &SizeProfiler::rebuild);
+        rebuild();
+    }
+
+    void SizeProfiler::rebuild()
+    {
+        OperationTimer timer("profile_sizes");
+
+        stats.clear();
+        entriesOf.clear();
+        holders.clear();
+        bytes[Variable::Global] = bytes[Variable::User] = 0;
+
+        EnvironmentSnapshot snapshot = manager->snapshot();
+
+        for (int scope = Variable::Global; scope <= Variable::User; ++scope)
+            foreach (const Variable &var, snapshot.environment(Variable::Type(scope)))
+                add(Variable::key(var.name, var.type), var);
+
+        emit changed();
+    }
+
+    void SizeProfiler::update(const QString &name, Variable::Type type)
+    {
+        OperationTimer timer("profile_variable");
+
+        QString key = Variable::key(name, type);
+        remove(key);
+
+        Variable var;
+        if (manager->snapshot().lookup(name, type, &var))
+            add(key, var);
+
+        emit changed();
+    }
+
+    void SizeProfiler::add(const QString &key, const Variable &var)
+    {
+        QString value = ValueCodec::encode(var.value);
+
+        QStringList entries;
+        foreach (const QString &entry, ValueCodec::entries(var.value))
+            if (!entry.isEmpty())
+                entries.append(entry);
+
+        VariableStats s;
+        s.name = var.name;
+        s.type = var.type;
+        s.bytes = (var.name.size() + 1 + value.size() + 1) * 2;
+        s.length = value.size();
+        s.entries = entries.count();
+        s.duplicates = 0;
+        s.edits = 0;
+
+        stats.insert(key, s);
+        entriesOf.insert(key, entries);
+        bytes[var.type] += s.bytes;
+
+        foreach (const QString &entry, entries)
+            addEntry(entry, key);
+    }
+
+    void SizeProfiler::remove(const QString &key)
+    {
+        QHash<QString, VariableStats>::iterator it = stats.find(key);
+        if (it == stats.end())
+            return;
+
+        foreach (const QString &entry, entriesOf.take(key))
+            removeEntry(entry, key);
+
+        bytes[it.value().type] -= it.value().bytes;
+        stats.erase(it);
+    }
+
+    void SizeProfiler::addEntry(const QString &entry, const QString &key)
+    {
+        QVector<QString> &keys = holders[entry];
+        keys.append(key);
+
+        // the first holder turns duplicate only now
+        if (keys.count() == 2)
+            ++stats[keys.first()].duplicates;
+        if (keys.count() >= 2)
+            ++stats[key].duplicates;
+    }
+
+    void SizeProfiler::removeEntry(const QString &entry, const QString &key)
+    {
+        QHash<QString, QVector<QString> >::iterator it = holders.find(entry);
+        if (it == holders.end())
+            return;
+
+        QVector<QString> &keys = it.value();
+        int count = keys.count();
+        keys.remove(keys.indexOf(key));
+
+        if (count >= 2)
+            --stats[key].duplicates;
+        if (count == 2)
+            --stats[keys.first()].duplicates;
+
+        if (keys.isEmpty())
+            holders.erase(it);
+    }
+
+    static qint64 rankValue(const VariableStats &s, SizeProfiler::Ranking ranking)
+    {
+        switch (ranking)
+        {
+            case SizeProfiler::ByEntries:       return s.entries;
+            case SizeProfiler::ByDuplication:   return s.duplicates;
+            case SizeProfiler::ByEdits:         return s.edits;
+            default:                            return s.bytes;
+        }
+    }
+
+    QList<VariableStats> SizeProfiler::top(Ranking ranking, int count) const
+    {
+        const QHash<QString, quint32> &counts = manager->editCounts();
+        QVector<VariableStats> candidates;
+
+        if (ranking == ByEdits)
+        {
+            // only the edited ones, removed variables included
+            candidates.reserve(counts.count());
+
+            QHash<QString, quint32>::const_iterator it = counts.constBegin();
+            for (; it != counts.constEnd(); ++it)
+            {
+                VariableStats s = stats.value(it.key());
+                if (!stats.contains(it.key()))
+                {
+                    s.name = Variable::nameOfKey(it.key());
+                    s.type = Variable::typeOfKey(it.key());
+                    s.bytes = s.length = s.entries = s.duplicates = 0;
+                }
+                s.edits = it.value();
+                candidates.append(s);
+            }
+        }
+        else
+        {
+            candidates.reserve(stats.count());
+            foreach (const VariableStats &s, stats)
+                candidates.append(s);
+        }
+
+        int n = qMin(count, candidates.count());
+
+        std::partial_sort(candidates.begin(), candidates.begin() + n, candidates.end(),
+                          [ranking](const VariableStats &a, const VariableStats &b){
+            qint64 x = rankValue(a, ranking), y = rankValue(b, ranking);
+            return (x != y) ? x > y : a.name < b.name;
+        });
+
+        QList<VariableStats> result;
+        for (int i = 0; i < n; ++i)
+        {
+            VariableStats s = candidates.at(i);
+            s.edits = counts.value(Variable::key(s.name, s.type));
+            result.append(s);
+        }
+
+        return result;
+    }
+
+    QList<EntryStats> SizeProfiler::topEntries(int count) const
+    {
+        QVector<EntryStats> candidates;
+        candidates.reserve(holders.count());
+
+        QHash<QString, QVector<QString> >::const_iterator it = holders.constBegin();
+        for (; it != holders.constEnd(); ++it)
+        {
+            EntryStats e;
+            e.entry = it.key();
+            e.occurrences = it.value().count();
+            e.bytes = qint64(e.occurrences) * (e.entry.size() + 1) * 2;
+            candidates.append(e);
+        }
+
+        int n = qMin(count, candidates.count());
+
+        std::partial_sort(candidates.begin(), candidates.begin() + n, candidates.end(),
+                          [](const EntryStats &a, const EntryStats &b){
+            if (a.occurrences != b.occurrences)
+                return a.occurrences > b.occurrences;
+            return (a.bytes != b.bytes) ? a.bytes > b.bytes : a.entry < b.entry;
+        });
+
+        return candidates.mid(0, n).toList();
+    }
+
+    QString SizeProfiler::report(int count) const
+    {
+        QString out;
+        out += QString("Environment: %1 variable(s), system block %2 bytes, user block %3 bytes\n")
+               .arg(variableCount()).arg(bytes[Variable::Global]).arg(bytes[Variable::User]);
+
+        static const char* titles[] = { "Largest variables", "Most entries",
+                                        "Most entries found elsewhere", "Most edited" };
+
+        for (int r = BySize; r <= ByEdits; ++r)
+        {
+            out += QString("\n%1:\n").arg(titles[r]);
+
+            foreach (const VariableStats &s, top(Ranking(r), count))
+            {
+                if (rankValue(s, Ranking(r)) == 0)
+                    break;
+
+                out += QString("%1  %2 (%3)").arg(rankValue(s, Ranking(r)), 8).arg(s.name)
+                       .arg(s.type == Variable::Global ? "system" : "user");
+
+                if (r == BySize)
+                    out += QString(", %1% of the value limit").arg(s.length * 100 / maxValueLength);
+                out += "\n";
+            }
+        }
+
+        out += "\nRepeated entries:\n";
+        foreach (const EntryStats &e, topEntries(count))
+        {
+            if (e.occurrences < 2)
+                break;
+            out += QString("%1  %2\n").arg(e.occurrences, 8).arg(e.entry);
+        }
+
+        return out;
+    }
+}
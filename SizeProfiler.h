@@ -0,0 +1,109 @@
+#ifndef SIZEPROFILER_H
+#define SIZEPROFILER_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// SizeProfiler tells which variables make the environment block
+// big and which are edited most: per variable its size in the block,
+// entries, entries found elsewhere too, and edits this session.
+// It follows VariablesManager; a change only takes the old values
+// of the one variable out and puts the new ones in. Rankings sort
+// just the top of the list.
+//
+
+#include <QObject>
+#include <QVector>
+#include <QString>
+#include <QHash>
+#include <QList>
+
+#include "EnvironmentSnapshot.h"
+
+namespace EnvironmentExplorer
+{
+    class VariablesManager;
+
+    struct VariableStats
+    {
+        QString name;
+        Variable::Type type;
+
+        int bytes;          // "NAME=value\0" in UTF-16, as in the block
+        int length;         // of the value, in characters
+        int entries;
+        int duplicates;     // entries also found elsewhere
+        quint32 edits;
+    };
+
+    struct EntryStats
+    {
+        QString entry;
+        int occurrences;
+        qint64 bytes;       // taken by all occurrences
+    };
+
+    class SizeProfiler : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        enum Ranking { BySize, ByEntries, ByDuplication, ByEdits };
+
+        // Longest value Windows takes, in characters.
+        static const int maxValueLength = 32767;
+
+        SizeProfiler(VariablesManager* manager, QObject* parent = 0);
+
+        // The first count variables, largest first.
+        QList<VariableStats> top(Ranking ranking, int count) const;
+
+        // Entries found most often, in any variable.
+        QList<EntryStats> topEntries(int count) const;
+
+        qint64 blockBytes(Variable::Type type) const
+        { return bytes[type]; }
+
+        int variableCount() const
+        { return stats.count(); }
+
+        QString report(int count = 50) const;
+
+    public slots:
+        void rebuild();
+
+    signals:
+        void changed();
+
+    private slots:
+        void update(const QString &name, Variable::Type type);
+
+    private:
+        void add(const QString &key, const Variable &var);
+        void remove(const QString &key);
+
+        void addEntry(const QString &entry, const QString &key);
+        void removeEntry(const QString &entry, const QString &key);
+
+        VariablesManager* manager;
+
+        // Variable::key() -> statistics
+        QHash<QString, VariableStats> stats;
+
+        // the entries of each variable, to take them out again
+        QHash<QString, QStringList> entriesOf;
+
+        // entry -> keys of the variables holding it (once per occurrence)
+        QHash<QString, QVector<QString> > holders;
+
+        qint64 bytes[2];
+    };
+}
+
+#endif // SIZEPROFILER_H
@@ -0,0 +1,113 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "StartupProfiler.h"
+
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QWidget>
+#include <QTimer>
+#include <QEvent>
+#include <QList>
+#include <QPair>
+
+#if defined(Q_OS_WIN)
+#include <qt_windows.h>
+#endif
+
+namespace EnvironmentExplorer
+{
+    static QElapsedTimer timer;
+
+    // time between process creation and start()
+    static qint64 offset = 0;
+    static bool fromProcessStart = false;
+
+    static QList<QPair<QString, qint64> > marks;
+
+    void StartupProfiler::start()
+    {
+        timer.start();
+
+#if defined(Q_OS_WIN)
+        FILETIME creation, exit, kernel, user, now;
+        if (GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        {
+            GetSystemTimeAsFileTime(&now);
+
+            ULARGE_INTEGER from, to;
+            from.LowPart = creation.dwLowDateTime;
+            from.HighPart = creation.dwHighDateTime;
+            to.LowPart = now.dwLowDateTime;
+            to.HighPart = now.dwHighDateTime;
+
+            offset = qint64(to.QuadPart - from.QuadPart) / 10000; // 100 ns units
+            fromProcessStart = true;
+        }
+#endif
+
+        mark("main");
+    }
+
+    void StartupProfiler::mark(const char* stage)
+    { marks.append(qMakePair(QString::fromLatin1(stage), elapsed())); }
+
+    qint64 StartupProfiler::elapsed()
+    { return timer.isValid() ? offset + timer.elapsed() : 0; }
+
+    // Watches the first paint, then waits for the event loop to be idle.
+    class StartupWatcher : public QObject
+    {
+    public:
+        StartupWatcher(QWidget* window, bool print)
+            : QObject(window), print(print) {}
+
+        bool eventFilter(QObject *obj, QEvent *e)
+        {
+            if (e->type() == QEvent::Paint)
+            {
+                obj->removeEventFilter(this);
+                StartupProfiler::mark("first paint");
+
+                // runs once everything queued up to now is processed
+                QTimer::singleShot(0, this, [this](){
+                    interactive();
+                    deleteLater();
+                });
+            }
+
+            return false;
+        }
+
+    private:
+        void interactive()
+        {
+            StartupProfiler::mark("interactive");
+            if (print)
+                QTextStream(stderr) << StartupProfiler::report();
+        }
+
+        bool print;
+    };
+
+    void StartupProfiler::watch(QWidget *window, bool print)
+    { window->installEventFilter(new StartupWatcher(window, print)); }
+
+    QString StartupProfiler::report()
+    {
+        QString out = fromProcessStart ? QString("Startup (ms since process start):\n")
+                                       : QString("Startup (ms since main):\n");
+
+        typedef QPair<QString, qint64> Mark;
+        foreach (const Mark &mark, marks)
+            out += QString("%1  %2\n").arg(mark.second, 8).arg(mark.first);
+
+        return out;
+    }
+}
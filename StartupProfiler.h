@@ -0,0 +1,44 @@
+#ifndef STARTUPPROFILER_H
+#define STARTUPPROFILER_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// StartupProfiler records how long the start takes: named marks
+// from process start (from main() where the creation time of the
+// process is not known), up to the first paint of the main window
+// and the first idle turn of the event loop after it (interactive).
+//
+
+#include <QString>
+
+class QWidget;
+
+namespace EnvironmentExplorer
+{
+    class StartupProfiler
+    {
+    public:
+        // First thing in main().
+        static void start();
+
+        static void mark(const char* stage);
+
+        // ms since the process was created
+        static qint64 elapsed();
+
+        // Marks "first paint" and "interactive" for the window;
+        // prints the report to stderr then, if asked to.
+        static void watch(QWidget* window, bool print);
+
+        static QString report();
+    };
+}
+
+#endif // STARTUPPROFILER_H
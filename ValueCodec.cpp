@@ -0,0 +1,110 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "ValueCodec.h"
+
+namespace EnvironmentExplorer
+{
+    QVector<ValueSpan> ValueCodec::tokenize(const QString &raw)
+    {
+        QVector<ValueSpan> spans;
+
+        const QChar* data = raw.constData();
+        int size = raw.size();
+        int start = 0;
+        bool inQuotes = false, quoted = false;
+
+        for (int i = 0; i < size; ++i)
+        {
+            ushort c = data[i].unicode();
+
+            if (c == '"')
+            {
+                inQuotes = !inQuotes;
+                quoted = true;
+            }
+            else if (c == ';' && !inQuotes)
+            {
+                ValueSpan span = { start, i - start, quoted };
+                spans.append(span);
+                start = i + 1;
+                quoted = false;
+            }
+        }
+
+        // An unterminated quote runs to the end of the value.
+        ValueSpan span = { start, size - start, quoted };
+        spans.append(span);
+        return spans;
+    }
+
+    QVariant ValueCodec::decode(const QString &raw)
+    {
+        QVector<ValueSpan> spans = tokenize(raw);
+
+        if (spans.count() == 1)
+            return raw;
+
+        QStringList list;
+        list.reserve(spans.count());
+
+        foreach (const ValueSpan &span, spans)
+            list.append(raw.mid(span.offset, span.length));
+
+        return list;
+    }
+
+    QString ValueCodec::encode(const QVariant &value)
+    {
+        if (!isList(value))
+            return value.toString();
+
+        // Entries keep their quotes, nothing to escape here.
+        return value.toStringList().join(";");
+    }
+
+    QStringList ValueCodec::entries(const QVariant &value)
+    {
+        if (isList(value))
+            return value.toStringList();
+
+        if (!value.isValid())
+            return QStringList();
+
+        return QStringList(value.toString());
+    }
+
+    bool ValueCodec::isBlank(const QVariant &value)
+    {
+        if (!isList(value))
+            return value.toString().isEmpty();
+
+        foreach (const QString &entry, value.toStringList())
+            if (!entry.isEmpty())
+                return false;
+
+        return true;
+    }
+
+    QString ValueCodec::unquote(const QString &entry)
+    {
+        if (!entry.contains('"'))
+            return entry;
+
+        QString result = entry;
+        result.remove('"');
+        return result;
+    }
+
+    bool ValueCodec::hasReferences(const QString &raw)
+    {
+        int start = raw.indexOf('%');
+        return start >= 0 && raw.indexOf('%', start + 2) > 0;
+    }
+}
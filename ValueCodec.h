@@ -0,0 +1,61 @@
+#ifndef VALUECODEC_H
+#define VALUECODEC_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// ValueCodec converts between the stored form of a value
+// ("a;b;c" as in the registry) and its typed form (QString or
+// QStringList). Entries keep their quotes as written, so that
+// decode() followed by encode() gives back the same string.
+//
+
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+namespace EnvironmentExplorer
+{
+    // One entry of a list value, quotes included.
+    struct ValueSpan
+    {
+        int offset, length;
+        bool quoted;
+    };
+
+    class ValueCodec
+    {
+    public:
+        // Splits at ';' outside of "double quotes", in one pass.
+        static QVector<ValueSpan> tokenize(const QString &raw);
+
+        // A single entry stays a QString, more become a QStringList.
+        static QVariant decode(const QString &raw);
+
+        static QString encode(const QVariant &value);
+
+        // Entries of the value (a string is a single entry).
+        static QStringList entries(const QVariant &value);
+
+        // True when the value has no non-empty entry.
+        static bool isBlank(const QVariant &value);
+
+        // Removes the quotes around an entry.
+        static QString unquote(const QString &entry);
+
+        // Whether the string refers to other variables (%NAME%),
+        // such values are stored as REG_EXPAND_SZ.
+        static bool hasReferences(const QString &raw);
+
+        static bool isList(const QVariant &value)
+        { return value.type() == QVariant::StringList; }
+    };
+}
+
+#endif // VALUECODEC_H
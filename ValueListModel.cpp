@@ -0,0 +1,165 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "ValueListModel.h"
+
+#include <algorithm>
+
+namespace EnvironmentExplorer
+{
+    static inline bool isBlank(const QString &str)
+    { return str.trimmed().isEmpty(); }
+
+    ValueListModel::ValueListModel(QObject *parent)
+        : QAbstractListModel(parent), nonEmpty(0)
+    {}
+
+    int ValueListModel::rowCount(const QModelIndex &parent) const
+    {
+        if (parent.isValid())
+            return 0;
+
+        // entries + "Add new value..." row
+        return values.count() + 1;
+    }
+
+    QVariant ValueListModel::data(const QModelIndex &index, int role) const
+    {
+        if (!index.isValid() || index.row() > values.count())
+            return QVariant();
+
+        if (role != Qt::DisplayRole && role != Qt::EditRole)
+            return QVariant();
+
+        if (isPlaceholder(index))
+            return (role == Qt::DisplayRole) ? QVariant(QString("Add new value...")) : QVariant();
+
+        return values.at(index.row());
+    }
+
+    bool ValueListModel::setData(const QModelIndex &index, const QVariant &value, int role)
+    {
+        if (role != Qt::EditRole || !index.isValid() || index.row() >= values.count())
+            return false;
+
+        QString &entry = values[index.row()];
+        QString text = value.toString();
+
+        int count = nonEmpty;
+        count += (isBlank(entry) ? 0 : -1) + (isBlank(text) ? 0 : 1);
+
+        entry = text;
+        emit dataChanged(index, index);
+        updateNonEmpty(count);
+        return true;
+    }
+
+    Qt::ItemFlags ValueListModel::flags(const QModelIndex &index) const
+    {
+        if (!index.isValid())
+            return Qt::NoItemFlags;
+
+        if (isPlaceholder(index))
+            return Qt::ItemIsEnabled|Qt::ItemIsSelectable;
+
+        return Qt::ItemIsEnabled|Qt::ItemIsSelectable|Qt::ItemIsEditable;
+    }
+
+    bool ValueListModel::removeRows(int row, int count, const QModelIndex &parent)
+    {
+        if (parent.isValid() || row < 0 || count <= 0 || row + count > values.count())
+            return false;
+
+        int filled = 0;
+        for (int i = row; i < row + count; ++i)
+            if (!isBlank(values.at(i)))
+                ++filled;
+
+        beginRemoveRows(QModelIndex(), row, row + count - 1);
+        values.erase(values.begin() + row, values.begin() + row + count);
+        endRemoveRows();
+
+        updateNonEmpty(nonEmpty - filled);
+        return true;
+    }
+
+    void ValueListModel::setEntries(const QStringList &list)
+    {
+        int count = 0;
+        foreach (const QString &entry, list)
+            if (!isBlank(entry))
+                ++count;
+
+        beginResetModel();
+        values = list;
+        endResetModel();
+
+        updateNonEmpty(count);
+    }
+
+    void ValueListModel::insertEntries(int row, const QStringList &list)
+    {
+        if (list.isEmpty())
+            return;
+
+        row = qBound(0, row, values.count());
+
+        int count = nonEmpty;
+        foreach (const QString &entry, list)
+            if (!isBlank(entry))
+                ++count;
+
+        beginInsertRows(QModelIndex(), row, row + list.count() - 1);
+
+        QStringList merged = values.mid(0, row);
+        merged.reserve(values.count() + list.count());
+        merged.append(list);
+        merged.append(values.mid(row));
+        values = merged;
+
+        endInsertRows();
+
+        updateNonEmpty(count);
+    }
+
+    void ValueListModel::removeEntries(const QModelIndexList &indexes)
+    {
+        QList<int> rows;
+        foreach (const QModelIndex &index, indexes)
+            if (index.isValid() && !isPlaceholder(index))
+                rows.append(index.row());
+
+        if (rows.isEmpty())
+            return;
+
+        std::sort(rows.begin(), rows.end());
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+        // Remove from the back so that the row numbers stay valid.
+        int last = rows.count() - 1;
+        while (last >= 0)
+        {
+            int first = last;
+            while (first > 0 && rows.at(first - 1) == rows.at(first) - 1)
+                --first;
+
+            removeRows(rows.at(first), rows.at(last) - rows.at(first) + 1);
+            last = first - 1;
+        }
+    }
+
+    void ValueListModel::updateNonEmpty(int count)
+    {
+        if (count == nonEmpty)
+            return;
+
+        nonEmpty = count;
+        emit nonEmptyCountChanged(nonEmpty);
+    }
+}
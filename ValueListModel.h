@@ -0,0 +1,68 @@
+#ifndef VALUELISTMODEL_H
+#define VALUELISTMODEL_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// ValueListModel holds entries of a multi-value variable for the editor.
+// The last row is a placeholder used to append a new entry.
+//
+
+#include <QAbstractListModel>
+#include <QStringList>
+
+namespace EnvironmentExplorer
+{
+    class ValueListModel : public QAbstractListModel
+    {
+        Q_OBJECT
+
+    public:
+        ValueListModel(QObject* parent = 0);
+
+        int rowCount(const QModelIndex &parent = QModelIndex()) const;
+        QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+        bool setData(const QModelIndex &index, const QVariant &value,
+                     int role = Qt::EditRole);
+        Qt::ItemFlags flags(const QModelIndex &index) const;
+        bool removeRows(int row, int count,
+                        const QModelIndex &parent = QModelIndex());
+
+        // Replaces all entries at once (single model reset).
+        void setEntries(const QStringList &list);
+        QStringList entries() const
+        { return values; }
+
+        // Inserts entries before the given row in one operation.
+        void insertEntries(int row, const QStringList &list);
+
+        // Removes the given rows, grouped into contiguous ranges.
+        void removeEntries(const QModelIndexList &indexes);
+
+        bool isPlaceholder(const QModelIndex &index) const
+        { return index.isValid() && index.row() == values.count(); }
+
+        int nonEmptyCount() const
+        { return nonEmpty; }
+
+    signals:
+        void nonEmptyCountChanged(int count);
+
+    private:
+        void updateNonEmpty(int count);
+
+        QStringList values;
+
+        // Number of entries which are not blank, kept up to date
+        // on every insert, edit and removal.
+        int nonEmpty;
+    };
+}
+
+#endif // VALUELISTMODEL_H
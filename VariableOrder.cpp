@@ -0,0 +1,164 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "VariableOrder.h"
+#include "ValueCodec.h"
+#include "RunMetrics.h"
+
+#include <algorithm>
+
+namespace EnvironmentExplorer
+{
+    VariableOrder::VariableOrder()
+        : field(Name), order(Qt::AscendingOrder), grouping(NoGroups)
+    {}
+
+    void VariableOrder::setSorting(Field field, Qt::SortOrder order)
+    {
+        this->field = field;
+        this->order = order;
+    }
+
+    void VariableOrder::setGrouping(Grouping grouping)
+    { this->grouping = grouping; }
+
+    // Packed lists (baseline values) are measured in the trie, so a
+    // rebuild does not put every entry back together.
+    static qint64 valueLength(const QVariant &value)
+    {
+        if (value.userType() == qMetaTypeId<PathList>())
+            return value.value<PathList>().length();
+        return ValueCodec::encode(value).length();
+    }
+
+    static qint64 entryCount(const QVariant &value)
+    {
+        if (value.userType() == qMetaTypeId<PathList>())
+            return value.value<PathList>().count();
+        return ValueCodec::entries(value).count();
+    }
+
+    OrderEntry VariableOrder::entry(const Variable &var, bool modified) const
+    {
+        OrderEntry e;
+        e.name = var.name;
+        e.type = var.type;
+
+        // modified ones first, in both
+        switch (grouping)
+        {
+            case GroupByScope:      e.group = var.type; break;
+            case GroupByModified:   e.group = modified ? 0 : 1; break;
+            default:                e.group = 0; break;
+        }
+
+        switch (field)
+        {
+            case Scope:     e.key = var.type; break;
+            case Length:    e.key = valueLength(var.value); break;
+            case Entries:   e.key = entryCount(var.value); break;
+            case Modified:  e.key = modified ? 0 : 1; break;
+            default:        e.key = 0; break;
+        }
+
+        return e;
+    }
+
+    bool VariableOrder::lessThan(const OrderEntry &a, const OrderEntry &b) const
+    {
+        if (a.group != b.group)
+            return a.group < b.group;
+
+        // names break ties, so that the order is total and a
+        // variable is found again by a binary search
+        int cmp = (a.key < b.key) ? -1 : (a.key > b.key) ? 1 : 0;
+        if (cmp == 0)
+            cmp = QString::compare(a.name, b.name, Qt::CaseInsensitive);
+        if (cmp == 0)
+            cmp = QString::compare(a.name, b.name, Qt::CaseSensitive);
+        if (cmp == 0)
+            cmp = int(a.type) - int(b.type);
+
+        return (order == Qt::AscendingOrder) ? cmp < 0 : cmp > 0;
+    }
+
+    void VariableOrder::rebuild(const EnvironmentSnapshot &snapshot)
+    {
+        OperationTimer timer("sort_variables");
+
+        rows.clear();
+        placed.clear();
+
+        auto place = [this](const Variable &var, bool modified){
+            OrderEntry e = entry(var, modified);
+            rows.append(e);
+            placed.insert(Variable::key(var.name, var.type), e);
+        };
+
+        // As EnvironmentSnapshot::environment(), with the baseline
+        // values left packed.
+        for (int scope = Variable::Global; scope <= Variable::User; ++scope)
+        {
+            const VariableTable &base = snapshot.baselineTable(Variable::Type(scope));
+            const VariableTable &edits = snapshot.edits(Variable::Type(scope));
+
+            VariableTable::const_iterator it = base.constBegin();
+            for (; it != base.constEnd(); ++it)
+                if (!edits.contains(it.key()))
+                    place(it.value(), false);
+
+            for (it = edits.constBegin(); it != edits.constEnd(); ++it)
+                if (it.value().value.isValid())
+                    place(it.value(), true);
+        }
+
+        std::sort(rows.begin(), rows.end(), [this](const OrderEntry &a, const OrderEntry &b){
+            return lessThan(a, b);
+        });
+    }
+
+    void VariableOrder::update(const EnvironmentSnapshot &snapshot, const QString &name,
+                               Variable::Type type, int *from, int *to)
+    {
+        auto less = [this](const OrderEntry &a, const OrderEntry &b){ return lessThan(a, b); };
+
+        *from = indexOf(name, type);
+        *to = -1;
+
+        if (*from >= 0)
+            rows.remove(*from);
+
+        QString key = Variable::key(name, type);
+
+        Variable var;
+        if (!snapshot.lookup(name, type, &var))
+        {
+            placed.remove(key);
+            return;
+        }
+
+        OrderEntry e = entry(var, snapshot.isModified(name, type));
+        *to = std::lower_bound(rows.begin(), rows.end(), e, less) - rows.begin();
+
+        rows.insert(*to, e);
+        placed.insert(key, e);
+    }
+
+    int VariableOrder::indexOf(const QString &name, Variable::Type type) const
+    {
+        QHash<QString, OrderEntry>::const_iterator it = placed.constFind(Variable::key(name, type));
+        if (it == placed.constEnd())
+            return -1;
+
+        QVector<OrderEntry>::const_iterator row = std::lower_bound(rows.begin(), rows.end(), it.value(),
+            [this](const OrderEntry &a, const OrderEntry &b){ return lessThan(a, b); });
+
+        return (row == rows.end()) ? -1 : int(row - rows.begin());
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef VARIABLEORDER_H
+#define VARIABLEORDER_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// VariableOrder keeps the rows of the variable table in order: by
+// group (scope or modified state) first, then by the sort field.
+// It is sorted once, then each change moves a single variable to its
+// place with binary searches:
+//
+//     order.rebuild(snapshot);
+//     ...
+//     int from, to;
+//     order.update(snapshot, name, type, &from, &to);
+//
+
+#include <QVector>
+#include <QString>
+#include <QHash>
+
+#include "EnvironmentSnapshot.h"
+
+namespace EnvironmentExplorer
+{
+    struct OrderEntry
+    {
+        QString name;
+        Variable::Type type;
+
+        int group;
+        qint64 key;     // value of the sort field, 0 when by name
+    };
+
+    class VariableOrder
+    {
+    public:
+        enum Field { Name, Scope, Length, Entries, Modified };
+        enum Grouping { NoGroups, GroupByScope, GroupByModified };
+
+        VariableOrder();
+
+        // Both take effect with the next rebuild().
+        void setSorting(Field field, Qt::SortOrder order = Qt::AscendingOrder);
+        void setGrouping(Grouping grouping);
+
+        void rebuild(const EnvironmentSnapshot &snapshot);
+
+        // Moves the variable to where it belongs now; from and to are
+        // its old and new rows (-1 when it was not there or is gone).
+        void update(const EnvironmentSnapshot &snapshot, const QString &name,
+                    Variable::Type type, int *from, int *to);
+
+        int count() const
+        { return rows.count(); }
+
+        const OrderEntry &at(int row) const
+        { return rows.at(row); }
+
+        int indexOf(const QString &name, Variable::Type type) const;
+
+    private:
+        OrderEntry entry(const Variable &var, bool modified) const;
+        bool lessThan(const OrderEntry &a, const OrderEntry &b) const;
+
+        Field field;
+        Qt::SortOrder order;
+        Grouping grouping;
+
+        QVector<OrderEntry> rows;
+
+        // Entries as placed, to find a row without scanning.
+        QHash<QString, OrderEntry> placed;
+    };
+}
+
+#endif // VARIABLEORDER_H
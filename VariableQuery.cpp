@@ -0,0 +1,582 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include "VariableQuery.h"
+#include "ValueCodec.h"
+
+#include <QtConcurrent/QtConcurrentFilter>
+#include <QRegularExpression>
+#include <QStringList>
+
+#include <algorithm>
+
+namespace EnvironmentExplorer
+{
+    // Below this the thread pool costs more than it saves.
+    static const int parallelThreshold = 8192;
+
+    struct QueryNode
+    {
+        virtual ~QueryNode() {}
+
+        virtual bool matches(const Variable &var,
+                             const EnvironmentSnapshot &snapshot) const = 0;
+
+        // Rough evaluation cost, used to order AND/OR operands.
+        virtual int cost() const = 0;
+    };
+
+    typedef QSharedPointer<QueryNode> NodePointer;
+
+    static bool costLessThan(const NodePointer &a, const NodePointer &b)
+    { return a->cost() < b->cost(); }
+
+    struct AndNode : QueryNode
+    {
+        bool matches(const Variable &var, const EnvironmentSnapshot &snapshot) const
+        {
+            foreach (const NodePointer &node, nodes)
+                if (!node->matches(var, snapshot))
+                    return false;
+            return true;
+        }
+
+        int cost() const
+        {
+            int sum = 0;
+            foreach (const NodePointer &node, nodes)
+                sum += node->cost();
+            return sum;
+        }
+
+        QList<NodePointer> nodes;
+    };
+
+    struct OrNode : AndNode
+    {
+        bool matches(const Variable &var, const EnvironmentSnapshot &snapshot) const
+        {
+            foreach (const NodePointer &node, nodes)
+                if (node->matches(var, snapshot))
+                    return true;
+            return false;
+        }
+    };
+
+    struct NotNode : QueryNode
+    {
+        bool matches(const Variable &var, const EnvironmentSnapshot &snapshot) const
+        { return !node->matches(var, snapshot); }
+
+        int cost() const
+        { return node->cost(); }
+
+        NodePointer node;
+    };
+
+    struct ScopeNode : QueryNode
+    {
+        bool matches(const Variable &var, const EnvironmentSnapshot &) const
+        { return var.type == type; }
+
+        int cost() const
+        { return 1; }
+
+        Variable::Type type;
+    };
+
+    struct FlagNode : QueryNode
+    {
+        enum Flag { Modified, Expandable };
+
+        bool matches(const Variable &var, const EnvironmentSnapshot &snapshot) const
+        {
+            bool set = (flag == Modified) ? snapshot.isModified(var.name, var.type) : var.expandable;
+            return set == expected;
+        }
+
+        int cost() const
+        { return (flag == Modified) ? 3 : 1; }
+
+        Flag flag;
+        bool expected;
+    };
+
+    struct NumberNode : QueryNode
+    {
+        enum Field { Entries, Length };
+        enum Op { Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual };
+
+        static qint64 length(const QVariant &value)
+        {
+            if (value.type() != QVariant::StringList)
+                return value.toString().size();
+
+            QStringList entries = value.toStringList();
+            qint64 sum = qMax(0, entries.count() - 1); // separators
+            foreach (const QString &entry, entries)
+                sum += entry.size();
+            return sum;
+        }
+
+        bool matches(const Variable &var, const EnvironmentSnapshot &) const
+        {
+            qint64 actual = (field == Entries) ? ValueCodec::entries(var.value).count()
+                                               : length(var.value);
+            switch (op) {
+            case Less:         return actual < number;
+            case LessEqual:    return actual <= number;
+            case Greater:      return actual > number;
+            case GreaterEqual: return actual >= number;
+            case Equal:        return actual == number;
+            case NotEqual:     return actual != number;
+            }
+            return false;
+        }
+
+        int cost() const
+        { return (field == Entries) ? 2 : 4; }
+
+        Field field;
+        Op op;
+        qint64 number;
+    };
+
+    struct TextNode : QueryNode
+    {
+        enum Field { Name, Value, Any };
+        enum Op { Contains, Equals, Matches };
+
+        bool test(const QString &text) const
+        {
+            switch (op) {
+            case Contains: return text.contains(pattern, Qt::CaseInsensitive);
+            case Equals:   return text.compare(pattern, Qt::CaseInsensitive) == 0;
+            case Matches:  return regex.match(text).hasMatch();
+            }
+            return false;
+        }
+
+        // Lists match when any of their entries does.
+        bool testValue(const QVariant &value) const
+        {
+            if (value.type() != QVariant::StringList)
+                return test(value.toString());
+
+            foreach (const QString &entry, value.toStringList())
+                if (test(entry))
+                    return true;
+            return false;
+        }
+
+        bool matches(const Variable &var, const EnvironmentSnapshot &) const
+        {
+            if (field != Value && test(var.name))
+                return true;
+
+            return field != Name && testValue(var.value);
+        }
+
+        int cost() const
+        {
+            int base = (op == Matches) ? 20 : 5;
+            return (field == Name) ? base : base * 4;
+        }
+
+        Field field;
+        Op op;
+        QString pattern;
+        QRegularExpression regex;
+    };
+
+    // Recursive descent parser:
+    //   expr  := and ("or" and)*
+    //   and   := unary+
+    //   unary := ("not" | "-") unary | "(" expr ")" | term
+    class QueryParser
+    {
+    public:
+        QueryParser(const QString &text)
+            : text(text), pos(0) {}
+
+        NodePointer parse(QString &error)
+        {
+            NodePointer node = parseOr();
+            skipSpace();
+
+            if (node && pos < text.size())
+                fail(QString("Unexpected '%1'.").arg(text.at(pos)));
+
+            error = this->error;
+            return this->error.isEmpty() ? node : NodePointer();
+        }
+
+    private:
+        void fail(const QString &message)
+        {
+            if (error.isEmpty())
+                error = QString("%1 (at %2)").arg(message).arg(pos + 1);
+        }
+
+        void skipSpace()
+        {
+            while (pos < text.size() && text.at(pos).isSpace())
+                ++pos;
+        }
+
+        bool atKeyword(const char* keyword)
+        {
+            skipSpace();
+            QString word = QString::fromLatin1(keyword);
+            int end = pos + word.size();
+
+            return text.midRef(pos, word.size()).compare(word, Qt::CaseInsensitive) == 0 &&
+                   (end == text.size() || text.at(end).isSpace() || text.at(end) == '(');
+        }
+
+        NodePointer parseOr()
+        {
+            NodePointer first = parseAnd();
+            if (!first || !atKeyword("or"))
+                return first;
+
+            QSharedPointer<OrNode> node(new OrNode());
+            node->nodes.append(first);
+
+            while (error.isEmpty() && atKeyword("or"))
+            {
+                pos += 2;
+                NodePointer next = parseAnd();
+                if (!next)
+                {
+                    fail("Expected a term after 'or'.");
+                    return NodePointer();
+                }
+                node->nodes.append(next);
+            }
+
+            std::stable_sort(node->nodes.begin(), node->nodes.end(), costLessThan);
+            return node;
+        }
+
+        NodePointer parseAnd()
+        {
+            QSharedPointer<AndNode> node(new AndNode());
+
+            for (;;)
+            {
+                skipSpace();
+                if (pos >= text.size() || text.at(pos) == ')' || atKeyword("or"))
+                    break;
+
+                NodePointer next = parseUnary();
+                if (!next)
+                    return NodePointer();
+                node->nodes.append(next);
+            }
+
+            if (node->nodes.isEmpty())
+                return NodePointer();
+
+            if (node->nodes.count() == 1)
+                return node->nodes.first();
+
+            // cheap checks first, so the rest is often skipped
+            std::stable_sort(node->nodes.begin(), node->nodes.end(), costLessThan);
+            return node;
+        }
+
+        NodePointer parseUnary()
+        {
+            skipSpace();
+
+            bool negate = false;
+            if (pos >= text.size()) {
+                return NodePointer();
+            } else if (text.at(pos) == '-') {
+                ++pos;
+                negate = true;
+            } else if (atKeyword("not")) {
+                pos += 3;
+                negate = true;
+            }
+
+            if (negate)
+            {
+                NodePointer operand = parseUnary();
+                if (!operand)
+                {
+                    fail("Expected a term after negation.");
+                    return NodePointer();
+                }
+
+                QSharedPointer<NotNode> node(new NotNode());
+                node->node = operand;
+                return node;
+            }
+
+            skipSpace();
+            if (pos < text.size() && text.at(pos) == '(')
+            {
+                ++pos;
+                NodePointer inner = parseOr();
+                skipSpace();
+
+                if (!inner || pos >= text.size() || text.at(pos) != ')')
+                {
+                    fail("Expected ')'.");
+                    return NodePointer();
+                }
+
+                ++pos;
+                return inner;
+            }
+
+            return parseTerm();
+        }
+
+        // "quoted text" or a run up to a space or parenthesis
+        QString readValue()
+        {
+            if (pos < text.size() && text.at(pos) == '"')
+            {
+                int end = text.indexOf('"', pos + 1);
+                if (end < 0)
+                {
+                    fail("Unterminated quote.");
+                    return QString();
+                }
+
+                QString value = text.mid(pos + 1, end - pos - 1);
+                pos = end + 1;
+                return value;
+            }
+
+            int start = pos;
+            while (pos < text.size() && !text.at(pos).isSpace() && text.at(pos) != ')')
+                ++pos;
+            return text.mid(start, pos - start);
+        }
+
+        NodePointer parseTerm()
+        {
+            skipSpace();
+
+            int start = pos;
+            while (pos < text.size() && text.at(pos).isLetter())
+                ++pos;
+
+            QString field = text.mid(start, pos - start).toLower();
+
+            QString op;
+            while (pos < text.size() && QString(":=~<>!").contains(text.at(pos)) && op.size() < 2)
+                op.append(text.at(pos++));
+
+            if (field.isEmpty() || op.isEmpty())
+            {
+                // free text
+                pos = start;
+                QString value = readValue();
+                if (value.isEmpty())
+                {
+                    fail("Expected a term.");
+                    return NodePointer();
+                }
+                return textNode(TextNode::Any, ":", value);
+            }
+
+            QString value = readValue();
+            if (!error.isEmpty())
+                return NodePointer();
+
+            if (field == "name")
+                return textNode(TextNode::Name, op, value);
+            if (field == "value")
+                return textNode(TextNode::Value, op, value);
+            if (field == "scope")
+                return scopeNode(op, value);
+            if (field == "modified")
+                return flagNode(FlagNode::Modified, op, value);
+            if (field == "expandable")
+                return flagNode(FlagNode::Expandable, op, value);
+            if (field == "entries")
+                return numberNode(NumberNode::Entries, op, value);
+            if (field == "length")
+                return numberNode(NumberNode::Length, op, value);
+
+            fail(QString("Unknown field '%1'.").arg(field));
+            return NodePointer();
+        }
+
+        NodePointer textNode(TextNode::Field field, const QString &op, const QString &value)
+        {
+            QSharedPointer<TextNode> node(new TextNode());
+            node->field = field;
+            node->pattern = value;
+
+            if (op == ":")
+                node->op = TextNode::Contains;
+            else if (op == "=")
+                node->op = TextNode::Equals;
+            else if (op == "~")
+            {
+                node->op = TextNode::Matches;
+                node->regex = QRegularExpression(value, QRegularExpression::CaseInsensitiveOption);
+                if (!node->regex.isValid())
+                {
+                    fail(node->regex.errorString());
+                    return NodePointer();
+                }
+            }
+            else
+            {
+                fail(QString("Operator '%1' does not apply to text.").arg(op));
+                return NodePointer();
+            }
+
+            return node;
+        }
+
+        NodePointer scopeNode(const QString &op, const QString &value)
+        {
+            QSharedPointer<ScopeNode> node(new ScopeNode());
+            QString scope = value.toLower();
+
+            if (op != ":" && op != "=")
+                fail(QString("Operator '%1' does not apply to scope.").arg(op));
+            else if (scope == "user" || scope == "local")
+                node->type = Variable::User;
+            else if (scope == "system" || scope == "global")
+                node->type = Variable::Global;
+            else
+                fail(QString("Unknown scope '%1'.").arg(value));
+
+            return error.isEmpty() ? node : NodePointer();
+        }
+
+        NodePointer flagNode(FlagNode::Flag flag, const QString &op, const QString &value)
+        {
+            QSharedPointer<FlagNode> node(new FlagNode());
+            QString answer = value.toLower();
+            node->flag = flag;
+
+            if (op != ":" && op != "=")
+                fail(QString("Operator '%1' does not apply to flags.").arg(op));
+            else if (answer == "yes" || answer == "true" || answer == "1")
+                node->expected = true;
+            else if (answer == "no" || answer == "false" || answer == "0")
+                node->expected = false;
+            else
+                fail(QString("Expected yes or no, got '%1'.").arg(value));
+
+            return error.isEmpty() ? node : NodePointer();
+        }
+
+        NodePointer numberNode(NumberNode::Field field, const QString &op, const QString &value)
+        {
+            QSharedPointer<NumberNode> node(new NumberNode());
+            node->field = field;
+
+            bool ok = false;
+            node->number = value.toLongLong(&ok);
+            if (!ok)
+            {
+                fail(QString("Expected a number, got '%1'.").arg(value));
+                return NodePointer();
+            }
+
+            if (op == "<")       node->op = NumberNode::Less;
+            else if (op == "<=") node->op = NumberNode::LessEqual;
+            else if (op == ">")  node->op = NumberNode::Greater;
+            else if (op == ">=") node->op = NumberNode::GreaterEqual;
+            else if (op == "=" || op == ":") node->op = NumberNode::Equal;
+            else if (op == "!=") node->op = NumberNode::NotEqual;
+            else
+            {
+                fail(QString("Operator '%1' does not apply to numbers.").arg(op));
+                return NodePointer();
+            }
+
+            return node;
+        }
+
+        const QString &text;
+        int pos;
+        QString error;
+    };
+
+    // Filter step, called concurrently; the tree is only read.
+    struct QueryFilter
+    {
+        typedef bool result_type;
+
+        QueryFilter(const QSharedPointer<const QueryNode> &root,
+                    const EnvironmentSnapshot &snapshot)
+            : root(root), snapshot(snapshot) {}
+
+        bool operator()(const Variable &var) const
+        { return root->matches(var, snapshot); }
+
+        QSharedPointer<const QueryNode> root;
+        EnvironmentSnapshot snapshot;
+    };
+
+    VariableQuery::VariableQuery()
+    {}
+
+    bool VariableQuery::compile(const QString &text)
+    {
+        root.clear();
+        error.clear();
+
+        if (text.trimmed().isEmpty())
+            return true;
+
+        QueryParser parser(text);
+        NodePointer node = parser.parse(error);
+
+        if (!node)
+        {
+            if (error.isEmpty())
+                error = "Empty query.";
+            return false;
+        }
+
+        root = node;
+        return true;
+    }
+
+    bool VariableQuery::matches(const Variable &var, const EnvironmentSnapshot &snapshot) const
+    { return !root || root->matches(var, snapshot); }
+
+    QueryResult VariableQuery::select(const EnvironmentSnapshot &snapshot) const
+    {
+        QList<Variable> all = snapshot.systemEnvironment() + snapshot.userEnvironment();
+
+        QueryResult result;
+        result.entries = result.length = 0;
+
+        if (!root)
+            result.variables = all;
+        else if (all.count() >= parallelThreshold)
+            result.variables = QtConcurrent::blockingFiltered(all, QueryFilter(root, snapshot));
+        else
+            foreach (const Variable &var, all)
+                if (root->matches(var, snapshot))
+                    result.variables.append(var);
+
+        foreach (const Variable &var, result.variables)
+        {
+            result.entries += ValueCodec::entries(var.value).count();
+            result.length += NumberNode::length(var.value);
+        }
+
+        return result;
+    }
+}
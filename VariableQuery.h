@@ -0,0 +1,75 @@
+#ifndef VARIABLEQUERY_H
+#define VARIABLEQUERY_H
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+//
+// VariableQuery is a small query language over variables, e.g.
+//
+//     scope:user entries>50 value~"/opt"
+//
+// Terms are ANDed, "or", "not"/"-" and parentheses are supported.
+//   name, value   :text (contains), =text (equals), ~regex
+//   scope         :user, :system
+//   modified,
+//   expandable    :yes, :no
+//   entries,
+//   length        <, <=, >, >=, =, != number
+// A bare word matches names and values containing it.
+//
+// The text is compiled once into a tree of predicates; the cheap
+// ones are evaluated first so that the expensive ones are skipped.
+//
+
+#include <QSharedPointer>
+#include <QString>
+#include <QList>
+
+#include "EnvironmentSnapshot.h"
+
+namespace EnvironmentExplorer
+{
+    struct QueryNode;
+
+    struct QueryResult
+    {
+        QList<Variable> variables;
+
+        // aggregates over the selected variables
+        qint64 entries;
+        qint64 length;
+    };
+
+    class VariableQuery
+    {
+    public:
+        // An empty query matches everything.
+        VariableQuery();
+
+        bool compile(const QString &text);
+
+        bool isEmpty() const
+        { return !root; }
+
+        QString errorString() const
+        { return error; }
+
+        bool matches(const Variable &var,
+                     const EnvironmentSnapshot &snapshot) const;
+
+        // Evaluated in parallel for large inputs.
+        QueryResult select(const EnvironmentSnapshot &snapshot) const;
+
+    private:
+        QSharedPointer<const QueryNode> root;
+        QString error;
+    };
+}
+
+#endif // VARIABLEQUERY_H
@@ -8,13 +8,121 @@
 */
 
 #include "VariablesManager.h"
+#include "ValueCodec.h"
+#include "AllocationTracker.h"
+#include "RunMetrics.h"
 
 #include <QSettings>
+#include <QDateTime>
 #include <QStringList>
+#include <QVector>
+#include <QSet>
 #include <QDebug>
 
+#if defined(Q_OS_WIN)
+#include <qt_windows.h>
+#endif
+
 namespace EnvironmentExplorer
 {
+#if defined(Q_OS_WIN)
+    static HKEY registryRoot(Variable::Type type)
+    { return (type == Variable::Global) ? HKEY_LOCAL_MACHINE : HKEY_CURRENT_USER; }
+
+    static const wchar_t* registryPath(Variable::Type type)
+    {
+        return (type == Variable::Global) ?
+                    L"SYSTEM\\CurrentControlSet\\Control\\Session Manager\\Environment" :
+                    L"Environment";
+    }
+#endif
+
+    // QSettings reads REG_EXPAND_SZ as a plain string, so the value
+    // types are looked up in one pass over the key.
+    static QSet<QString> expandableValues(Variable::Type type)
+    {
+        QSet<QString> result;
+
+#if defined(Q_OS_WIN)
+        HKEY key;
+        if (RegOpenKeyExW(registryRoot(type), registryPath(type), 0, KEY_READ, &key) != ERROR_SUCCESS)
+            return result;
+
+        wchar_t name[16384]; // maximal value name length
+        for (DWORD index = 0;; ++index)
+        {
+            DWORD nameLength = 16384, valueType = 0;
+            LONG rc = RegEnumValueW(key, index, name, &nameLength, 0, &valueType, 0, 0);
+
+            if (rc == ERROR_NO_MORE_ITEMS)
+                break;
+
+            if (rc == ERROR_SUCCESS && valueType == REG_EXPAND_SZ)
+                result.insert(QString::fromWCharArray(name, nameLength));
+        }
+
+        RegCloseKey(key);
+#else
+        Q_UNUSED(type);
+#endif
+
+        return result;
+    }
+
+    static bool isExpandableValue(Variable::Type type, const QString &name)
+    {
+#if defined(Q_OS_WIN)
+        DWORD valueType = 0;
+        LONG rc = RegGetValueW(registryRoot(type), registryPath(type),
+                               reinterpret_cast<const wchar_t*>(name.utf16()),
+                               RRF_RT_ANY | RRF_NOEXPAND, &valueType, 0, 0);
+        return rc == ERROR_SUCCESS && valueType == REG_EXPAND_SZ;
+#else
+        Q_UNUSED(type); Q_UNUSED(name);
+        return false;
+#endif
+    }
+
+    // Last write time of the key, changes with every value written.
+    static qint64 registryStamp(Variable::Type type)
+    {
+#if defined(Q_OS_WIN)
+        HKEY key;
+        if (RegOpenKeyExW(registryRoot(type), registryPath(type), 0, KEY_READ, &key) != ERROR_SUCCESS)
+            return 0;
+
+        FILETIME written;
+        LONG rc = RegQueryInfoKeyW(key, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, &written);
+        RegCloseKey(key);
+
+        if (rc != ERROR_SUCCESS)
+            return 0;
+
+        return (qint64(written.dwHighDateTime) << 32) | written.dwLowDateTime;
+#else
+        Q_UNUSED(type);
+        return 0;
+#endif
+    }
+
+    // QSettings would write REG_SZ, which breaks %NAME% references.
+    static bool writeExpandable(Variable::Type type, const QString &name, const QString &value)
+    {
+#if defined(Q_OS_WIN)
+        HKEY key;
+        if (RegOpenKeyExW(registryRoot(type), registryPath(type), 0, KEY_SET_VALUE, &key) != ERROR_SUCCESS)
+            return false;
+
+        LONG rc = RegSetValueExW(key, reinterpret_cast<const wchar_t*>(name.utf16()), 0, REG_EXPAND_SZ,
+                                 reinterpret_cast<const BYTE*>(value.utf16()),
+                                 DWORD((value.size() + 1) * sizeof(wchar_t)));
+        RegCloseKey(key);
+        return rc == ERROR_SUCCESS;
+#else
+        Q_UNUSED(type); Q_UNUSED(name); Q_UNUSED(value);
+        return false;
+#endif
+    }
 
     VariablesManager::VariablesManager(QObject *parent)
         : QObject(parent)
@@ -23,107 +131,373 @@ namespace EnvironmentExplorer
                                         QSettings::NativeFormat);
         userSettings = new QSettings("HKEY_CURRENT_USER\\Environment",
                                      QSettings::NativeFormat);
+        publish();
     }
 
     void VariablesManager::loadVariables()
     {
-        QStringList systemSettings = machineSettings->allKeys();
-        QStringList localSettings = userSettings->allKeys();
+        OperationTimer timer("load_variables");
 
-        variables = systemSettings + localSettings;
+        EnvironmentBaseline* loaded = new EnvironmentBaseline();
+        loaded->globalStamp = registryStamp(Variable::Global);
+        loaded->localStamp = registryStamp(Variable::User);
+        loaded->globals = parseEnvironment(*machineSettings, Variable::Global, loaded->globalHashes);
+        loaded->locals = parseEnvironment(*userSettings, Variable::User, loaded->localHashes);
+        loaded->pack();
 
-        globals = parseEnvironment(*machineSettings, Variable::Global);
-        locals = parseEnvironment(*userSettings, Variable::User);
+        current.baseline = QSharedPointer<const EnvironmentBaseline>(loaded);
+        reset();
     }
 
+    void VariablesManager::loadVariables(const QList<Variable> &vars)
+    {
+        EnvironmentBaseline* loaded = new EnvironmentBaseline();
+        foreach (const Variable &var, vars)
+            ((var.type == Variable::Global) ? loaded->globals : loaded->locals).insert(var.name, var);
+        loaded->pack();
+
+        current.baseline = QSharedPointer<const EnvironmentBaseline>(loaded);
+        reset();
+    }
+
+    void VariablesManager::reset()
+    {
+        current.globalEdits.clear();
+        current.localEdits.clear();
+        publish();
+
+        emit environmentReset();
+    }
+
+    void VariablesManager::publish()
+    {
+        ++current.ver;
+
+        // Copying the snapshot only bumps reference counts; the overlay
+        // detaches on the next write, the baseline is never written.
+        std::shared_ptr<const EnvironmentSnapshot> next(new EnvironmentSnapshot(current));
+        std::atomic_store(&published, next);
+    }
+
+    EnvironmentSnapshot VariablesManager::snapshot() const
+    { return *std::atomic_load(&published); }
+
     QList<Variable> VariablesManager::userEnvironment() const
-    { return locals.values(); }
+    { return current.userEnvironment(); }
 
     QList<Variable> VariablesManager::systemEnvironment() const
-    { return globals.values(); }
+    { return current.systemEnvironment(); }
 
-    void VariablesManager::saveVariables()
+    bool VariablesManager::saveVariables(QList<MergeConflict> *conflicts)
     {
-        QHash<QString, Variable>::iterator it = globals.begin();
+        AllocationScope scope("saveVariables");
+        OperationTimer timer("save_variables");
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
 
-        for (; it != globals.end(); ++it)
-        {
-            Variable var = it.value();
+        const EnvironmentBaseline &base = *current.baseline;
 
-            // Nothing to do, if there is no change.
-            if (var.value == var.defaultValue)
-                continue;
+        // Unless the key was written since the load, nobody else
+        // changed anything and the edits are written as they are.
+        bool changed[2];
+        changed[Variable::Global] = registryStamp(Variable::Global) != base.globalStamp;
+        changed[Variable::User] = registryStamp(Variable::User) != base.localStamp;
 
-            if (var.value.type() == QVariant::String)
-            {
-                QString value = var.value.toString();
-                if (value.isEmpty())
-                    machineSettings->remove(it.key());
-                else
-                    machineSettings->setValue(it.key(), value);
-            }
-            else
-            {
-                QStringList list = var.value.toStringList();
-                bool itemsAreEmpty = true;
+        QList<JournalEntry> changes;
+        QList<MergeConflict> found;
 
-                foreach (QString item, list)
-                    if (!item.isEmpty()) { itemsAreEmpty = false; break; }
+        QList<Variable> edits = current.globalEdits.values() + current.localEdits.values();
+        foreach (const Variable &var, edits)
+        {
+            JournalEntry change;
+            change.timestamp = now;
+            change.before = current.defaultVariable(var.name, var.type);
+            change.after = var;
 
-                if (list.isEmpty() || itemsAreEmpty)
-                    machineSettings->remove(it.key());
-                else
+            if (changed[var.type])
+            {
+                // Only the edited keys are read back.
+                const QHash<QString, uint> &hashes = (var.type == Variable::Global) ? base.globalHashes
+                                                                                  : base.localHashes;
+                Variable theirs;
+                theirs.name = var.name;
+                theirs.type = var.type;
+
+                uint hash = 0;
+                bool stored = readStored(var.name, var.type, &theirs, &hash);
+                bool untouched = stored ? (hashes.contains(var.name) && hashes.value(var.name) == hash)
+                                        : !hashes.contains(var.name);
+
+                if (!untouched)
                 {
-                    QString value = list.join(";");
-                    machineSettings->setValue(it.key(), value);
+                    if (!EnvironmentMerge::merge(change.before, var, theirs, &change.after))
+                    {
+                        MergeConflict conflict;
+                        conflict.base = change.before;
+                        conflict.ours = conflict.resolved = var;
+                        conflict.theirs = theirs;
+                        found.append(conflict);
+                        continue;
+                    }
+
+                    change.before = theirs;
                 }
             }
+
+            changes.append(change);
         }
 
-        it = locals.begin();
-        for (; it != locals.end(); ++it)
+        if (!found.isEmpty())
         {
-            Variable var = it.value();
+            if (conflicts)
+                *conflicts = found;
+            return false;
+        }
+
+        // The history starts from the environment before the first save.
+        if (!journal.hasCheckpoint() && !journal.compact(base, now - 1))
+            qWarning() << "Change journal:" << journal.errorString();
+
+        // Write-ahead: the records are synced before the registry is
+        // touched, so no change is saved without its entry. A save
+        // interrupted after this point is journaled all the same.
+        if (!journal.append(changes))
+            qWarning() << "Change journal:" << journal.errorString();
+
+        foreach (const JournalEntry &change, changes)
+            writeVariable(change.after);
+
+        // What was written is the new baseline.
+        EnvironmentBaseline* saved = new EnvironmentBaseline(base);
 
-            // Nothing to do, if there is no change.
-            if (var.value == var.defaultValue)
+        foreach (const JournalEntry &change, changes)
+        {
+            const Variable &var = change.after;
+            VariableTable &table = (var.type == Variable::Global) ? saved->globals : saved->locals;
+            QHash<QString, uint> &hashes = (var.type == Variable::Global) ? saved->globalHashes
+                                                                         : saved->localHashes;
+
+            if (ValueCodec::isBlank(var.value)) {
+                table.remove(var.name);
+                hashes.remove(var.name);
                 continue;
+            }
 
-            if (var.value.type() == QVariant::String)
-            {
-                QString value = var.value.toString();
-                if (value.isEmpty()) // empty strings are not needed
-                    machineSettings->remove(it.key());
-                else
-                    machineSettings->setValue(it.key(), value);
+            QString raw = ValueCodec::encode(var.value);
+
+            Variable stored = var;
+            stored.expandable = storedAsExpandable(var, raw);
+
+            table.insert(var.name, saved->pack(stored));
+            hashes.insert(var.name, EnvironmentMerge::storedHash(raw, stored.expandable));
+        }
+
+        // Keys others changed, which we did not touch.
+        if (changed[Variable::Global])
+            refreshBaseline(saved, Variable::Global);
+        if (changed[Variable::User])
+            refreshBaseline(saved, Variable::User);
+
+        saved->globalStamp = registryStamp(Variable::Global);
+        saved->localStamp = registryStamp(Variable::User);
+        saved->compact();
+
+        current.baseline = QSharedPointer<const EnvironmentBaseline>(saved);
+
+        if (journal.needsCompaction() && !journal.compact(*saved, now))
+            qWarning() << "Change journal:" << journal.errorString();
+
+        reset();
+        return true;
+    }
+
+    void VariablesManager::resolveConflicts(const QList<MergeConflict> &conflicts)
+    {
+        EnvironmentBaseline* rebased = new EnvironmentBaseline(*current.baseline);
+
+        foreach (const MergeConflict &conflict, conflicts)
+        {
+            const Variable &theirs = conflict.theirs;
+            VariableTable &table = (theirs.type == Variable::Global) ? rebased->globals : rebased->locals;
+            QHash<QString, uint> &hashes = (theirs.type == Variable::Global) ? rebased->globalHashes
+                                                                            : rebased->localHashes;
+
+            if (!theirs.value.isValid()) {
+                table.remove(theirs.name);
+                hashes.remove(theirs.name);
+            } else {
+                table.insert(theirs.name, rebased->pack(theirs));
+                hashes.insert(theirs.name, EnvironmentMerge::storedHash(ValueCodec::encode(theirs.value),
+                                                                        theirs.expandable));
             }
-            else
+        }
+
+        rebased->compact();
+        current.baseline = QSharedPointer<const EnvironmentBaseline>(rebased);
+
+        // The resolved values are the edits against the new base.
+        foreach (const MergeConflict &conflict, conflicts)
+            stageVariable(conflict.resolved);
+
+        publish();
+
+        foreach (const MergeConflict &conflict, conflicts)
+            emit variableChanged(conflict.resolved.name, conflict.resolved.type);
+    }
+
+    bool VariablesManager::readStored(const QString &name, Variable::Type type,
+                                      Variable *var, uint *hash)
+    {
+        QSettings* set = settings(type);
+        set->sync();
+
+        if (!set->contains(name))
+            return false;
+
+        QString raw = set->value(name).toString();
+
+        var->name = name;
+        var->type = type;
+        var->value = ValueCodec::decode(raw);
+        var->expandable = isExpandableValue(type, name);
+
+        *hash = EnvironmentMerge::storedHash(raw, var->expandable);
+        return true;
+    }
+
+    void VariablesManager::refreshBaseline(EnvironmentBaseline *base, Variable::Type type)
+    {
+        VariableTable &table = (type == Variable::Global) ? base->globals : base->locals;
+        QHash<QString, uint> &hashes = (type == Variable::Global) ? base->globalHashes
+                                                                 : base->localHashes;
+        QSet<QString> present;
+
+        // Only the changed values are decoded into the baseline.
+        auto refresh = [&](const QString &name, const QString &raw, bool expandable){
+            uint hash = EnvironmentMerge::storedHash(raw, expandable);
+
+            QHash<QString, uint>::const_iterator it = hashes.constFind(name);
+            if (it != hashes.constEnd() && it.value() == hash)
+                return;
+
+            Variable var;
+            var.name = name;
+            var.type = type;
+            var.value = ValueCodec::decode(QString(raw.constData(), raw.size()));
+            var.expandable = expandable;
+
+            table.insert(name, base->pack(var));
+            hashes.insert(name, hash);
+        };
+
+#if defined(Q_OS_WIN)
+        // The key does not tell which values were written, so each one
+        // is still read, in a single pass into reused buffers, and
+        // hashed in place; nothing is copied for unchanged values.
+        HKEY key;
+        if (RegOpenKeyExW(registryRoot(type), registryPath(type), 0, KEY_READ, &key) != ERROR_SUCCESS)
+            return;
+
+        DWORD maxName = 0, maxData = 0;
+        if (RegQueryInfoKeyW(key, 0, 0, 0, 0, 0, 0, 0, &maxName, &maxData, 0, 0) != ERROR_SUCCESS)
+        {
+            RegCloseKey(key);
+            return;
+        }
+
+        QVector<wchar_t> name(int(maxName) + 1);
+        QVector<wchar_t> data(int(maxData / sizeof(wchar_t)) + 1);
+
+        for (DWORD index = 0;;)
+        {
+            DWORD nameLength = DWORD(name.size()), valueType = 0;
+            DWORD dataSize = DWORD(data.size() * sizeof(wchar_t));
+
+            LONG rc = RegEnumValueW(key, index, name.data(), &nameLength, 0, &valueType,
+                                    reinterpret_cast<BYTE*>(data.data()), &dataSize);
+
+            if (rc == ERROR_NO_MORE_ITEMS)
+                break;
+
+            if (rc == ERROR_MORE_DATA) // grown since the query, same index again
             {
-                QStringList list = var.value.toStringList();
-                bool itemsAreEmpty = true;
+                name.resize(16384); // maximal value name length
+                data.resize(int(dataSize / sizeof(wchar_t)) + 1);
+                continue;
+            }
 
-                foreach (QString item, list)
-                    if (!item.isEmpty()) { itemsAreEmpty = false; break; }
+            ++index;
+            if (rc != ERROR_SUCCESS)
+                continue;
 
-                if (list.isEmpty() || itemsAreEmpty)
-                    machineSettings->remove(it.key());
-                else
-                {
-                    QString value = list.join(";");
-                    machineSettings->setValue(it.key(), value);
-                }
+            QString valueName = QString::fromWCharArray(name.constData(), int(nameLength));
+            present.insert(valueName);
+
+            // others stay as they were loaded
+            if (valueType != REG_SZ && valueType != REG_EXPAND_SZ)
+                continue;
+
+            int length = int(dataSize / sizeof(wchar_t));
+            while (length > 0 && data.at(length - 1) == 0)
+                --length;
+
+            refresh(valueName, QString::fromRawData(reinterpret_cast<const QChar*>(data.constData()), length),
+                    valueType == REG_EXPAND_SZ);
+        }
+
+        RegCloseKey(key);
+#else
+        QSettings* set = settings(type);
+        set->sync();
+
+        QSet<QString> expandable = expandableValues(type);
+        foreach (const QString &key, set->allKeys())
+        {
+            present.insert(key);
+            refresh(key, set->value(key).toString(), expandable.contains(key));
+        }
+#endif
+
+        foreach (const QString &key, table.keys())
+            if (!present.contains(key)) {
+                table.remove(key);
+                hashes.remove(key);
             }
+    }
+
+    bool VariablesManager::storedAsExpandable(const Variable &var, const QString &raw) const
+    {
+        const VariableTable &base = current.baselineTable(var.type);
+        VariableTable::const_iterator it = base.constFind(var.name);
+
+        if (it != base.constEnd())
+            return it.value().expandable;
+
+        return var.expandable || ValueCodec::hasReferences(raw);
+    }
+
+    void VariablesManager::writeVariable(const Variable &var)
+    {
+        QSettings* set = settings(var.type);
+
+        // empty values (and removed variables) are not needed
+        if (ValueCodec::isBlank(var.value))
+        {
+            set->remove(var.name);
+            return;
         }
+
+        QString value = ValueCodec::encode(var.value);
+
+        if (storedAsExpandable(var, value) && writeExpandable(var.type, var.name, value))
+            return;
+
+        set->setValue(var.name, value);
     }
 
     void VariablesManager::dumpVariables(Variable::Type t)
     {
-        if (t == Variable::Global)
-            foreach (Variable v, globals)
-                qDebug() << QString("%1=%2").arg(v.name, v.value.toString());
-        else
-            foreach (Variable v, locals)
-                qDebug() << QString("%1=%2").arg(v.name, v.value.toString());
+        foreach (Variable v, current.environment(t))
+            qDebug() << QString("%1=%2").arg(v.name, v.value.toString());
     }
 
 
@@ -133,135 +507,140 @@ namespace EnvironmentExplorer
     void VariablesManager::addUserVariable(const QString &name, const QVariant &val)
     { addVariable(name, val); }
 
-    void VariablesManager::addVariable(const QString &name, const QVariant &val, Variable::Type var)
+    void VariablesManager::addVariable(const QString &name, const QVariant &val, Variable::Type type)
     {
-        if (var == Variable::Global)
-        {
-            if (globals.contains(name)) {
-                globals[name].name = name;
-                globals[name].value = val;
-
-                if (var != globals[name].type) {
-                    Variable v = globals[name];
-                    v.type = var;
-                    globals.remove(name);
-                    locals.insert(name, v);
-                }
-
-            } else {
-                Variable v;
-                v.name = name;
-                v.value = val;
-                v.type = var;
-                globals.insert(name, v);
-            }
-        }
-        else
-        {
-            if (locals.contains(name)) {
-                locals[name].name = name;
-                locals[name].value = val;
-
-                if (var != locals[name].type) {
-                    Variable v = locals[name];
-                    v.type = var;
-                    locals.remove(name);
-                    globals.insert(name, v);
-                }
-            } else {
-                Variable v;
-                v.name = name;
-                v.value = val;
-                v.type = var;
-                locals.insert(name, v);
-            }
-        }
+        Variable v;
+        v.name = name;
+        v.value = val;
+        v.type = type;
+        addVariable(v);
     }
 
     bool VariablesManager::contains(const QString &name) const
-    { return variables.contains(name); }
+    { return current.contains(name); }
+
+    bool VariablesManager::isModified(const QString &name, Variable::Type type) const
+    { return current.isModified(name, type); }
 
     void VariablesManager::removeVariable(const QString &name)
     {
-        if (contains(name))
-        {
-            if (globals.contains(name))
-                globals[name].value = QVariant();
-            else
-                locals[name].value = QVariant();
-        }
+        if (current.lookup(name, Variable::Global))
+            removeVariable(name, Variable::Global);
+        else
+            removeVariable(name, Variable::User);
     }
 
     void VariablesManager::removeVariable(const QString &name, Variable::Type type)
     {
-        if (type == Variable::Global) {
-            if (globals.contains(name))
-                globals[name].value = QVariant();
-        } else {
-            if (locals.contains(name))
-                locals[name].value = QVariant();
-        }
+        Variable removed;
+        removed.name = name;
+        removed.type = type;
+
+        stageVariable(removed);
+        ++editCounters[Variable::key(name, type)];
+        publish();
+
+        emit variableChanged(name, type);
     }
 
     QHash<QString, Variable> VariablesManager::parseEnvironment(const QSettings &set,
-                                                                Variable::Type t)
+                                                                Variable::Type t,
+                                                                QHash<QString, uint> &hashes)
     {
+        AllocationScope scope("parseEnvironment");
+        OperationTimer timer("parse_environment");
+
+        QSet<QString> expandable = expandableValues(t);
+
         QHash<QString, Variable> result;
         foreach (QString key, set.allKeys())
         {
             Variable var;
             var.name = key;
-            var.defaultName = key;
             var.type = t;
-            QString val = set.value(key).toString();
-
-            if (val.contains(";"))
-                var.defaultValue = var.value = val.split(";");
-            else
-                var.defaultValue = var.value = val;
+            QString raw = set.value(key).toString();
+            var.value = ValueCodec::decode(raw);
+            var.expandable = expandable.contains(key);
 
             result.insert(key, var);
+            hashes.insert(key, EnvironmentMerge::storedHash(raw, var.expandable));
         }
 
         return result;
     }
 
     Variable VariablesManager::variable(const QString& name) const
+    { return current.variable(name); }
+
+    Variable VariablesManager::defaultVariable(const QString &name, Variable::Type type) const
+    { return current.defaultVariable(name, type); }
+
+    bool VariablesManager::replaceVariable(const QString &name, const Variable &var)
     {
-        if (locals.contains(name))
-            return locals[name];
+        Variable::Type type;
+        if (current.lookup(name, Variable::Global))
+            type = Variable::Global;
+        else if (current.lookup(name, Variable::User))
+            type = Variable::User;
+        else
+            return false;
 
-        if (globals.contains(name))
-            return globals[name];
+        if (name != var.name)
+            removeVariable(name, type);
 
-        Q_ASSERT(false);
-        return Variable();
+        Variable v = var;
+        v.type = type;
+        addVariable(v);
+        return true;
     }
 
-    bool VariablesManager::replaceVariable(const QString &name, const Variable &var)
+    void VariablesManager::addVariable(const Variable &var)
     {
-        if (globals.contains(name))
-        {
-            globals.remove(name);
-            globals.insert(name, var);
-            return true;
-        }
+        stageVariable(var);
+        ++editCounters[Variable::key(var.name, var.type)];
+        publish();
+
+        emit variableChanged(var.name, var.type);
+    }
 
-        if (locals.contains(name))
+    void VariablesManager::addVariables(const QList<Variable> &vars)
+    {
+        if (vars.isEmpty())
+            return;
+
+        foreach (const Variable &var, vars)
         {
-            locals.remove(name);
-            locals.insert(name, var);
-            return true;
+            stageVariable(var);
+            ++editCounters[Variable::key(var.name, var.type)];
         }
 
-        return false;
+        // One version for the whole batch.
+        publish();
+
+        foreach (const Variable &var, vars)
+            emit variableChanged(var.name, var.type);
     }
 
-    void VariablesManager::addVariable(const Variable &var)
+    void VariablesManager::stageVariable(const Variable &var)
     {
-        if (var.type == Variable::Global)
-            globals.insert(var.name, var);
+        VariableTable &edits = overlayTable(var.type);
+        const VariableTable &base = current.baselineTable(var.type);
+        VariableTable::const_iterator it = base.constFind(var.name);
+
+        if (!var.value.isValid())
+        {
+            if (it != base.constEnd())
+                edits.insert(var.name, var);
+            else
+                edits.remove(var.name); // added in this session only
+            return;
+        }
+
+        // Keep the overlay sparse: an edit which restores
+        // the loaded value is no edit at all.
+        if (it != base.constEnd() && EnvironmentBaseline::unpack(it.value()).value == var.value)
+            edits.remove(var.name);
         else
-            locals.insert(var.name, var);
+            edits.insert(var.name, var);
     }
 }
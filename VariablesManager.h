@@ -19,26 +19,15 @@
 #include <QList>
 #include <QHash>
 
+#include <memory>
+
+#include "EnvironmentSnapshot.h"
+#include "ChangeJournal.h"
+#include "EnvironmentMerge.h"
+
 class QSettings;
 namespace EnvironmentExplorer
 {
-    struct Variable
-    {
-        // Represents the name of env. var.
-        QString name;
-        // Stores the default name
-        QString defaultName;
-
-        // Represents the current value.
-        QVariant value;
-        // Represents the default value
-        // (only if it from the environment)
-        QVariant defaultValue;
-
-        enum Type { Global, User };
-        Type type;
-    };
-
     class VariablesManager : public QObject
     {
         Q_OBJECT
@@ -54,10 +43,29 @@ namespace EnvironmentExplorer
                                  const QVariant &val);
 
           void loadVariables();
-          void saveVariables();
+
+          // Takes the variables as the loaded ones instead of reading
+          // the registry, for benchmarks; not meant to be saved.
+          void loadVariables(const QList<Variable> &vars);
+
+          // Writes the edits, merged with what others changed in the
+          // registry since the load. When some keys conflict nothing
+          // is written and false is returned, with the conflicts.
+          bool saveVariables(QList<MergeConflict>* conflicts = 0);
+
+          // Takes the registry values of the conflicts as the new base
+          // and their resolved values as the edits; save again then.
+          void resolveConflicts(const QList<MergeConflict> &conflicts);
 
           bool contains(const QString &name) const;
 
+          // Tells whether the variable differs from the loaded one.
+          bool isModified(const QString &name,
+                          Variable::Type type) const;
+
+          // Drops all edits made since the last load/save.
+          void reset();
+
           bool replaceVariable(const QString &name,
                                const Variable &var);
 
@@ -71,10 +79,43 @@ namespace EnvironmentExplorer
 
           Variable variable(const QString& name) const;
 
+          // Returns the variable as it was loaded (invalid value if none).
+          Variable defaultVariable(const QString &name,
+                                   Variable::Type type) const;
+
           void dumpVariables(Variable::Type t);
 
+          // Returns the latest published state. May be called from
+          // any thread, never blocks the writer.
+          EnvironmentSnapshot snapshot() const;
+
+          // History of saved changes.
+          ChangeJournal &changeJournal()
+          { return journal; }
+
+          // Times each variable was added, edited or removed in this
+          // session, keyed by Variable::key().
+          const QHash<QString, quint32> &editCounts() const
+          { return editCounters; }
+
+          quint32 editCount(const QString &name, Variable::Type type) const
+          { return editCounters.value(Variable::key(name, type)); }
+
+    signals:
+          // A single variable was added, edited or removed.
+          void variableChanged(const QString &name,
+                               Variable::Type type);
+
+          // Everything may have changed (load, save, reset).
+          void environmentReset();
+
+    public slots:
           void addVariable(const Variable &var);
 
+          // Applies many changes as one version. Variables with
+          // an invalid value are removed.
+          void addVariables(const QList<Variable> &vars);
+
     protected:
 
           void addVariable(const QString &name,
@@ -84,13 +125,48 @@ namespace EnvironmentExplorer
 
     private:
           QHash<QString, Variable> parseEnvironment(const QSettings &set,
-                                                    Variable::Type t);
+                                                    Variable::Type t,
+                                                    QHash<QString, uint> &hashes);
+
+          // Reads one value as it is stored now.
+          bool readStored(const QString &name, Variable::Type type,
+                          Variable *var, uint *hash);
+
+          // Brings keys changed by others into the baseline. Every
+          // value is read and hashed, only those whose hash differs
+          // are decoded.
+          void refreshBaseline(EnvironmentBaseline *base, Variable::Type type);
+
+          QSettings* settings(Variable::Type type) const
+          { return (type == Variable::Global) ? machineSettings : userSettings; }
+
+          VariableTable &overlayTable(Variable::Type type)
+          { return (type == Variable::Global) ? current.globalEdits : current.localEdits; }
+
+          // Values keep the type they were loaded with; only new ones
+          // become REG_EXPAND_SZ when they refer to other variables.
+          bool storedAsExpandable(const Variable &var, const QString &raw) const;
+
+          void writeVariable(const Variable &var);
+
+          // Records the change in the overlay without publishing it.
+          void stageVariable(const Variable &var);
+
+          // Makes the working state visible to snapshot() readers.
+          void publish();
 
           QSettings* machineSettings,
                    * userSettings;
 
-          QList<QString> variables;
-          QHash<QString, Variable> globals, locals;
+          // Working state, only touched by the owning thread.
+          EnvironmentSnapshot current;
+
+          // Last published state; swapped atomically.
+          std::shared_ptr<const EnvironmentSnapshot> published;
+
+          ChangeJournal journal;
+
+          QHash<QString, quint32> editCounters;
 
     };
 
@@ -7,18 +7,292 @@
 */
 
 #include <QApplication>
+#include <QTextStream>
+#include <QStringList>
+#include <QDateTime>
 #include <qt_windows.h>
 
+#include <limits>
+
 #include "MainDialog.h"
+#include "FleetAggregator.h"
+#include "AllocationTracker.h"
+#include "StartupProfiler.h"
+#include "VariablesManager.h"
+#include "RunMetrics.h"
+#include "EnvironmentProfiles.h"
+#include "ChangeJournal.h"
+#include "ValueCodec.h"
+#include "Benchmarks.h"
+
+using namespace EnvironmentExplorer;
+
+static int runFleet(const QString &directory)
+{
+    FleetStatistics stats;
+    {
+        AllocationScope scope("fleet");
+        OperationTimer timer("fleet");
+        stats = FleetAggregator::aggregate(directory);
+    }
+
+    if (stats.machineCount == 0)
+    {
+        QTextStream(stderr) << "No snapshots could be read from " << directory << "\n";
+        return 1;
+    }
+
+    QTextStream(stdout) << FleetAggregator::report(stats);
+    return 0;
+}
+
+static int runMetrics(const QString &fileName)
+{
+    VariablesManager manager;
+    manager.loadVariables();
+
+    // As last saved by us, to count what others changed since; there
+    // is none before the first save.
+    ChangeJournal journal;
+    EnvironmentBaseline saved;
+    bool hasSaved = journal.hasCheckpoint() &&
+                    journal.replay(QDateTime::currentMSecsSinceEpoch(), saved);
+
+    QString error;
+    if (!RunMetrics::writeTextfile(fileName, manager.snapshot(), hasSaved ? &saved : 0, &error))
+    {
+        QTextStream(stderr) << "Could not write " << fileName << ": " << error << "\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+static int applyProfile(const QString &name)
+{
+    if (!ProfileStore::isValidName(name))
+    {
+        QTextStream(stderr) << "'" << name << "' is not a valid profile name.\n";
+        return 1;
+    }
+
+    ProfileStore store;
+    EnvironmentProfile profile;
+
+    if (!store.load(name, &profile))
+    {
+        QTextStream(stderr) << "Could not read the profile " << name << ": " << store.errorString() << "\n";
+        return 1;
+    }
+
+    VariablesManager manager;
+    manager.loadVariables();
+
+    QList<Variable> batch;
+    foreach (const ReplaceChange &change, EnvironmentProfiles::plan(profile, manager.snapshot()))
+        batch.append(change.after);
+
+    manager.addVariables(batch);
+
+    if (!manager.saveVariables())
+    {
+        QTextStream(stderr) << "The registry changed while applying " << name << ", nothing was saved.\n";
+        return 1;
+    }
+
+    QTextStream(stdout) << "Applied " << name << ": " << batch.count() << " variable(s) changed.\n";
+    return 0;
+}
+
+static QString describeValue(const Variable &var)
+{ return var.value.isValid() ? ValueCodec::encode(var.value) : QString("(not set)"); }
+
+static bool parseTime(const QString &text, qint64 *timestamp)
+{
+    QDateTime time = QDateTime::fromString(text, Qt::ISODate);
+    if (!time.isValid())
+    {
+        QTextStream(stderr) << "Not a date and time (yyyy-MM-ddThh:mm:ss): " << text << "\n";
+        return false;
+    }
+
+    *timestamp = time.toMSecsSinceEpoch();
+    return true;
+}
+
+// Every saved change of the variable up to the time, with the value it replaced.
+static int showHistory(const QString &name, qint64 until)
+{
+    ChangeJournal journal;
+    QTextStream out(stdout);
+    int count = 0;
+
+    foreach (const JournalEntry &entry, journal.entries())
+    {
+        if (entry.timestamp > until)
+            break;
+
+        if (entry.after.name.compare(name, Qt::CaseInsensitive) != 0)
+            continue;
+
+        out << QDateTime::fromMSecsSinceEpoch(entry.timestamp).toString(Qt::ISODate)
+            << (entry.after.type == Variable::Global ? "  system\n" : "  user\n")
+            << "    was: " << describeValue(entry.before) << "\n"
+            << "    now: " << describeValue(entry.after) << "\n";
+        ++count;
+    }
+
+    if (count == 0)
+    {
+        QTextStream(stderr) << "No saved changes of " << name << " in " << journal.fileName() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+// The saved environment as it was at the time.
+static int showEnvironmentAt(qint64 timestamp)
+{
+    ChangeJournal journal;
+    EnvironmentBaseline state;
+
+    if (!journal.replay(timestamp, state))
+    {
+        QTextStream(stderr) << "Could not replay " << journal.fileName() << ": " << journal.errorString() << "\n";
+        return 1;
+    }
+
+    QTextStream out(stdout);
+    for (int scope = Variable::Global; scope <= Variable::User; ++scope)
+    {
+        const VariableTable &table = (scope == Variable::Global) ? state.globals : state.locals;
+        out << (scope == Variable::Global ? "[system]\n" : "[user]\n");
+
+        QStringList names = table.keys();
+        names.sort(Qt::CaseInsensitive);
+
+        foreach (const QString &name, names)
+            out << name << "=" << describeValue(EnvironmentBaseline::unpack(table.value(name))) << "\n";
+    }
+
+    return 0;
+}
+
+static int runBenchmarks(const QStringList &args, int benchmark, int only)
+{
+    bool ok = false;
+    int variables = (benchmark > 0 && benchmark + 1 < args.count()) ? args.at(benchmark + 1).toInt(&ok) : 0;
+
+    QStringList names;
+    if (only > 0 && only + 1 < args.count())
+        names = args.at(only + 1).split(',', QString::SkipEmptyParts);
+
+    foreach (const QString &name, names)
+        if (!Benchmarks::names().contains(name))
+        {
+            QTextStream(stderr) << "No benchmark " << name << ", there are: "
+                                << Benchmarks::names().join(", ") << "\n";
+            return 1;
+        }
+
+    QTextStream(stdout) << Benchmarks::run(ok ? variables : 100000, names);
+    return 0;
+}
+
+// Headless runs, no window is shown:
+//   --fleet <directory>       statistics over a directory of snapshots
+//   --apply-profile <name>    applies a saved profile and saves
+//   --history <name>          saved changes of a variable (up to --as-of)
+//   --as-of <time>            saved environment at the time (ISO 8601)
+//   --metrics <file>          Prometheus textfile of the local environment
+//   --benchmark [variables]   times the operations on made-up data
+//                             (100000 variables by default)
+//   --benchmark-only <names>  the same, just the comma-separated ones
+static bool isBenchmark(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i)
+        if (qstrcmp(argv[i], "--benchmark") == 0 || qstrcmp(argv[i], "--benchmark-only") == 0)
+            return true;
+    return false;
+}
+
+static bool isHeadless(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i)
+        if (qstrcmp(argv[i], "--fleet") == 0 || qstrcmp(argv[i], "--metrics") == 0 ||
+            qstrcmp(argv[i], "--apply-profile") == 0 || qstrcmp(argv[i], "--history") == 0 ||
+            qstrcmp(argv[i], "--as-of") == 0)
+            return true;
+    return isBenchmark(argc, argv);
+}
+
+static int runHeadless(const QStringList &args)
+{
+    int result = 0;
+
+    int fleet = args.indexOf("--fleet");
+    if (fleet > 0 && fleet + 1 < args.count())
+        result = runFleet(args.at(fleet + 1));
+
+    int profile = args.indexOf("--apply-profile");
+    if (profile > 0 && profile + 1 < args.count())
+        result = qMax(result, applyProfile(args.at(profile + 1)));
+
+    int history = args.indexOf("--history");
+    int asOf = args.indexOf("--as-of");
+    qint64 until = std::numeric_limits<qint64>::max();
+
+    if (asOf > 0 && (asOf + 1 >= args.count() || !parseTime(args.at(asOf + 1), &until)))
+        result = qMax(result, 1);
+    else if (history > 0 && history + 1 < args.count())
+        result = qMax(result, showHistory(args.at(history + 1), until));
+    else if (asOf > 0)
+        result = qMax(result, showEnvironmentAt(until));
+
+    int benchmark = args.indexOf("--benchmark");
+    int benchmarkOnly = args.indexOf("--benchmark-only");
+    if (benchmark > 0 || benchmarkOnly > 0)
+        result = qMax(result, runBenchmarks(args, benchmark, benchmarkOnly));
+
+    // last, so that it carries the timings of the above
+    int metrics = args.indexOf("--metrics");
+    if (metrics > 0 && metrics + 1 < args.count())
+        result = qMax(result, runMetrics(args.at(metrics + 1)));
+
+    if (AllocationTracker::isEnabled())
+        QTextStream(stderr) << AllocationTracker::report();
+
+    return result;
+}
 
 int main(int argc, char *argv[])
 {
+    StartupProfiler::start();
     Q_INIT_RESOURCE(resources);
 
+    if (isHeadless(argc, argv))
+    {
+        // some benchmarks open dialogs
+        if (isBenchmark(argc, argv))
+        {
+            QApplication runtime(argc, argv);
+            return runHeadless(runtime.arguments());
+        }
+
+        QCoreApplication runtime(argc, argv);
+        return runHeadless(runtime.arguments());
+    }
+
     QApplication ExplorerRuntime(argc, argv);
+    StartupProfiler::mark("application");
 
     EnvironmentExplorer::MainDialog mainDialog(0);
+    StartupProfiler::mark("window");
+
+    // --startup-profile prints the marks once the window is usable
+    StartupProfiler::watch(&mainDialog, ExplorerRuntime.arguments().contains("--startup-profile"));
     mainDialog.show();
-    
+
     return ExplorerRuntime.exec();
 }
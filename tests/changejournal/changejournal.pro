@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_changejournal
+
+SOURCES += tst_changejournal.cpp
@@ -0,0 +1,232 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QFile>
+
+#include "ChangeJournal.h"
+
+using namespace EnvironmentExplorer;
+
+class ChangeJournalTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void appendAndReplay();
+    void replayBeforeHistory();
+    void tornTailIsCutOff();
+    void garbledSizeIsTornTail();
+    void compactionKeepsHistory();
+    void interruptedArchive();
+
+private:
+    QString journalName() const
+    { return dir->path() + "/changes.journal"; }
+
+    QScopedPointer<QTemporaryDir> dir;
+};
+
+static Variable variable(const QString &name, const QVariant &value,
+                         Variable::Type type = Variable::User)
+{
+    Variable var;
+    var.name = name;
+    var.type = type;
+    var.value = value;
+    return var;
+}
+
+static JournalEntry change(qint64 timestamp, const Variable &before, const Variable &after)
+{
+    JournalEntry entry;
+    entry.timestamp = timestamp;
+    entry.before = before;
+    entry.after = after;
+    return entry;
+}
+
+static QString valueAt(ChangeJournal &journal, qint64 timestamp, const QString &name,
+                       Variable::Type type = Variable::User)
+{
+    EnvironmentBaseline state;
+    if (!journal.replay(timestamp, state))
+        return QString("(replay failed)");
+
+    const VariableTable &table = (type == Variable::Global) ? state.globals : state.locals;
+    if (!table.contains(name))
+        return QString("(not set)");
+
+    return EnvironmentBaseline::unpack(table.value(name)).value.toString();
+}
+
+void ChangeJournalTest::init()
+{
+    dir.reset(new QTemporaryDir());
+    QVERIFY(dir->isValid());
+}
+
+void ChangeJournalTest::appendAndReplay()
+{
+    ChangeJournal journal(journalName());
+
+    EnvironmentBaseline base;
+    base.locals.insert("EDITOR", variable("EDITOR", "vi"));
+    QVERIFY(journal.compact(base, 100));
+
+    QVERIFY(journal.append(QList<JournalEntry>()
+                           << change(200, variable("EDITOR", "vi"), variable("EDITOR", "emacs"))
+                           << change(200, variable("TEMP", QVariant()), variable("TEMP", "C:\\tmp"))));
+    QVERIFY(journal.append(QList<JournalEntry>()
+                           << change(300, variable("EDITOR", "emacs"), variable("EDITOR", QVariant()))));
+
+    QCOMPARE(valueAt(journal, 150, "EDITOR"), QString("vi"));
+    QCOMPARE(valueAt(journal, 200, "EDITOR"), QString("emacs"));
+    QCOMPARE(valueAt(journal, 250, "TEMP"), QString("C:\\tmp"));
+    QCOMPARE(valueAt(journal, 300, "EDITOR"), QString("(not set)"));
+
+    QList<JournalEntry> entries = journal.entries();
+    QCOMPARE(entries.count(), 3);
+    QCOMPARE(entries.at(0).before.value.toString(), QString("vi"));
+    QCOMPARE(entries.at(0).after.value.toString(), QString("emacs"));
+    QVERIFY(!entries.at(1).before.value.isValid());
+    QVERIFY(!entries.at(2).after.value.isValid());
+}
+
+void ChangeJournalTest::replayBeforeHistory()
+{
+    ChangeJournal journal(journalName());
+
+    EnvironmentBaseline state;
+    QVERIFY(!journal.replay(100, state));
+
+    QVERIFY(journal.compact(EnvironmentBaseline(), 100));
+    QVERIFY(!journal.replay(50, state));
+    QVERIFY(!journal.errorString().isEmpty());
+}
+
+// A save torn before its sync leaves part of a record behind. The
+// next session cuts it off, so that what it appends can be read.
+void ChangeJournalTest::tornTailIsCutOff()
+{
+    {
+        ChangeJournal journal(journalName());
+        QVERIFY(journal.compact(EnvironmentBaseline(), 100));
+        QVERIFY(journal.append(QList<JournalEntry>()
+                               << change(200, variable("A", QVariant()), variable("A", "1"))));
+    }
+
+    qint64 intact = QFileInfo(journalName()).size();
+
+    QFile file(journalName());
+    QVERIFY(file.open(QFile::WriteOnly|QFile::Append));
+    file.write(QByteArray("\x40\x00\x00\x00\x12\x34partial", 12));
+    file.close();
+
+    ChangeJournal journal(journalName());
+    QCOMPARE(journal.entries().count(), 1);
+
+    QVERIFY(journal.append(QList<JournalEntry>()
+                           << change(300, variable("A", "1"), variable("A", "2"))));
+
+    QList<JournalEntry> entries = journal.entries();
+    QCOMPARE(entries.count(), 2);
+    QCOMPARE(entries.at(1).after.value.toString(), QString("2"));
+    QVERIFY(QFileInfo(journalName()).size() > intact);
+    QCOMPARE(valueAt(journal, 300, "A"), QString("2"));
+}
+
+// A frame header claiming more bytes than are left is not trusted
+// (nor allocated), it ends the journal like any torn tail.
+void ChangeJournalTest::garbledSizeIsTornTail()
+{
+    {
+        ChangeJournal journal(journalName());
+        QVERIFY(journal.compact(EnvironmentBaseline(), 100));
+        QVERIFY(journal.append(QList<JournalEntry>()
+                               << change(200, variable("A", QVariant()), variable("A", "1"))));
+    }
+
+    QFile file(journalName());
+    QVERIFY(file.open(QFile::WriteOnly|QFile::Append));
+    file.write(QByteArray("\xff\xff\xff\xf0\x12\x34partial", 13));
+    file.close();
+
+    ChangeJournal journal(journalName());
+    QCOMPARE(journal.entries().count(), 1);
+
+    QVERIFY(journal.append(QList<JournalEntry>()
+                           << change(300, variable("A", "1"), variable("A", "2"))));
+    QCOMPARE(journal.entries().count(), 2);
+    QCOMPARE(valueAt(journal, 300, "A"), QString("2"));
+}
+
+// Compaction starts a new checkpoint; the history before it is kept.
+void ChangeJournalTest::compactionKeepsHistory()
+{
+    ChangeJournal journal(journalName());
+    journal.setCompactionThreshold(1);
+
+    QVERIFY(journal.compact(EnvironmentBaseline(), 100));
+    QVERIFY(journal.append(QList<JournalEntry>()
+                           << change(200, variable("PATH", QVariant(), Variable::Global),
+                                          variable("PATH", "C:\\a", Variable::Global))));
+    QVERIFY(journal.needsCompaction());
+
+    EnvironmentBaseline saved;
+    saved.globals.insert("PATH", variable("PATH", "C:\\a", Variable::Global));
+    QVERIFY(journal.compact(saved, 250));
+    QVERIFY(!journal.needsCompaction());
+
+    QVERIFY(journal.append(QList<JournalEntry>()
+                           << change(300, variable("PATH", "C:\\a", Variable::Global),
+                                          variable("PATH", "C:\\b", Variable::Global))));
+
+    QCOMPARE(journal.segments(), QList<qint64>() << 100);
+
+    QCOMPARE(valueAt(journal, 150, "PATH", Variable::Global), QString("(not set)"));
+    QCOMPARE(valueAt(journal, 200, "PATH", Variable::Global), QString("C:\\a"));
+    QCOMPARE(valueAt(journal, 260, "PATH", Variable::Global), QString("C:\\a"));
+    QCOMPARE(valueAt(journal, 300, "PATH", Variable::Global), QString("C:\\b"));
+
+    QList<JournalEntry> entries = journal.entries();
+    QCOMPARE(entries.count(), 2);
+    QCOMPARE(entries.at(0).timestamp, qint64(200));
+    QCOMPARE(entries.at(1).timestamp, qint64(300));
+}
+
+// Interrupted after the checkpoint was archived but not the journal:
+// the journal joins its segment on the next compaction.
+void ChangeJournalTest::interruptedArchive()
+{
+    ChangeJournal journal(journalName());
+
+    QVERIFY(journal.compact(EnvironmentBaseline(), 100));
+    QVERIFY(journal.append(QList<JournalEntry>()
+                           << change(200, variable("A", QVariant()), variable("A", "1"))));
+
+    QVERIFY(QFile::rename(journal.checkpointName(), journalName() + ".100.checkpoint"));
+    QVERIFY(!journal.hasCheckpoint());
+
+    EnvironmentBaseline saved;
+    saved.locals.insert("A", variable("A", "1"));
+    QVERIFY(journal.compact(saved, 300));
+
+    QVERIFY(QFile::exists(journalName() + ".100"));
+    QCOMPARE(journal.segments(), QList<qint64>() << 100);
+    QCOMPARE(valueAt(journal, 250, "A"), QString("1"));
+    QCOMPARE(journal.entries().count(), 1);
+}
+
+QTEST_APPLESS_MAIN(ChangeJournalTest)
+
+#include "tst_changejournal.moc"
@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_snapshot
+
+SOURCES += tst_snapshot.cpp
@@ -0,0 +1,178 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include <QtTest>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QFuture>
+
+#include <QtConcurrent/QtConcurrentRun>
+
+#include "VariablesManager.h"
+
+using namespace EnvironmentExplorer;
+
+class SnapshotTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void snapshotIsImmutable();
+    void readersSeeWholeVersions();
+    void trieIsCompacted();
+};
+
+static Variable variable(const QString &name, Variable::Type type, const QVariant &value)
+{
+    Variable var;
+    var.name = name;
+    var.type = type;
+    var.value = value;
+    return var;
+}
+
+void SnapshotTest::snapshotIsImmutable()
+{
+    VariablesManager manager;
+    manager.addVariable(variable("FIRST", Variable::User, "1"));
+
+    EnvironmentSnapshot before = manager.snapshot();
+
+    manager.addVariable(variable("FIRST", Variable::User, "2"));
+    manager.addVariable(variable("SECOND", Variable::Global, "3"));
+
+    Variable var;
+    QVERIFY(before.lookup("FIRST", Variable::User, &var));
+    QCOMPARE(var.value.toString(), QString("1"));
+    QVERIFY(!before.contains("SECOND"));
+    QVERIFY(manager.snapshot().version() > before.version());
+}
+
+// The writer sets a marker to the same value in both scopes, together
+// with a list whose length follows it, as one batch per version. A
+// snapshot taken halfway through a publish would show the scopes out
+// of step.
+void SnapshotTest::readersSeeWholeVersions()
+{
+    const int writes = 20000;
+    const int readers = qMax(QThread::idealThreadCount(), 2);
+
+    VariablesManager manager;
+    const quint64 first = manager.snapshot().version();
+
+    QAtomicInt done(0);
+
+    auto read = [&]() -> QString {
+        quint64 last = 0;
+        int taken = 0;
+
+        while (!done.loadAcquire() || taken == 0)
+        {
+            EnvironmentSnapshot snapshot = manager.snapshot();
+            ++taken;
+
+            if (snapshot.version() < last)
+                return QString("version went back from %1 to %2").arg(last).arg(snapshot.version());
+            last = snapshot.version();
+
+            Variable global, user, list;
+            bool inGlobal = snapshot.lookup("STRESS_MARKER", Variable::Global, &global);
+            bool inUser = snapshot.lookup("STRESS_MARKER", Variable::User, &user);
+
+            if (inGlobal != inUser)
+                return QString("version %1 has the marker in one scope only").arg(last);
+
+            if (!inGlobal)
+            {
+                if (last != first)
+                    return QString("version %1 has no marker").arg(last);
+                continue;
+            }
+
+            quint64 written = global.value.toString().toULongLong();
+            if (user.value.toString().toULongLong() != written)
+                return QString("version %1 has markers %2 and %3").arg(last)
+                       .arg(global.value.toString(), user.value.toString());
+
+            // one publish per batch
+            if (written != last - first)
+                return QString("version %1 carries batch %2").arg(last).arg(written);
+
+            if (!snapshot.lookup("STRESS_PATH", Variable::User, &list) ||
+                quint64(list.value.toStringList().count()) != written % 16 + 1)
+                return QString("version %1 has a list of another batch").arg(last);
+        }
+
+        return QString();
+    };
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(readers);
+
+    QList<QFuture<QString> > results;
+    for (int i = 0; i < readers; ++i)
+        results.append(QtConcurrent::run(&pool, read));
+
+    for (int i = 1; i <= writes; ++i)
+    {
+        QStringList entries;
+        for (int e = 0; e <= i % 16; ++e)
+            entries.append(QString("C:\\Stress\\%1\\bin").arg(e));
+
+        QList<Variable> batch;
+        batch.append(variable("STRESS_MARKER", Variable::Global, QString::number(i)));
+        batch.append(variable("STRESS_MARKER", Variable::User, QString::number(i)));
+        batch.append(variable("STRESS_PATH", Variable::User, entries));
+
+        manager.addVariables(batch);
+    }
+
+    done.storeRelease(1);
+
+    foreach (QFuture<QString> result, results)
+    {
+        QString error = result.result();
+        QVERIFY2(error.isEmpty(), qPrintable(error));
+    }
+
+    QCOMPARE(manager.snapshot().version(), first + writes);
+}
+
+// Every save copies the baseline and packs the new values into the
+// shared trie; the nodes of the values replaced stay. Past twice the
+// packed size the values move to a new trie, while a value packed
+// before still reads from the old one.
+void SnapshotTest::trieIsCompacted()
+{
+    EnvironmentBaseline base;
+    base.locals.insert("PATH", variable("PATH", Variable::User,
+                                        QStringList() << "C:\\a\\bin" << "C:\\b\\bin"));
+    base.pack();
+
+    Variable old = base.locals.value("PATH");
+    int packed = base.paths->nodeCount();
+
+    for (int save = 0; save < 2000; ++save)
+    {
+        QStringList list;
+        list << "C:\\a\\bin" << QString("C:\\save%1\\bin").arg(save);
+        base.locals.insert("PATH", base.pack(variable("PATH", Variable::User, list)));
+        base.compact();
+    }
+
+    QVERIFY(base.paths->nodeCount() < 2 * packed + 1024 + 2);
+    QCOMPARE(EnvironmentBaseline::unpack(base.locals.value("PATH")).value.toStringList(),
+             QStringList() << "C:\\a\\bin" << "C:\\save1999\\bin");
+    QCOMPARE(EnvironmentBaseline::unpack(old).value.toStringList(),
+             QStringList() << "C:\\a\\bin" << "C:\\b\\bin");
+}
+
+QTEST_APPLESS_MAIN(SnapshotTest)
+
+#include "tst_snapshot.moc"
@@ -0,0 +1,33 @@
+#
+# This is a part of EnvironmentExplorer program
+# which is licensed under LGPLv2.
+#
+# Github: https://github.com/PeterBocan/EnvironmentExplorer
+# Author: https://twitter.com/PeterBocan
+#
+# Shared by the test projects: the program sources the tests use,
+# without the user interface.
+#
+
+QT       += core testlib concurrent
+QT       -= gui
+CONFIG   += c++11 console testcase
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += $$PWD/..
+DEPENDPATH  += $$PWD/..
+
+SOURCES += $$PWD/../VariablesManager.cpp \
+           $$PWD/../EnvironmentSnapshot.cpp \
+           $$PWD/../PathTrie.cpp \
+           $$PWD/../ValueCodec.cpp \
+           $$PWD/../ChangeJournal.cpp \
+           $$PWD/../EnvironmentMerge.cpp \
+           $$PWD/../AllocationTracker.cpp \
+           $$PWD/../RunMetrics.cpp
+
+HEADERS += $$PWD/../VariablesManager.h
+
+win32: LIBS += -ladvapi32
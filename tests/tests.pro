@@ -0,0 +1,15 @@
+#
+# This is a part of EnvironmentExplorer program
+# which is licensed under LGPLv2.
+#
+# Github: https://github.com/PeterBocan/EnvironmentExplorer
+# Author: https://twitter.com/PeterBocan
+#
+# Unit tests; build with qmake tests/tests.pro and run "make check".
+#
+
+TEMPLATE = subdirs
+
+SUBDIRS += snapshot \
+           valuecodec \
+           changejournal
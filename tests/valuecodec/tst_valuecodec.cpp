@@ -0,0 +1,186 @@
+
+/*
+* This is a part of EnvironmentExplorer program
+* which is licensed under LGPLv2.
+*
+* Github: https://github.com/PeterBocan/EnvironmentExplorer
+* Author: https://twitter.com/PeterBocan
+*/
+
+#include <QtTest>
+
+#include "ValueCodec.h"
+
+using namespace EnvironmentExplorer;
+
+class ValueCodecTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip_data();
+    void roundTrip();
+    void entries_data();
+    void entries();
+    void quotedSeparators();
+    void blankValues();
+    void references_data();
+    void references();
+    void fuzzStrings();
+    void fuzzLists();
+};
+
+void ValueCodecTest::roundTrip_data()
+{
+    QTest::addColumn<QString>("raw");
+
+    QTest::newRow("empty") << "";
+    QTest::newRow("single") << "C:\\Windows";
+    QTest::newRow("list") << "C:\\a;C:\\b;C:\\c";
+    QTest::newRow("empty entry") << "C:\\a;;C:\\b";
+    QTest::newRow("trailing separator") << "C:\\a;C:\\b;";
+    QTest::newRow("leading separator") << ";C:\\a";
+    QTest::newRow("separators only") << ";;;";
+    QTest::newRow("quoted separator") << "\"C:\\a;b\";C:\\c";
+    QTest::newRow("quoted only") << "\"a;b;c\"";
+    QTest::newRow("unterminated quote") << "C:\\a;\"C:\\b;c";
+    QTest::newRow("references") << "%SystemRoot%\\system32;%SystemRoot%;%PATH%";
+    QTest::newRow("spaces") << " C:\\Program Files ; C:\\x ";
+    QTest::newRow("unicode") << QString::fromUtf8("C:\\Users\\J\xc3\xbcrgen;C:\\\xe6\x96\x87\xe4\xbb\xb6");
+}
+
+// decode() followed by encode() gives back the stored string.
+void ValueCodecTest::roundTrip()
+{
+    QFETCH(QString, raw);
+
+    QVariant value = ValueCodec::decode(raw);
+    QCOMPARE(ValueCodec::encode(value), raw);
+    QCOMPARE(ValueCodec::entries(value).join(";"), raw);
+}
+
+void ValueCodecTest::entries_data()
+{
+    QTest::addColumn<QString>("raw");
+    QTest::addColumn<QStringList>("expected");
+
+    QTest::newRow("single") << "a" << (QStringList() << "a");
+    QTest::newRow("empty entry") << "a;;b" << (QStringList() << "a" << "" << "b");
+    QTest::newRow("trailing separator") << "a;b;" << (QStringList() << "a" << "b" << "");
+    QTest::newRow("quoted separator") << "\"a;b\";c" << (QStringList() << "\"a;b\"" << "c");
+    QTest::newRow("two quoted") << "\"a;b\";\"c;d\"" << (QStringList() << "\"a;b\"" << "\"c;d\"");
+    QTest::newRow("quote inside") << "a\"b;c\"d;e" << (QStringList() << "a\"b;c\"d" << "e");
+    QTest::newRow("references") << "%A%;%B%" << (QStringList() << "%A%" << "%B%");
+}
+
+void ValueCodecTest::entries()
+{
+    QFETCH(QString, raw);
+    QFETCH(QStringList, expected);
+
+    QCOMPARE(ValueCodec::entries(ValueCodec::decode(raw)), expected);
+}
+
+void ValueCodecTest::quotedSeparators()
+{
+    QVector<ValueSpan> spans = ValueCodec::tokenize("\"C:\\a;b\";C:\\c");
+
+    QCOMPARE(spans.count(), 2);
+    QVERIFY(spans.at(0).quoted);
+    QVERIFY(!spans.at(1).quoted);
+    QCOMPARE(ValueCodec::unquote("\"C:\\a;b\""), QString("C:\\a;b"));
+
+    // a single quoted entry stays a string
+    QCOMPARE(ValueCodec::decode("\"a;b\"").type(), QVariant::String);
+}
+
+void ValueCodecTest::blankValues()
+{
+    QVERIFY(ValueCodec::isBlank(ValueCodec::decode("")));
+    QVERIFY(ValueCodec::isBlank(ValueCodec::decode(";;")));
+    QVERIFY(!ValueCodec::isBlank(ValueCodec::decode("a;")));
+    QVERIFY(ValueCodec::entries(QVariant()).isEmpty());
+}
+
+void ValueCodecTest::references_data()
+{
+    QTest::addColumn<QString>("raw");
+    QTest::addColumn<bool>("expected");
+
+    QTest::newRow("reference") << "%SystemRoot%\\system32" << true;
+    QTest::newRow("in a list") << "C:\\a;%JAVA_HOME%\\bin" << true;
+    QTest::newRow("no percent") << "C:\\a" << false;
+    QTest::newRow("one percent") << "100%" << false;
+    QTest::newRow("empty name") << "%%" << false;
+}
+
+void ValueCodecTest::references()
+{
+    QFETCH(QString, raw);
+    QFETCH(bool, expected);
+
+    QCOMPARE(ValueCodec::hasReferences(raw), expected);
+}
+
+// Any string, separators and quotes anywhere, survives decode/encode.
+void ValueCodecTest::fuzzStrings()
+{
+    static const QString alphabet = QString::fromUtf8("a;\"% \\:\xc3\xa9");
+
+    qsrand(20150101);
+
+    for (int i = 0; i < 20000; ++i)
+    {
+        QString raw;
+        int length = qrand() % 40;
+        for (int c = 0; c < length; ++c)
+            raw.append(alphabet.at(qrand() % alphabet.size()));
+
+        QVariant value = ValueCodec::decode(raw);
+        QVERIFY2(ValueCodec::encode(value) == raw, qPrintable(raw));
+
+        // spans and separators cover the whole string
+        int covered = -1;
+        foreach (const ValueSpan &span, ValueCodec::tokenize(raw))
+            covered += span.length + 1;
+        QVERIFY2(covered == raw.size(), qPrintable(raw));
+    }
+}
+
+// Lists of well-formed entries come back entry for entry.
+void ValueCodecTest::fuzzLists()
+{
+    static const QString plain = QString::fromUtf8("ab%\\: \xc3\xa9");
+    static const QString inQuotes = QString::fromUtf8("ab;%\\: \xc3\xa9");
+
+    qsrand(20150102);
+
+    for (int i = 0; i < 20000; ++i)
+    {
+        QStringList list;
+        int count = 2 + qrand() % 6;
+
+        for (int e = 0; e < count; ++e)
+        {
+            bool quoted = qrand() % 3 == 0;
+            const QString &chars = quoted ? inQuotes : plain;
+
+            QString entry;
+            int length = qrand() % 12; // empty entries included
+            for (int c = 0; c < length; ++c)
+                entry.append(chars.at(qrand() % chars.size()));
+
+            list.append(quoted ? "\"" + entry + "\"" : entry);
+        }
+
+        QString raw = ValueCodec::encode(list);
+        QVariant value = ValueCodec::decode(raw);
+
+        QVERIFY2(ValueCodec::isList(value), qPrintable(raw));
+        QVERIFY2(value.toStringList() == list, qPrintable(raw));
+    }
+}
+
+QTEST_APPLESS_MAIN(ValueCodecTest)
+
+#include "tst_valuecodec.moc"
@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_valuecodec
+
+SOURCES += tst_valuecodec.cpp